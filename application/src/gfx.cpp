@@ -15,18 +15,22 @@
 // You should have received a copy of the GNU General Public License
 // along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <array>
+#include <vector>
 #include <imgui.h>
 #include <switch.h>
 #include <deko3d.hpp>
 #include <common.hpp>
 
-#include <glm/mat4x4.hpp>
-
 #include "imgui_deko3d.h"
 #include "imgui_nx.h"
 
 #include "gfx.hpp"
+#include "scheduler.hpp"
 
 namespace im = ImGui;
 
@@ -41,6 +45,8 @@ constexpr auto FB_NUM       = 2u;
 
 constexpr auto CMDBUF_SIZE  = 1024 * 1024;
 
+constexpr auto IDLE_POLL_PERIOD = 1'000'000'000ull / 60;
+
 unsigned s_width  = 1920;
 unsigned s_height = 1080;
 
@@ -67,70 +73,54 @@ dk::Shader             s_previewShr;
 dk::UniqueQueue        s_queue;
 dk::UniqueSwapchain    s_swapchain;
 
-/* Generated from:
-#version 460
+FrameScheduler         s_scheduler;
 
-layout (local_size_x = 8, local_size_y = 8) in;
+// Sign-extended coefficients and LUTs of fz::Cmu, in the std140 layout of preview_csh.glsl
+struct PreviewUniforms {
+    std::array<std::array<std::int32_t, 4>, 3> csc;
+    std::array<std::int32_t, 4>                size;
+    std::array<std::uint32_t, 256>             lut_1;
+    std::array<std::uint32_t, 960>             lut_2;
+};
+ASSERT_SIZE(PreviewUniforms, 4928);
 
-layout (std140, binding = 0) uniform UBO {
-    mat4 colormatrix;
-} p;
+constexpr auto PREVIEW_SHADER_PATH = "romfs:/preview_csh.dksh";
 
-layout(rgba8, binding = 0) uniform readonly  image2D img_input;
-layout(rgba8, binding = 1) uniform writeonly image2D img_output;
+dk::Image             *s_previewSrc = nullptr, *s_previewDst = nullptr;
+int                    s_previewWidth = 0, s_previewHeight = 0;
+std::uint32_t          s_previewSrcId = 0, s_previewDstId = 0;
+bool                   s_previewGpu = false;
 
-void main() {
-    ivec2 pos = ivec2(gl_GlobalInvocationID);
-    if (pos.x >= 500 || pos.y >= 500)
-        return;
+// CPU fallback, used when the compute shader is unavailable
+dk::UniqueMemBlock     s_previewStaging;
+std::vector<std::uint8_t> s_previewPixels;
 
-    imageStore(img_output, pos, imageLoad(img_input, pos) * p.colormatrix);
-}
-*/
-
-std::uint8_t preview_shr_ctrl[] = {
-    0x44, 0x4b, 0x53, 0x48, 0x18, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
-    0x18, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x09, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00,
-    0x08, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-    0x00, 0x00, 0x00, 0x00,
-};
+bool loadPreviewShader() {
+    auto *fp = std::fopen(PREVIEW_SHADER_PATH, "rb");
+    if (!fp)
+        return false;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
 
-std::uint8_t preview_shr_code[] = {
-    0xed, 0x07, 0x20, 0xe0, 0x00, 0xbc, 0x1c, 0x00, 0x00, 0x00, 0x80, 0x1a, 0x00, 0x00, 0x70, 0xe2,
-    0x00, 0x00, 0x57, 0x02, 0x00, 0x00, 0xc8, 0xf0, 0x01, 0x00, 0x07, 0x02, 0x00, 0x00, 0xc8, 0xf0,
-    0xe6, 0x17, 0x00, 0xfe, 0x01, 0x04, 0x1c, 0x00, 0x02, 0x01, 0x07, 0x00, 0x01, 0x00, 0x00, 0x38,
-    0x02, 0x00, 0x27, 0x00, 0x80, 0x01, 0x18, 0x5c, 0x00, 0x00, 0x67, 0x02, 0x00, 0x00, 0xc8, 0xf0,
-    0xee, 0x07, 0x20, 0xfc, 0x01, 0xb4, 0x1f, 0x00, 0x01, 0x01, 0x07, 0xa1, 0x00, 0x00, 0x00, 0x38,
-    0x03, 0x00, 0x17, 0x00, 0x80, 0x01, 0x18, 0x5c, 0x07, 0x02, 0x47, 0x1f, 0x80, 0x03, 0x6d, 0x36,
-    0xed, 0x07, 0xa0, 0xfd, 0x3f, 0x84, 0xff, 0x07, 0x07, 0x03, 0x47, 0x1f, 0x00, 0x20, 0x6d, 0x36,
-    0x0f, 0x00, 0x00, 0x00, 0x00, 0x00, 0x20, 0xe3, 0x00, 0x00, 0x27, 0x00, 0x80, 0x07, 0x98, 0x5c,
-    0xe6, 0x07, 0xe0, 0xe1, 0x00, 0x3c, 0x3c, 0x00, 0x01, 0x00, 0x37, 0x00, 0x80, 0x07, 0x98, 0x5c,
-    0x00, 0x00, 0x47, 0x00, 0x86, 0x04, 0x18, 0xeb, 0x01, 0x02, 0x07, 0x00, 0x00, 0x00, 0xb8, 0x5c,
-    0xf0, 0x0f, 0xe0, 0xe1, 0x00, 0xc0, 0x3f, 0x00, 0x01, 0x01, 0x17, 0x08, 0x08, 0xb8, 0x03, 0x1e,
-    0x04, 0x02, 0x07, 0x00, 0x00, 0x02, 0xb8, 0x5c, 0x07, 0x04, 0x17, 0x08, 0x08, 0xb8, 0x03, 0x1e,
-    0x0f, 0x07, 0x00, 0xfe, 0x01, 0x3c, 0x1c, 0x00, 0x04, 0x02, 0x07, 0x00, 0x00, 0x04, 0xb8, 0x5c,
-    0x08, 0x04, 0x17, 0x08, 0x08, 0xb8, 0x03, 0x1e, 0x00, 0x02, 0x07, 0x00, 0x00, 0x06, 0xb8, 0x5c,
-    0xe1, 0x0f, 0xc0, 0xfc, 0x00, 0x98, 0x1f, 0x00, 0x00, 0x00, 0x17, 0x08, 0x08, 0xb8, 0x03, 0x1e,
-    0x04, 0x01, 0x07, 0x00, 0x08, 0x00, 0x68, 0x4c, 0x04, 0x07, 0x17, 0x00, 0x08, 0x02, 0x80, 0x49,
-    0xe6, 0x07, 0x20, 0xfc, 0x00, 0x98, 0x1f, 0x00, 0x04, 0x08, 0x27, 0x00, 0x08, 0x02, 0x80, 0x49,
-    0x04, 0x00, 0x37, 0x00, 0x08, 0x02, 0x80, 0x49, 0x05, 0x01, 0x47, 0x00, 0x08, 0x00, 0x68, 0x4c,
-    0xe6, 0x07, 0xc0, 0xfc, 0x00, 0x84, 0x1f, 0x00, 0x05, 0x07, 0x57, 0x00, 0x88, 0x02, 0x80, 0x49,
-    0x05, 0x08, 0x67, 0x00, 0x88, 0x02, 0x80, 0x49, 0x05, 0x00, 0x77, 0x00, 0x88, 0x02, 0x80, 0x49,
-    0xe6, 0x07, 0xc0, 0xfc, 0x00, 0x98, 0x1f, 0x00, 0x06, 0x01, 0x87, 0x00, 0x08, 0x00, 0x68, 0x4c,
-    0x06, 0x07, 0x97, 0x00, 0x08, 0x03, 0x80, 0x49, 0x06, 0x08, 0xa7, 0x00, 0x08, 0x03, 0x80, 0x49,
-    0xe1, 0x07, 0xc0, 0xfc, 0x00, 0x98, 0x1f, 0x00, 0x06, 0x00, 0xb7, 0x00, 0x08, 0x03, 0x80, 0x49,
-    0x01, 0x01, 0xc7, 0x00, 0x08, 0x00, 0x68, 0x4c, 0x01, 0x07, 0xd7, 0x00, 0x88, 0x00, 0x80, 0x49,
-    0xe6, 0x07, 0x20, 0xfc, 0x00, 0x84, 0x1f, 0x00, 0x01, 0x08, 0xe7, 0x00, 0x88, 0x00, 0x80, 0x49,
-    0x07, 0x00, 0xf7, 0x00, 0x88, 0x00, 0x80, 0x49, 0x00, 0x00, 0x27, 0x00, 0x80, 0x07, 0x98, 0x5c,
-    0xe6, 0x07, 0x20, 0x1c, 0x00, 0xbc, 0xff, 0x07, 0x01, 0x00, 0x37, 0x00, 0x80, 0x07, 0x98, 0x5c,
-    0x04, 0x00, 0xf7, 0x00, 0x96, 0x04, 0x28, 0xeb, 0x0f, 0x00, 0x07, 0x00, 0x00, 0x00, 0x00, 0xe3,
-    0xff, 0x07, 0x00, 0xfc, 0x00, 0x80, 0x1f, 0x00, 0x0f, 0x00, 0x07, 0xff, 0xff, 0x0f, 0x40, 0xe2,
-    0x00, 0x0f, 0x07, 0x00, 0x00, 0x00, 0xb0, 0x50, 0x00, 0x0f, 0x07, 0x00, 0x00, 0x00, 0xb0, 0x50,
-    0xe0, 0x07, 0x00, 0xfc, 0x00, 0x80, 0x1f, 0x00, 0x00, 0x0f, 0x07, 0x00, 0x00, 0x00, 0xb0, 0x50,
-    0x00, 0x0f, 0x07, 0x00, 0x00, 0x00, 0xb0, 0x50, 0x00, 0x0f, 0x07, 0x00, 0x00, 0x00, 0xb0, 0x50,
-};
+    std::fseek(fp, 0, SEEK_END);
+    auto size = std::ftell(fp);
+    std::fseek(fp, 0, SEEK_SET);
+    if (size <= 0)
+        return false;
+
+    // create shader memblock
+    s_codeMemBlock = dk::MemBlockMaker{s_device,
+        im::deko3d::align(size + DK_SHADER_CODE_UNUSABLE_SIZE, DK_MEMBLOCK_ALIGNMENT)}
+            .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached | DkMemBlockFlags_Code)
+            .create();
+
+    if (std::fread(s_codeMemBlock.getCpuAddr(), 1, size, fp) != static_cast<std::size_t>(size)) {
+        s_codeMemBlock = nullptr;
+        return false;
+    }
+
+    dk::ShaderMaker{s_codeMemBlock, 0}.initialize(s_previewShr);
+    return true;
+}
 
 void rebuildSwapchain(unsigned const width_, unsigned const height_) {
     // destroy old swapchain
@@ -212,20 +202,14 @@ void deko3dInit() {
     s_cmdBuf.addMemory(s_cmdMemBlock, 0, CMDBUF_SIZE);
 
     // create shader uniforms memblock
-    s_uniformMemBlock = dk::MemBlockMaker{s_device, im::deko3d::align(sizeof(glm::mat4), DK_MEMBLOCK_ALIGNMENT)}
+    s_uniformMemBlock = dk::MemBlockMaker{s_device, im::deko3d::align(sizeof(PreviewUniforms), DK_MEMBLOCK_ALIGNMENT)}
         .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached)
         .create();
 
-    // create shader memblock
-    s_codeMemBlock = dk::MemBlockMaker{s_device, im::deko3d::align(sizeof(preview_shr_code), DK_MEMBLOCK_ALIGNMENT)}
-        .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached | DkMemBlockFlags_Code)
-        .create();
-
-    std::memcpy(s_codeMemBlock.getCpuAddr(), preview_shr_code, sizeof(preview_shr_code));
-
-    dk::ShaderMaker{s_codeMemBlock, 0}
-        .setControl(preview_shr_ctrl)
-        .initialize(s_previewShr);
+    // load preview shader, the preview is rendered on the cpu if this fails
+    s_previewGpu = loadPreviewShader();
+    if (!s_previewGpu)
+        LOG("Failed to load %s, falling back to cpu preview\n", PREVIEW_SHADER_PATH);
 
     // create image/sampler memblock
     static_assert(sizeof(dk::ImageDescriptor)   == DK_IMAGE_DESCRIPTOR_ALIGNMENT);
@@ -258,6 +242,7 @@ void deko3dExit() {
     s_cmdBuf             = nullptr;
     s_cmdMemBlock        = nullptr;
 
+    s_previewStaging     = nullptr;
     s_uniformMemBlock    = nullptr;
     s_codeMemBlock       = nullptr;
 
@@ -291,18 +276,29 @@ bool loop() {
     if (!appletMainLoop())
         return false;
 
-    auto down = im::nx::newFrame();
-    im::NewFrame();
-
+    auto down = im::nx::poll();
     return !(down & HidNpadButton_Plus);
 }
 
+bool begin_frame(bool changed) {
+    if (!s_scheduler.update({ .input = im::nx::hadInput(), .changed = changed })) {
+        // nothing to redraw, poll again after a display period
+        svcSleepThread(IDLE_POLL_PERIOD);
+        return false;
+    }
+
+    im::nx::newFrame();
+    im::NewFrame();
+    return true;
+}
+
 int dequeue() {
     auto &io = im::GetIO();
     if (s_width != io.DisplaySize.x || s_height != io.DisplaySize.y) {
         s_width  = io.DisplaySize.x;
         s_height = io.DisplaySize.y;
         rebuildSwapchain(s_width, s_height);
+        s_scheduler.invalidate();
     }
 
     // get image from queue
@@ -338,44 +334,109 @@ void render(int slot) {
     s_queue.presentImage(s_swapchain, slot);
 }
 
-void render_preview(FizeauSettings &settings, Component components, Component filter,
-        int width, int height, int src_image_id, int dst_image_id) {
-    // Calculate initial coefficients
-    auto coeffs = filter_matrix(filter);
+void init_preview(dk::Image &src, dk::Image &dst, int width, int height,
+        std::uint32_t src_image_id, std::uint32_t dst_image_id) {
+    s_previewSrc    = &src,         s_previewDst   = &dst;
+    s_previewWidth  = width,        s_previewHeight = height;
+    s_previewSrcId  = src_image_id, s_previewDstId = dst_image_id;
 
-    // Apply temperature color correction
-    ColorMatrix m = {};
-    std::tie(m[0], m[4], m[8]) = whitepoint(settings.temperature);
-    coeffs = dot(coeffs, m);
+#ifndef FZ_CHECK_PREVIEW
+    if (s_previewGpu)
+        return;
+#endif
 
-    // Apply contrast multiplier
-    m[0] = m[4] = m[8] = contrast_slant(settings.contrast);
-    coeffs = dot(coeffs, m);
+    // read back the source pixels once, output is staged in a linear buffer and copied to the image.
+    // When checking the GPU preview, the buffer receives its output instead
+    auto size = static_cast<std::size_t>(width) * height * 4;
+    s_previewStaging = dk::MemBlockMaker{s_device, im::deko3d::align(size, DK_MEMBLOCK_ALIGNMENT)}
+        .setFlags(DkMemBlockFlags_CpuUncached | DkMemBlockFlags_GpuCached)
+        .create();
 
-    // Apply saturation
-    coeffs = dot(coeffs, saturation_matrix(settings.saturation));
+    dk::ImageView srcView{src};
+    s_cmdBuf.copyImageToBuffer(srcView, { 0, 0, 0, std::uint32_t(width), std::uint32_t(height), 1 },
+        { s_previewStaging.getGpuAddr(), 0, 0 });
+    s_queue.submitCommands(s_cmdBuf.finishList());
+    s_queue.waitIdle();
 
-    // Apply hue rotation
-    coeffs = dot(coeffs, hue_matrix(settings.hue));
+    auto *pixels = static_cast<std::uint8_t *>(s_previewStaging.getCpuAddr());
+    s_previewPixels.assign(pixels, pixels + size);
+}
 
-    auto colormatrix = glm::mat4(1.0f);
+bool is_preview_gpu() {
+    return s_previewGpu;
+}
 
-    // Copy calculated coefficients if they are enabled
-    if (components & Component_Red)
-        std::copy_n(coeffs.begin() + 0, 3, &colormatrix[0][0]);
-    if (components & Component_Green)
-        std::copy_n(coeffs.begin() + 3, 3, &colormatrix[1][0]);
-    if (components & Component_Blue)
-        std::copy_n(coeffs.begin() + 6, 3, &colormatrix[2][0]);
+#ifdef FZ_CHECK_PREVIEW
+// Reads back the output of the compute shader, and logs its largest difference to the CPU model per channel
+static void check_preview(const Cmu &cmu) {
+    dk::ImageView dstView{*s_previewDst};
+    s_cmdBuf.barrier(DkBarrier_Full, 0);
+    s_cmdBuf.copyImageToBuffer(dstView, { 0, 0, 0, std::uint32_t(s_previewWidth), std::uint32_t(s_previewHeight), 1 },
+        { s_previewStaging.getGpuAddr(), 0, 0 });
+    s_queue.submitCommands(s_cmdBuf.finishList());
+    s_queue.waitIdle();
 
-    s_cmdBuf.pushConstants(s_uniformMemBlock.getGpuAddr(), s_uniformMemBlock.getSize(), 0, sizeof(colormatrix), &colormatrix);
+    std::vector<std::uint8_t> reference(s_previewPixels.size());
+    cmu::Model(cmu).apply(s_previewPixels.data(), reference.data(), reference.size() / 4, 4);
+
+    auto *gpu = static_cast<const std::uint8_t *>(s_previewStaging.getCpuAddr());
+    std::array<int, 3> max_delta = {};
+    std::size_t num_differing = 0;
+    for (std::size_t i = 0; i < reference.size(); i += 4) {
+        bool differs = false;
+        for (std::size_t c = 0; c < max_delta.size(); ++c) {
+            int delta = std::abs(gpu[i + c] - reference[i + c]);
+            max_delta[c] = std::max(max_delta[c], delta), differs |= delta != 0;
+        }
+        num_differing += differs;
+    }
+
+    LOG("Preview check: max delta r %d g %d b %d, %zu/%zu pixels differ\n",
+        max_delta[0], max_delta[1], max_delta[2], num_differing, reference.size() / 4);
+}
+#endif
+
+void render_preview(const FizeauSettings &settings, Component components, Component filter) {
+    if (!s_previewSrc || !s_previewDst)
+        return;
+
+    // Same LUT1 -> CSC -> LUT2 pipeline as the display controller
+    auto cmu = calculate_cmu(settings, components, filter);
+
+    if (!s_previewGpu) {
+        // the previous copy may still be reading the staging buffer
+        s_queue.waitIdle();
+
+        cmu::Model(cmu).apply(s_previewPixels.data(), static_cast<std::uint8_t *>(s_previewStaging.getCpuAddr()),
+            s_previewPixels.size() / 4, 4);
+
+        dk::ImageView dstView{*s_previewDst};
+        s_cmdBuf.copyBufferToImage({ s_previewStaging.getGpuAddr(), 0, 0 }, dstView,
+            { 0, 0, 0, std::uint32_t(s_previewWidth), std::uint32_t(s_previewHeight), 1 });
+        s_queue.submitCommands(s_cmdBuf.finishList());
+        return;
+    }
+
+    PreviewUniforms uniforms = {};
+    auto *coeffs = &cmu.krr;
+    for (std::size_t i = 0; i < uniforms.csc.size(); ++i)
+        std::transform(coeffs + 3 * i, coeffs + 3 * i + 3, uniforms.csc[i].begin(), cmu::coefficient);
+    uniforms.size = { s_previewWidth, s_previewHeight, 0, 0 };
+    std::transform(cmu.lut_1.begin(), cmu.lut_1.end(), uniforms.lut_1.begin(), [](std::uint16_t v) { return v & 0xfff; });
+    std::copy(cmu.lut_2.begin(), cmu.lut_2.end(), uniforms.lut_2.begin());
+
+    s_cmdBuf.pushConstants(s_uniformMemBlock.getGpuAddr(), s_uniformMemBlock.getSize(), 0, sizeof(uniforms), &uniforms);
     s_cmdBuf.bindUniformBuffer(DkStage_Compute, 0, s_uniformMemBlock.getGpuAddr(), s_uniformMemBlock.getSize());
-    s_cmdBuf.bindImages(DkStage_Compute, 0, { (std::uint32_t)src_image_id, (std::uint32_t)dst_image_id });
+    s_cmdBuf.bindImages(DkStage_Compute, 0, { s_previewSrcId, s_previewDstId });
     s_cmdBuf.bindShaders(DkStageFlag_Compute, &s_previewShr);
-    s_cmdBuf.dispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+    s_cmdBuf.dispatchCompute((s_previewWidth + 7) / 8, (s_previewHeight + 7) / 8, 1);
     s_cmdBuf.barrier(DkBarrier_Primitives, 0);
 
     s_queue.submitCommands(s_cmdBuf.finishList());
+
+#ifdef FZ_CHECK_PREVIEW
+    check_preview(cmu);
+#endif
 }
 
 void wait() {
@@ -25,14 +25,20 @@
 namespace fz::gfx {
 
 bool init();
+// Polls input without starting a frame, returns false once the application should exit
 bool loop();
+// Starts an ImGui frame if one needs to be produced, given input and whether the displayed state changed
+bool begin_frame(bool changed);
 int dequeue();
 void render(int slot);
 void wait();
 void exit();
 
-void render_preview(FizeauSettings &settings, Component components, Component filter,
-    int width, int height, int src_image_id, int dst_image_id);
+// The preview is rendered from src to dst, with the compute shader or on the cpu if it is unavailable
+void init_preview(dk::Image &src, dk::Image &dst, int width, int height,
+    std::uint32_t src_image_id, std::uint32_t dst_image_id);
+bool is_preview_gpu();
+void render_preview(const FizeauSettings &settings, Component components, Component filter);
 
 void create_texture(dk::MemBlock &memblk, dk::Image &image, int width, int height, DkImageFormat fmt,
     std::uint32_t sampler_id, std::uint32_t image_id);
@@ -182,16 +182,29 @@ Result draw_profile_tab(Config &ctx) {
             return rc;
     }
 
+    // Conflicts are merged with the edits of other clients, only repeated ones are left to the user,
+    // with the merged profile displayed so that it can be applied again
+    static bool has_conflict = false;
+    auto write = [&ctx](Result rc) {
+        has_conflict = rc == FIZEAU_MAKERESULT(VERSION_MISMATCH);
+        ctx.is_editing_day_profile = ctx.is_editing_night_profile = false;
+        return has_conflict ? 0 : rc;
+    };
+
     if (im::Button("Apply")) {
-        if (auto rc = ctx.apply(); R_FAILED(rc))
+        if (auto rc = write(ctx.apply()); R_FAILED(rc))
             return rc;
-        ctx.is_editing_day_profile = ctx.is_editing_night_profile = false;
     }
 
     im::SameLine();
     if (im::Button("Reset")) {
-        ctx.reset();
-        ctx.is_editing_day_profile = ctx.is_editing_night_profile = false;
+        if (auto rc = write(ctx.reset()); R_FAILED(rc))
+            return rc;
+    }
+
+    if (has_conflict) {
+        im::SameLine();
+        im::TextUnformatted("Profile edited by another client, check and apply again");
     }
 
     im::EndTabItem();
@@ -211,19 +224,19 @@ Result draw_color_tab(Config &ctx) {
     // Temperature sliders
     im::SeparatorText("Temperature");
     auto max_temp = enable_extra_hot_temps ? MAX_TEMP : D65_TEMP;
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##tempd", ctx.profile.day_settings  .temperature, MIN_TEMP, max_temp, "%d°K");
-    ctx.is_editing_night_profile |= new_slider("Night:", "##tempn", ctx.profile.night_settings.temperature, MIN_TEMP, max_temp, "%d°K");
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##tempd", ctx.profile.day_settings  .temperature, MIN_TEMP, max_temp, "%d°K"));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##tempn", ctx.profile.night_settings.temperature, MIN_TEMP, max_temp, "%d°K"));
     im::Checkbox("Enable blue temperatures", &enable_extra_hot_temps);
 
     // Saturation sliders
     im::SeparatorText("Saturation");
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##satd", ctx.profile.day_settings  .saturation, MIN_SAT, MAX_SAT, "%.2f");
-    ctx.is_editing_night_profile |= new_slider("Night:", "##satn", ctx.profile.night_settings.saturation, MIN_SAT, MAX_SAT, "%.2f");
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##satd", ctx.profile.day_settings  .saturation, MIN_SAT, MAX_SAT, "%.2f"));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##satn", ctx.profile.night_settings.saturation, MIN_SAT, MAX_SAT, "%.2f"));
 
     // Hue sliders
     im::SeparatorText("Hue");
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##hued", ctx.profile.day_settings  .hue, MIN_HUE, MAX_HUE, "%.2f");
-    ctx.is_editing_night_profile |= new_slider("Night:", "##huen", ctx.profile.night_settings.hue, MIN_HUE, MAX_HUE, "%.2f");
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##hued", ctx.profile.day_settings  .hue, MIN_HUE, MAX_HUE, "%.2f"));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##huen", ctx.profile.night_settings.hue, MIN_HUE, MAX_HUE, "%.2f"));
 
     // Components checkboxes
     im::SeparatorText("Channels");
@@ -232,16 +245,21 @@ Result draw_color_tab(Config &ctx) {
 
     std::uint32_t c = ctx.profile.components;
     im::TextUnformatted("Components:");  im::SameLine(); im::SetCursorPosX(items_pos);
-    im::CheckboxFlags("Red##compr",   &c, Component_Red);   im::SameLine();
-    im::CheckboxFlags("Green##compg", &c, Component_Green); im::SameLine();
-    im::CheckboxFlags("Blue##compb",  &c, Component_Blue);
+    bool has_changed = false;
+    has_changed |= im::CheckboxFlags("Red##compr",   &c, Component_Red);   im::SameLine();
+    has_changed |= im::CheckboxFlags("Green##compg", &c, Component_Green); im::SameLine();
+    has_changed |= im::CheckboxFlags("Blue##compb",  &c, Component_Blue);
     ctx.profile.components = static_cast<Component>(c);
 
     int filter = (ctx.profile.filter == Component_None) ? 0 : std::countr_zero(static_cast<std::uint32_t>(ctx.profile.filter)) + 1;
     im::TextUnformatted("Filter:"); im::SameLine(); im::SetCursorPosX(items_pos);
     im::SetNextItemWidth(0.2f * width);
-    if (im::Combo("##filter", &filter, filters_names.data(), filters_names.size()))
+    if (im::Combo("##filter", &filter, filters_names.data(), filters_names.size())) {
         ctx.profile.filter = static_cast<Component>(filter ? BIT(filter - 1) : filter);
+        has_changed = true;
+    }
+
+    ctx.mark_changed(has_changed);
 
     im::EndTabItem();
     return 0;
@@ -253,23 +271,23 @@ Result draw_correction_tab(Config &ctx) {
 
     // Contrast sliders
     im::SeparatorText("Contrast");
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##contrastd", ctx.profile.day_settings  .contrast, MIN_CONTRAST, MAX_CONTRAST, "%.2f");
-    ctx.is_editing_night_profile |= new_slider("Night:", "##contrastn", ctx.profile.night_settings.contrast, MIN_CONTRAST, MAX_CONTRAST, "%.2f");
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##contrastd", ctx.profile.day_settings  .contrast, MIN_CONTRAST, MAX_CONTRAST, "%.2f"));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##contrastn", ctx.profile.night_settings.contrast, MIN_CONTRAST, MAX_CONTRAST, "%.2f"));
 
     // Gamma sliders
     im::SeparatorText("Gamma");
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##gammad", ctx.profile.day_settings  .gamma, MIN_GAMMA, MAX_GAMMA, "%.2f");
-    ctx.is_editing_night_profile |= new_slider("Night:", "##gamman", ctx.profile.night_settings.gamma, MIN_GAMMA, MAX_GAMMA, "%.2f");
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##gammad", ctx.profile.day_settings  .gamma, MIN_GAMMA, MAX_GAMMA, "%.2f"));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##gamman", ctx.profile.night_settings.gamma, MIN_GAMMA, MAX_GAMMA, "%.2f"));
 
     // Luminance sliders
     im::SeparatorText("Luminance");
-    ctx.is_editing_day_profile   |= new_slider("Day:",   "##lumad", ctx.profile.day_settings  .luminance, MIN_LUMA, MAX_LUMA, "%.2f", true);
-    ctx.is_editing_night_profile |= new_slider("Night:", "##luman", ctx.profile.night_settings.luminance, MIN_LUMA, MAX_LUMA, "%.2f", true);
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_slider("Day:",   "##lumad", ctx.profile.day_settings  .luminance, MIN_LUMA, MAX_LUMA, "%.2f", true));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_slider("Night:", "##luman", ctx.profile.night_settings.luminance, MIN_LUMA, MAX_LUMA, "%.2f", true));
 
     // Color range sliders
     im::SeparatorText("Color range");
-    ctx.is_editing_day_profile   |= new_range("Day:",   "Full range##d", "##rangeld", "##ranghd", ctx.profile.day_settings  .range);
-    ctx.is_editing_night_profile |= new_range("Night:", "Full range##n", "##rangeln", "##ranghn", ctx.profile.night_settings.range);
+    ctx.is_editing_day_profile   |= ctx.mark_changed(new_range("Day:",   "Full range##d", "##rangeld", "##ranghd", ctx.profile.day_settings  .range));
+    ctx.is_editing_night_profile |= ctx.mark_changed(new_range("Night:", "Full range##n", "##rangeln", "##ranghn", ctx.profile.night_settings.range));
 
     im::EndTabItem();
     return 0;
@@ -283,6 +301,13 @@ Result draw_time_tab(Config &ctx) {
 
     bool has_changed = false;
 
+    if (ctx.profile.num_keyframes)
+        im::TextColored({ 1.00f, 0.33f, 0.33f, 1.0f }, "This profile follows %u keyframes set in the config file, "
+            "dusk and dawn times are unused", ctx.profile.num_keyframes);
+    else if (ctx.profile.has_location)
+        im::TextColored({ 1.00f, 0.33f, 0.33f, 1.0f }, "This profile follows the sun at %.4f, %.4f (config file), "
+            "dusk and dawn times are only used on days without a sunrise or sunset", ctx.profile.latitude, ctx.profile.longitude);
+
     // Dusk
     im::SeparatorText("Dusk");
     has_changed |= new_times("Start:", "##dush", "##dusm", ctx.profile.dusk_begin);
@@ -307,7 +332,7 @@ Result draw_time_tab(Config &ctx) {
         im::TextColored({ 1.00f, 0.33f, 0.33f, 1.0f }, "Invalid dawn transition times!");
     }
 
-    if (has_changed)
+    if (ctx.mark_changed(has_changed))
         ctx.has_active_override = false;
 
     // Dimming timeout
@@ -320,15 +345,26 @@ Result draw_time_tab(Config &ctx) {
 
         im::SameLine(); im::SetCursorPosX(0.08f * width);
         int int_m = ctx.profile.dimming_timeout.m, int_s = ctx.profile.dimming_timeout.s;
-        im::DragInt("##dimm", &int_m, 0.05f, 0, 59, "%02dm");
-        swkbd::handle("##dimm", &int_m, 0, 59);
+        bool has_changed = false;
+        has_changed |= im::DragInt("##dimm", &int_m, 0.05f, 0, 59, "%02dm");
+        has_changed |= swkbd::handle("##dimm", &int_m, 0, 59);
         im::SameLine();
-        im::DragInt("##dims", &int_s, 0.05f, 0, 59, "%02ds");
-        swkbd::handle("##dims", &int_s, 0, 59);
+        has_changed |= im::DragInt("##dims", &int_s, 0.05f, 0, 59, "%02ds");
+        has_changed |= swkbd::handle("##dims", &int_s, 0, 59);
+        ctx.mark_changed(has_changed);
 
         im::TextUnformatted("Set to 0 to use the system setting");
 
+        im::TextUnformatted("Fade:");
+
+        im::SameLine(); im::SetCursorPosX(0.08f * width);
+        int int_fade = ctx.profile.dimming_fade;
+        has_changed = im::DragInt("##dimf", &int_fade, 10.0f, 0, 10'000, "%dms");
+        has_changed |= swkbd::handle("##dimf", &int_fade, 0, 10'000);
+        ctx.mark_changed(has_changed);
+
         ctx.profile.dimming_timeout.m = static_cast<std::uint8_t>(int_m), ctx.profile.dimming_timeout.s = static_cast<std::uint8_t>(int_s);
+        ctx.profile.dimming_fade = static_cast<std::uint32_t>(int_fade);
     }
 
     im::EndTabItem();
@@ -474,25 +510,32 @@ void draw_graph_window(Config &ctx) {
     im::SetWindowPos( { 0.53f * width, 0.60f * height }, ImGuiCond_Always);
     im::SetWindowSize({ 0.38f * width, 0.35f * height }, ImGuiCond_Always);
 
-    FizeauSettings set = ctx.is_editing_day_profile ? ctx.profile.day_settings : ctx.profile.night_settings;
+    // Ramps are only recalculated when the displayed settings change
+    static std::array<float, 2>   linear = { 0, 1 };
+    static std::array<float, 256> lut1_float;
+    static std::array<float, 960> lut2_float;
+    static std::uint32_t cached_generation = -1;
+    static bool cached_is_day = false;
 
-    // Calculate ramps
-    std::array<std::uint16_t, 256> lut1;
-    std::array<std::uint16_t, 960> lut2;
+    if (ctx.generation != cached_generation || ctx.is_editing_day_profile != cached_is_day) {
+        cached_generation = ctx.generation, cached_is_day = ctx.is_editing_day_profile;
 
-    float off = (1.0f - contrast_slant(set.contrast)) / 2.0f;
-    degamma_ramp(lut1.data(), lut1.size(), DEFAULT_GAMMA, 8);
-    regamma_ramp(lut2.data(), lut2.size(), set.gamma, 8, 0.0f, 1.0f, off);
+        FizeauSettings set = ctx.is_editing_day_profile ? ctx.profile.day_settings : ctx.profile.night_settings;
 
-    apply_luma(lut2.data(), lut2.size(), 8, set.luminance);
-    apply_range(lut2.data(), lut2.size(), 8, set.range.lo, std::min(set.range.hi, lut2.back() / 255.0f));
+        // Calculate ramps
+        std::array<std::uint16_t, lut1_float.size()> lut1;
+        std::array<std::uint16_t, lut2_float.size()> lut2;
 
-    std::array<float, 2>           linear = { 0, 1 };
-    std::array<float, lut1.size()> lut1_float;
-    std::array<float, lut2.size()> lut2_float;
+        float off = (1.0f - contrast_slant(set.contrast)) / 2.0f;
+        degamma_ramp(lut1.data(), lut1.size(), DEFAULT_GAMMA, 8);
+        regamma_ramp(lut2.data(), lut2.size(), set.gamma, 8, 0.0f, 1.0f, off);
 
-    std::transform(lut1.begin(), lut1.end(), lut1_float.begin(), [](std::uint16_t val) { return static_cast<float>(val) / 255.0f; });
-    std::transform(lut2.begin(), lut2.end(), lut2_float.begin(), [](std::uint16_t val) { return static_cast<float>(val) / 255.0f; });
+        apply_luma(lut2.data(), lut2.size(), 8, set.luminance);
+        apply_range(lut2.data(), lut2.size(), 8, set.range.lo, std::min(set.range.hi, lut2.back() / 255.0f));
+
+        std::transform(lut1.begin(), lut1.end(), lut1_float.begin(), [](std::uint16_t val) { return static_cast<float>(val) / 255.0f; });
+        std::transform(lut2.begin(), lut2.end(), lut2_float.begin(), [](std::uint16_t val) { return static_cast<float>(val) / 255.0f; });
+    }
 
     auto &style = im::GetStyle();
     auto *window = im::GetCurrentWindow();
@@ -532,6 +575,8 @@ void draw_error_window(Config &ctx, Result error) {
 
     if (error == 1)
         im::Text("The service is not active, check that all files are correctly installed.");
+    else if (error == FIZEAU_MAKERESULT(BUSY))
+        im::Text("The sysmodule is starting, the config was not applied. Restart Fizeau in a few seconds.");
     else
         im::Text("Error: %#x (%04d-%04d)", error, R_MODULE(error) | 2000, R_DESCRIPTION(error));
 
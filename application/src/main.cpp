@@ -18,6 +18,7 @@
 #include <cstdio>
 #include <vector>
 #include <string>
+#include <utility>
 #include <switch.h>
 #include <nvjpg.hpp>
 #include <common.hpp>
@@ -105,6 +106,7 @@ int main(int argc, char **argv) {
     fz::gfx::register_texture(background_memblk,  background_img,  background_surf, 1, 1);
     fz::gfx::register_texture(preview_ref_memblk, preview_ref_img, preview_surf,    2, 2);
     fz::gfx::create_texture(preview_mat_memblk, preview_mat_img, preview.width, preview.height, DkImageFormat_RGBA8_Unorm, 3, 3);
+    fz::gfx::init_preview(preview_ref_img, preview_mat_img, preview.width, preview.height, 2, 3);
 
     fz::gui::init();
     FZ_SCOPEGUARD([] { fz::gui::exit(); });
@@ -123,23 +125,26 @@ int main(int argc, char **argv) {
         rc = fizeauInitialize();
     FZ_SCOPEGUARD([] { fizeauExit(); });
 
+    // Also sends the active state and profiles
     if (R_SUCCEEDED(rc))
-        config.read();
-
-    if (R_SUCCEEDED(rc))
-        rc = fizeauSetIsActive(config.active);
-
-    if (R_SUCCEEDED(rc))
-        fizeauSetActiveProfileId(false, config.internal_profile);
-
-    if (R_SUCCEEDED(rc))
-        fizeauSetActiveProfileId(true, config.external_profile);
+        rc = config.read();
 
     if (R_SUCCEEDED(rc))
         config.open_profile(appletGetOperationMode() == AppletOperationMode_Handheld ?
                             config.internal_profile : config.external_profile);
 
     while (fz::gfx::loop()) {
+        // The main window displays the time, redraw when it changes. Also redraw when the settings changed since
+        // the start of the last frame, including changes made without input or while drawing it (config loaded,
+        // profile reopened, a write reloaded after a conflict)
+        static std::uint8_t prev_second = -1;
+        static std::uint32_t drawn_generation = -1;
+        auto second = fz::Clock::get_current_time().s;
+        bool changed = std::exchange(prev_second, second) != second;
+        if (!fz::gfx::begin_frame(changed || config.generation != drawn_generation))
+            continue;
+        drawn_generation = config.generation;
+
         auto slot = fz::gfx::dequeue();
 
         if (R_FAILED(rc)) {
@@ -158,9 +163,15 @@ int main(int argc, char **argv) {
                     config.is_editing_night_profile = false, prev_editing_day = true;
             }
 
-            auto &settings = config.is_editing_day_profile ? config.profile.day_settings : config.profile.night_settings;
-            fz::gfx::render_preview(settings, config.profile.components, config.profile.filter,
-                preview.width, preview.height, 2, 3);
+            // Only dispatch the preview when the displayed settings changed, the output texture persists
+            static std::uint32_t preview_generation = -1;
+            static bool preview_is_day = false;
+            if (config.generation != preview_generation || config.is_editing_day_profile != preview_is_day) {
+                preview_generation = config.generation, preview_is_day = config.is_editing_day_profile;
+
+                auto &settings = config.is_editing_day_profile ? config.profile.day_settings : config.profile.night_settings;
+                fz::gfx::render_preview(settings, config.profile.components, config.profile.filter);
+            }
         }
 
         fz::gfx::render(slot);
@@ -0,0 +1,42 @@
+#version 460
+
+// Mirror of fz::cmu::Model (common/src/cmu.cpp), in the same integer arithmetic
+// so that the output matches the CPU reference exactly
+
+layout (local_size_x = 8, local_size_y = 8) in;
+
+layout (std140, binding = 0) uniform UBO {
+    ivec4 csc[3];       // Rows of sign-extended S1.8 coefficients
+    ivec4 size;
+    uvec4 lut_1[64];    // 256 12-bit entries
+    uvec4 lut_2[240];   // 960 8-bit entries
+} p;
+
+layout (rgba8, binding = 0) uniform readonly  image2D img_input;
+layout (rgba8, binding = 1) uniform writeonly image2D img_output;
+
+int lut_1(uint idx) {
+    return int(p.lut_1[idx >> 2][idx & 3]);
+}
+
+uint lut_2(int val) {
+    uint idx = uint(clamp(val >> 8, 0, 0xfff));
+    idx = (idx < 512) ? idx : 512 + (idx - 512) / 8;
+    return p.lut_2[idx >> 2][idx & 3];
+}
+
+void main() {
+    ivec2 pos = ivec2(gl_GlobalInvocationID);
+    if (pos.x >= p.size.x || pos.y >= p.size.y)
+        return;
+
+    vec4  pixel = imageLoad(img_input, pos);
+    uvec3 in_   = uvec3(round(pixel.rgb * 255.0));
+    ivec3 lin   = ivec3(lut_1(in_.r), lut_1(in_.g), lut_1(in_.b));
+
+    uvec3 out_  = uvec3(lut_2(dot(p.csc[0].xyz, lin)),
+                        lut_2(dot(p.csc[1].xyz, lin)),
+                        lut_2(dot(p.csc[2].xyz, lin)));
+
+    imageStore(img_output, pos, vec4(vec3(out_) / 255.0, pixel.a));
+}
@@ -0,0 +1,64 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+namespace fz {
+
+// Decides when the application has to produce a frame.
+// Kept free of any graphics or platform code, so that it can be driven from the host build
+class FrameScheduler {
+    public:
+        struct Signals {
+            bool input;   // Touch, button or stick activity during this poll
+            bool changed; // Displayed state changed without input (clock text, settings applied externally, ...)
+        };
+
+        // Frames produced after the last input, so that ImGui can process releases and settle hover/nav state
+        constexpr static std::uint32_t SettleFrames = 8;
+
+    public:
+        // When disabled, every poll produces a frame
+        bool on_demand = true;
+
+    public:
+        constexpr bool update(const Signals &signals) {
+            if (!this->on_demand || signals.input)
+                this->pending = std::max(this->pending, SettleFrames);
+            else if (signals.changed)
+                this->pending = std::max(this->pending, 1u);
+
+            if (!this->pending)
+                return false;
+
+            --this->pending;
+            return true;
+        }
+
+        // Forces the next frames to be drawn, eg. after the swapchain is recreated
+        constexpr void invalidate(std::uint32_t frames = SettleFrames) {
+            this->pending = std::max(this->pending, frames);
+        }
+
+    private:
+        std::uint32_t pending = SettleFrames;
+};
+
+} // namespace fz
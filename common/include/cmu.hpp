@@ -0,0 +1,153 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <new>
+#include <utility>
+
+#include <switch.h>
+
+#include "fizeau.h"
+#include "types.h"
+#include "utils.h"
+
+namespace fz {
+
+// Represents a fixed-point fractional number
+template <bool Signed, std::size_t M, std::size_t N, typename Rep>
+struct Q {
+    constexpr static std::size_t Sign          = Signed;
+    constexpr static std::size_t Integer       = M;
+    constexpr static std::size_t Fractional    = N;
+
+    constexpr static std::size_t NbIntegerBits = Integer + Fractional;
+    constexpr static std::size_t NbBits        = Sign + NbIntegerBits;
+
+    constexpr static std::size_t BitMask       = (1 << NbBits) - 1;
+
+    using Underlying = Rep;
+
+    constexpr Q() = default;
+
+    template <typename T>
+    constexpr Q(T n) requires std::integral<T>:
+        rep(static_cast<Underlying>(n)) { }
+
+    template <typename T>
+    constexpr Q(T n) requires std::floating_point<T>:
+        rep(static_cast<Underlying>(n * static_cast<T>(1 << Fractional))) { }
+
+    template <typename T>
+    constexpr operator T() const requires std::integral<T> {
+        return this->rep;
+    }
+
+    template <typename T>
+    constexpr operator T() const requires std::floating_point<T> {
+        return (this->rep & (1 << NbIntegerBits) ? -1.0f : 1.0f) *
+            static_cast<T>(this->rep & ((1 << NbIntegerBits) - 1)) / static_cast<T>(1 << Fractional);
+    }
+
+    private:
+        Underlying rep = 0;
+};
+
+using QS18 = Q<true, 1, 8, std::int16_t>;
+static_assert(static_cast<float>(QS18(0x100))          == 1.0f);
+static_assert(static_cast<float>(QS18(-1.0f))          == -1.0f);
+static_assert(std::bit_cast<std::uint16_t>(QS18(1.0))  == 0x100);
+static_assert(std::bit_cast<std::uint16_t>(QS18(-1.0)) == 0xff00);
+
+struct Cmu {
+    __nv_in std::uint16_t enable;
+
+    __nv_in QS18 krr, kgr, kbr,
+                 krg, kgg, kbg,
+                 krb, kgb, kbb;
+
+    __nv_in std::array<std::uint16_t, 256> lut_1 = {};
+    __nv_in std::array<std::uint16_t, 960> lut_2 = {};
+
+    __nv_out std::uint16_t csc_modified  = 0;
+    __nv_out std::uint16_t lut1_modified = 0;
+    __nv_out std::uint16_t lut2_modified = 0;
+
+    constexpr Cmu(bool enable = true, QS18 krr = 1.0, QS18 kgg = 1.0, QS18 kbb = 1.0):
+        enable(enable), krr(krr), kgg(kgg), kbb(kbb) { }
+
+    template <typename ...Args>
+    inline void reset(Args &&...args) {
+        new (this) Cmu(std::forward<Args>(args)...);
+    }
+};
+ASSERT_SIZE(Cmu, 2458);
+
+// Calculates in place, for callers that keep the CMU in a preallocated buffer
+void calculate_cmu(Cmu &cmu, const FizeauSettings &settings, Component components, Component filter);
+
+inline Cmu calculate_cmu(const FizeauSettings &settings, Component components, Component filter) {
+    Cmu cmu;
+    calculate_cmu(cmu, settings, components, filter);
+    return cmu;
+}
+
+namespace cmu {
+
+// Value seen by the hardware for a coefficient: 10-bit two's complement, sign-extended
+constexpr std::int32_t coefficient(QS18 c) {
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(static_cast<std::uint16_t>(c) & QS18::BitMask) << 22) >> 22;
+}
+static_assert(coefficient(QS18(1.0f))   == 0x100);
+static_assert(coefficient(QS18(-0.5f))  == -0x80);
+
+// Index in LUT2 of a 12-bit CSC output.
+// The first 512 entries cover [0, 0.125) with 1/4096 steps, the remaining 448 cover [0.125, 1] with 1/512 steps
+constexpr std::size_t lut2_index(std::uint32_t val) {
+    return val < 512 ? val : 512 + (val - 512) / 8;
+}
+
+// Whether every 8-bit channel value goes through the CMU unchanged, within tolerance (in output LSBs),
+// so that it can be bypassed. Cross-channel coefficients must be null, which lets channels be checked separately
+bool is_identity(const Cmu &cmu, std::int32_t tolerance = 1);
+
+// CPU model of the display controller color management unit:
+//   LUT1 (8-bit input -> 12-bit linear), CSC (3x3 S1.8 matrix, clamped to 12 bits), LUT2 (12-bit linear -> 8-bit output)
+// This is the reference the GPU preview mirrors, and its fallback
+class Model {
+    public:
+        Model(const Cmu &cmu);
+
+        // Processes interleaved 8-bit pixels of bpp bytes (3 or 4, the alpha channel is passed through)
+        // src and dst may alias
+        void apply(const std::uint8_t *src, std::uint8_t *dst, std::size_t num_pixels, std::size_t bpp) const;
+
+    private:
+        bool enable;
+        std::array<std::int32_t, 9> csc;
+        std::array<std::int32_t, 256> lut_1;
+        std::array<std::uint8_t, 0x1000> lut_2; // Expanded to one entry per 12-bit value
+};
+
+} // namespace cmu
+
+} // namespace fz
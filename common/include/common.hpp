@@ -18,8 +18,10 @@
 #pragma once
 
 #ifdef __cplusplus
+#   include "cmu.hpp"
 #   include "color.hpp"
 #   include "config.hpp"
+#   include "schedule.hpp"
 #   include "time.hpp"
 #endif // __cplusplus
 
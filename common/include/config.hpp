@@ -17,7 +17,9 @@
 
 #pragma once
 
+#include <cstdint>
 #include <array>
+#include <span>
 #include <string_view>
 #include <switch.h>
 
@@ -26,6 +28,14 @@
 
 namespace fz {
 
+using KeyframeArray = std::array<FizeauKeyframe, FIZEAU_MAX_KEYFRAMES>;
+
+// Profile replacing the handheld and docked ones while an application runs, see fizeauSetAppProfile
+struct AppRule {
+    std::uint64_t program_id;
+    FizeauProfileId profile;
+};
+
 class Config {
     public:
         constexpr static FizeauSettings default_settings = {
@@ -44,6 +54,9 @@ class Config {
             std::string_view("/config/Fizeau/config.ini"),
         };
 
+        // Upper bound on the size of a generated config file
+        constexpr static std::size_t max_config_size = 0x2000;
+
     public:
         bool active = true, has_active_override = false;
 
@@ -58,24 +71,74 @@ class Config {
             .filter         = Component_None,
         };
 
+        // Keyframes of the edited profile, the first profile.num_keyframes are used
+        KeyframeArray keyframes = {};
+
+        // Rules of the [applications] section, only stored in the config file
+        std::array<AppRule, FIZEAU_MAX_APP_RULES> app_rules = {};
+        std::uint32_t num_app_rules = 0;
+
+        // Incremented whenever the edited profile changes, so that data derived from it can be cached
+        std::uint32_t generation = 0;
+
+        // Sysmodule version of the edited profile when it was read, see fizeauSetProfileIfVersion
+        std::uint32_t profile_version = 0;
+
+        // Profile and keyframes as last read from or written to the sysmodule, what was edited since is merged on a conflict
+        FizeauProfile base_profile = {};
+        KeyframeArray base_keyframes = {};
+
+        // Hash of the config file contents as last read or written, rewriting identical contents is skipped
+        std::uint64_t file_hash = 0;
+
         void (*parse_profile_switch_action)(Config *, FizeauProfileId) = nullptr;
+        // Keyframes parsed in the current section, the first one replaces those of the profile
+        std::uint32_t num_parsed_keyframes = 0;
 
     public:
         static int ini_handler(void *user, const char *section, const char *name, const char *value);
         static std::string_view find_config();
 
     public:
-        void read();
-        void write();
-        std::string make();
+        // Sends the parsed profiles, retrying while the sysmodule is booting. Returns the first failed write
+        Result read();
+        // Returns whether the file was written
+        bool write();
+        std::string_view make(std::span<char> buf);
 
-        Result update();
+        // Pulls the state of the sysmodule, instead of parsing the config file
+        Result update(bool is_external);
+        // Parses only whether the config file overrides the active state, and the application rules,
+        // needed before writing it back after update()
+        void read_active_override();
+
+        // If another client wrote the profile since it was read, the fields edited here are carried over to their
+        // version, which is written instead. FIZEAU_RC_VERSION_MISMATCH is returned if the conflicts persist
         Result apply();
+        // Same for the reset settings, the fields it does not cover keep the value of the other client
         Result reset();
         Result open_profile(FizeauProfileId id);
 
+        bool mark_changed(bool changed = true) {
+            this->generation += changed;
+            return changed;
+        }
+
     private:
+        // Bounds the writes attempted by apply and reset, retrying as long as other clients keep winning the race
+        constexpr static int max_write_attempts = 4;
+
         void sanitize_profile();
+
+        // Writes the profile with compare-and-set. On a conflict, the current version is read back,
+        // edit replays the changes on it and the write is retried
+        template <typename F>
+        Result write_profile(F &&edit);
+        void set_base();
+
+        Result fetch_keyframes(FizeauProfileId id);
+        Result stage_keyframes(FizeauProfileId id);
+        Result send_app_rules();
 };
 
 } // namespace fz
@@ -36,6 +36,17 @@ typedef enum {
     FizeauCommandId_SetProfile,
     FizeauCommandId_GetActiveProfileId,
     FizeauCommandId_SetActiveProfileId,
+    FizeauCommandId_DumpTrace,
+    FizeauCommandId_GetState,
+    FizeauCommandId_StageProfile,
+    FizeauCommandId_SetState,
+    FizeauCommandId_GetVersionedProfile,
+    FizeauCommandId_SetProfileIfVersion,
+    FizeauCommandId_GetKeyframe,
+    FizeauCommandId_StageKeyframe,
+    FizeauCommandId_GetAppProfile,
+    FizeauCommandId_SetAppProfile,
+    FizeauCommandId_ClearAppProfiles,
 } FizeauCommandId;
 
 typedef enum {
@@ -49,6 +60,13 @@ typedef enum {
 
 #define FIZEAU_RC_MODULE            R_MODULE(0xf12)
 #define FIZEAU_RC_INVALID_PROFILEID 1
+#define FIZEAU_RC_VERSION_MISMATCH  2
+#define FIZEAU_RC_INVALID_KEYFRAME  3
+#define FIZEAU_RC_TOO_MANY_APPS     4
+#define FIZEAU_RC_BUSY              5 // Writes while the sysmodule loads its config, queries are answered meanwhile
+
+#define FIZEAU_MAX_KEYFRAMES        8
+#define FIZEAU_MAX_APP_RULES        32
 
 #define FIZEAU_MAKERESULT(r) MAKERESULT(FIZEAU_RC_MODULE, FIZEAU_RC_ ## r)
 
@@ -71,8 +89,37 @@ typedef struct {
     Time dawn_begin, dawn_end;
 
     Time dimming_timeout;
+    uint32_t dimming_fade; // Duration over which the screen dims, in ms
+
+    // If non-zero, the keyframes of the profile replace the day/night settings and the dusk/dawn periods
+    uint32_t num_keyframes;
+
+    // If set, dusk and dawn follow the sun at this location (in degrees, north and east positive),
+    // the times above are only used on days without a sunrise or a sunset
+    bool has_location;
+    float latitude, longitude;
+
+    // Offsets to the settings of the internal panel in the dark, fading out as the ambient light reaches indoor levels.
+    // Ambient light is not followed if both are zero
+    int32_t ambient_temperature;
+    Luminance ambient_luminance;
 } FizeauProfile;
 
+// Settings reached at a time of day, the easing applies to the transition towards the next keyframe
+typedef struct {
+    Time time;
+    Easing easing;
+    FizeauSettings settings;
+} FizeauKeyframe;
+
+// Everything a client needs on startup, fetched in a single request
+typedef struct {
+    bool is_active;
+    FizeauProfileId internal_profile, external_profile;
+    FizeauProfile profile; // Active profile for the requested display
+    uint32_t profile_version;
+} FizeauState;
+
 Result fizeauIsServiceActive(bool *out);
 Result fizeauInitialize();
 void fizeauExit();
@@ -88,6 +135,32 @@ Result fizeauSetProfile(FizeauProfileId id, FizeauProfile *profile);
 Result fizeauGetActiveProfileId(bool is_external, FizeauProfileId *id);
 Result fizeauSetActiveProfileId(bool is_external, FizeauProfileId id);
 
+Result fizeauDumpTrace(void);
+
+Result fizeauGetState(bool is_external, FizeauState *state);
+
+// Updates a profile without committing it to the display, even if it is in use
+Result fizeauStageProfile(FizeauProfileId id, FizeauProfile *profile);
+// Sets the active state and profiles, and commits them along with any staged profile
+Result fizeauSetState(bool is_active, FizeauProfileId internal_profile, FizeauProfileId external_profile);
+
+// The sysmodule increments the version of a profile on every write, from any client
+Result fizeauGetVersionedProfile(FizeauProfileId id, FizeauProfile *profile, uint32_t *version);
+// Writes the profile only if nothing else did since *version was read, and sets *version to the new version.
+// Otherwise FIZEAU_RC_VERSION_MISMATCH is returned, and *version is set to the current version
+Result fizeauSetProfileIfVersion(FizeauProfileId id, FizeauProfile *profile, uint32_t *version);
+
+Result fizeauGetKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe);
+// Keyframes are too large to be sent along with their profile, they take effect with its next write
+Result fizeauStageKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe);
+
+// Applications can be set to a profile, which replaces the handheld and docked profiles while they run.
+// Rules take effect on the next application launch, FizeauProfileId_Invalid means no rule
+Result fizeauGetAppProfile(uint64_t program_id, FizeauProfileId *id);
+// Setting FizeauProfileId_Invalid removes the rule, FIZEAU_RC_TOO_MANY_APPS is returned past FIZEAU_MAX_APP_RULES
+Result fizeauSetAppProfile(uint64_t program_id, FizeauProfileId id);
+Result fizeauClearAppProfiles(void);
+
 #ifdef __cplusplus
 }
 #endif // __cplusplus
@@ -0,0 +1,99 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <span>
+
+#include "fizeau.h"
+#include "types.h"
+
+namespace fz {
+
+FizeauSettings interpolate_profile(const FizeauProfile &in, float factor, bool from_day);
+
+// Settings of a profile at a time of day, interpolated during dusk and dawn
+// is_night is set from the start of dusk to the start of dawn
+FizeauSettings evaluate_profile(const FizeauProfile &profile, Timestamp ts, bool &is_night);
+
+// Sunrise, sunset, and the limits of civil twilight (sun 6° below the horizon), in local time
+struct SolarTimes {
+    Time civil_dawn, sunrise, sunset, civil_dusk;
+};
+
+// Offline approximation of the solar position (within a minute or two below the polar circles),
+// for a local date in days since 1970-01-01 and an UTC offset in seconds.
+// Returns false on days where the sun doesn't rise or doesn't set.
+// When the sun stays above -6°, civil dusk and dawn are both placed at solar midnight
+bool compute_solar_times(float latitude, float longitude, std::int64_t day, std::int32_t utc_offset, SolarTimes &times);
+
+// Replaces the dusk and dawn periods of a profile with the solar times of a day, if the profile has a location:
+// dawn from civil dawn to sunrise, dusk from sunset to civil dusk
+void apply_solar_times(FizeauProfile &profile, std::int64_t day, std::int32_t utc_offset);
+
+// Schedule of a profile over a day, compiled into segments between consecutive keyframes.
+// Profiles without keyframes compile to their day, dusk, night and dawn periods, evaluated like evaluate_profile.
+// Evaluation is a search over the segment start times, then one multiply-add per setting
+class Timeline {
+    public:
+        constexpr static std::size_t MaxSegments = FIZEAU_MAX_KEYFRAMES;
+        static_assert(MaxSegments >= 4, "Day/night profiles need 4 segments");
+
+    public:
+        void compile(const FizeauProfile &profile, std::span<const FizeauKeyframe> keyframes);
+
+        // Index of the segment holding a time of day (in seconds)
+        std::uint32_t find(Timestamp ts) const;
+
+        FizeauSettings evaluate(Timestamp ts, std::uint32_t segment) const;
+
+        FizeauSettings evaluate(Timestamp ts) const {
+            return this->evaluate(ts, this->find(ts));
+        }
+
+        // Whether the settings change over the segment, as opposed to being held
+        bool is_transition(std::uint32_t segment) const {
+            return this->segments[segment].scale != 0.0f;
+        }
+
+        // From the start of dusk to the start of dawn, always false for keyframe schedules
+        bool is_night(std::uint32_t segment) const {
+            return this->segments[segment].is_night;
+        }
+
+    private:
+        struct Segment {
+            float scale;  // Inverse of the duration, null for held settings
+            Easing easing;
+            bool is_night;
+            FizeauSettings from;
+            std::array<float, 8> delta; // To the next settings, in the order of FizeauSettings
+        };
+
+        void add_segment(Timestamp begin, Timestamp end, const FizeauSettings &from, const FizeauSettings &to,
+            Easing easing, bool is_night);
+
+    private:
+        // Start times are kept apart from the segments for the search
+        std::array<std::uint32_t, MaxSegments> begins = {};
+        std::array<Segment, MaxSegments> segments = {};
+        std::uint32_t num_segments = 0;
+};
+
+} // namespace fz
@@ -17,6 +17,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <switch.h>
 
@@ -26,22 +27,33 @@ namespace fz {
 
 class Clock {
     public:
+        // Reads the local time from the time service, also called to resynchronize while other threads read the clock.
+        // Callers resynchronizing periodically keep the service open themselves (libnx counts its users),
+        // so that each call doesn't reconnect
         static Result initialize() {
             Result rc;
             if (rc = timeInitialize(); R_FAILED(rc))
                 goto exit;
 
-            Clock::tick = armGetSystemTick();
+            {
+                auto tick = armGetSystemTick();
 
-            std::uint64_t time;
-            if (rc = timeGetCurrentTime(TimeType_Default, &time); R_FAILED(rc))
-                goto exit;
+                std::uint64_t time;
+                if (rc = timeGetCurrentTime(TimeType_Default, &time); R_FAILED(rc))
+                    goto exit;
 
-            TimeCalendarTime caltime;
-            if (rc = timeToCalendarTimeWithMyRule(time, &caltime, nullptr); R_FAILED(rc))
-                goto exit;
+                TimeCalendarTime caltime;
+                TimeCalendarAdditionalInfo info;
+                if (rc = timeToCalendarTimeWithMyRule(time, &caltime, &info); R_FAILED(rc))
+                    goto exit;
 
-            Clock::timestamp = 60 * 60 * caltime.hour + 60 * caltime.minute + caltime.second;
+                Clock::store({
+                    .tick       = tick,
+                    .timestamp  = 60u * 60 * caltime.hour + 60 * caltime.minute + caltime.second,
+                    .day        = (static_cast<std::int64_t>(time) + info.offset) / (24*60*60),
+                    .utc_offset = info.offset,
+                });
+            }
 
             rc = 0;
 
@@ -51,7 +63,19 @@ exit:
         }
 
         static std::uint64_t get_current_timestamp() {
-            return (Clock::timestamp + armTicksToNs(armGetSystemTick() - Clock::tick) / 1'000'000'000) % (24*60*60);
+            auto state = Clock::load();
+            return (state.timestamp + armTicksToNs(armGetSystemTick() - state.tick) / 1'000'000'000) % (24*60*60);
+        }
+
+        // Local date, in days since 1970-01-01
+        static std::int64_t get_current_day() {
+            auto state = Clock::load();
+            return state.day + (state.timestamp + armTicksToNs(armGetSystemTick() - state.tick) / 1'000'000'000) / (24*60*60);
+        }
+
+        // Offset of the local time zone from UTC, in seconds
+        static std::int32_t get_utc_offset() {
+            return Clock::load().utc_offset;
         }
 
         static Time get_current_time() {
@@ -71,8 +95,39 @@ exit:
         }
 
     private:
-        static inline std::uint64_t tick      = 0;
-        static inline std::uint64_t timestamp = 0;
+        // Time of day at a system tick, and the date and time zone it was read in
+        struct State {
+            std::uint64_t tick;
+            std::uint64_t timestamp;
+            std::int64_t  day;
+            std::int32_t  utc_offset;
+        };
+
+        // Sequence lock, the sequence is odd while a resynchronization writes the state.
+        // Readers copy it until they see the same even sequence before and after, so that fields are never mixed
+        static State load() {
+            State state;
+            std::uint32_t seq;
+            do {
+                seq   = Clock::sequence.load(std::memory_order_acquire);
+                state = Clock::state;
+                std::atomic_thread_fence(std::memory_order_acquire);
+            } while ((seq & 1) || seq != Clock::sequence.load(std::memory_order_relaxed));
+            return state;
+        }
+
+        // Only one thread resynchronizes at a time
+        static void store(const State &state) {
+            auto seq = Clock::sequence.load(std::memory_order_relaxed);
+            Clock::sequence.store(seq + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            Clock::state = state;
+            Clock::sequence.store(seq + 2, std::memory_order_release);
+        }
+
+    private:
+        static inline State state = {};
+        static inline std::atomic_uint32_t sequence = 0;
 };
 
 } // namespace fz
@@ -72,6 +72,14 @@ typedef struct {
 #define DEFAULT_RANGE         { MIN_RANGE,         MAX_RANGE }
 #define DEFAULT_LIMITED_RANGE { MIN_LIMITED_RANGE, MAX_LIMITED_RANGE}
 
+// Curve followed by the settings between two keyframes
+typedef enum {
+    Easing_Linear,
+    Easing_Smoothstep,
+    Easing_Exponential,
+    Easing_Total,
+} Easing;
+
 typedef uint64_t Timestamp;
 typedef struct {
     uint8_t h, m, s;
@@ -0,0 +1,129 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <algorithm>
+#include <common.hpp>
+
+#include "cmu.hpp"
+
+namespace fz {
+
+void calculate_cmu(Cmu &cmu, const FizeauSettings &settings, Component components, Component filter) {
+    cmu.reset();
+
+    // Calculate initial coefficients
+    auto coeffs = filter_matrix(filter);
+
+    // Apply temperature color correction
+    ColorMatrix m = {};
+    std::tie(m[0], m[4], m[8]) = whitepoint(settings.temperature);
+    m[0] = degamma(m[0], 2.4f), m[4] = degamma(m[4], 2.4f), m[8] = degamma(m[8], 2.4f);
+    coeffs = dot(coeffs, m);
+
+    // Apply contrast multiplier
+    auto c = contrast_slant(settings.contrast);
+    m[0] = m[4] = m[8] = c;
+    coeffs = dot(coeffs, m);
+
+    // Apply saturation
+    coeffs = dot(coeffs, saturation_matrix(settings.saturation));
+
+    // Apply hue rotation
+    coeffs = dot(coeffs, hue_matrix(settings.hue));
+
+    // Copy calculated coefficients to the cmu matrix if they are enabled
+    if (components & Component_Red)
+        std::copy_n(coeffs.begin() + 0, 3, &cmu.krr);
+    if (components & Component_Green)
+        std::copy_n(coeffs.begin() + 3, 3, &cmu.krg);
+    if (components & Component_Blue)
+        std::copy_n(coeffs.begin() + 6, 3, &cmu.krb);
+
+    // Calculate gamma ramps, with contrast offset
+    float off = (1.0f - c) / 2.0f;
+    degamma_ramp(cmu.lut_1.data(), cmu.lut_1.size(), DEFAULT_GAMMA, 12);                                // Set the LUT1 with a fixed gamma corresponding to the incoming data
+    regamma_ramp(cmu.lut_2.data(), 512, settings.gamma, 8, 0.0f, 0.125f, off);                          // Set the first part of LUT2 (more precision in darker components)
+    regamma_ramp(cmu.lut_2.data() + 512, cmu.lut_2.size() - 512, settings.gamma, 8, 0.125f, 1.0f, off); // Set the second part of LUT2 (less precision in brighter components)
+
+    // Apply luminance
+    apply_luma(cmu.lut_2.data(), cmu.lut_2.size(), 8, settings.luminance);
+
+    // Apply color range
+    apply_range(cmu.lut_2.data(), cmu.lut_2.size(), 8,
+        settings.range.lo, std::min(settings.range.hi, cmu.lut_2.back() / 255.0f)); // Adjust max for luma
+}
+
+namespace cmu {
+
+namespace {
+
+constexpr std::int32_t clamp(std::int32_t val) {
+    return std::clamp(val >> QS18::Fractional, 0, 0xfff);
+}
+
+} // namespace
+
+bool is_identity(const Cmu &cmu, std::int32_t tolerance) {
+    if (!cmu.enable)
+        return true;
+
+    std::array<std::int32_t, 9> k;
+    std::transform(&cmu.krr, &cmu.krr + k.size(), k.begin(), coefficient);
+    if (k[1] || k[2] || k[3] || k[5] || k[6] || k[7])
+        return false;
+
+    for (auto diag: { k[0], k[4], k[8] }) {
+        for (std::int32_t v = 0; v < static_cast<std::int32_t>(cmu.lut_1.size()); ++v) {
+            auto out = cmu.lut_2[lut2_index(clamp(diag * (cmu.lut_1[v] & 0xfff)))] & 0xff;
+            if (std::abs(out - v) > tolerance)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+Model::Model(const Cmu &cmu): enable(cmu.enable) {
+    std::transform(&cmu.krr, &cmu.krr + this->csc.size(), this->csc.begin(), coefficient);
+    std::transform(cmu.lut_1.begin(), cmu.lut_1.end(), this->lut_1.begin(), [](std::uint16_t v) { return v & 0xfff; });
+
+    for (std::size_t i = 0; i < this->lut_2.size(); ++i)
+        this->lut_2[i] = cmu.lut_2[lut2_index(i)];
+}
+
+void Model::apply(const std::uint8_t *src, std::uint8_t *dst, std::size_t num_pixels, std::size_t bpp) const {
+    if (!this->enable) {
+        if (src != dst)
+            std::copy_n(src, num_pixels * bpp, dst);
+        return;
+    }
+
+    auto &k = this->csc;
+    for (std::size_t i = 0; i < num_pixels; ++i, src += bpp, dst += bpp) {
+        std::int32_t r = this->lut_1[src[0]], g = this->lut_1[src[1]], b = this->lut_1[src[2]];
+        if (bpp == 4)
+            dst[3] = src[3];
+        dst[0] = this->lut_2[clamp(k[0] * r + k[1] * g + k[2] * b)];
+        dst[1] = this->lut_2[clamp(k[3] * r + k[4] * g + k[5] * b)];
+        dst[2] = this->lut_2[clamp(k[6] * r + k[7] * g + k[8] * b)];
+    }
+}
+
+} // namespace cmu
+
+} // namespace fz
@@ -15,10 +15,11 @@
 // You should have received a copy of the GNU General Public License
 // along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdio>
 #include <cstring>
 #include <algorithm>
 #include <bit>
-#include <string>
+#include <charconv>
 #include <ini.h>
 #include <common.hpp>
 #include <sys/stat.h>
@@ -30,6 +31,101 @@ namespace fz {
 
 #define COMMENT ";"
 
+namespace {
+
+// FNV-1a
+constexpr std::uint64_t hash_contents(std::string_view str, std::uint64_t hash = 0xcbf29ce484222325) {
+    for (auto c: str)
+        hash = (hash ^ static_cast<std::uint8_t>(c)) * 0x100000001b3;
+    return hash;
+}
+
+// Parses the config file, and hashes its contents on the way
+int parse_config(ini_handler handler, void *user, std::uint64_t &hash) {
+    auto loc = Config::find_config();
+    auto *fp = std::fopen(loc.data(), "r");
+    if (!fp)
+        return -1;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    struct ReadContext {
+        FILE *fp;
+        std::uint64_t hash;
+    } ctx = { fp, hash_contents({}) };
+
+    auto res = ini_parse_stream(+[](char *str, int num, void *stream) -> char * {
+        auto *ctx = static_cast<ReadContext *>(stream);
+        if (!std::fgets(str, num, ctx->fp))
+            return nullptr;
+        ctx->hash = hash_contents(str, ctx->hash);
+        return str;
+    }, &ctx, handler, user);
+
+    hash = ctx.hash;
+    return res;
+}
+
+// Writes are rejected while the sysmodule loads its config at boot, they are retried with a backoff (about 1.3s in
+// total) before the result is passed on
+template <typename F>
+Result retry_while_busy(F &&write) {
+    auto rc = write();
+    for (std::int64_t delay = 10'000'000; rc == FIZEAU_MAKERESULT(BUSY) && delay <= 640'000'000; delay *= 2)
+        svcSleepThread(delay), rc = write();
+    return rc;
+}
+
+// Field comparisons for the merge of concurrent edits, structures are compared by member as they hold padding
+template <typename T>
+bool same(const T &a, const T &b) {
+    return a == b;
+}
+
+bool same(const ColorRange &a, const ColorRange &b) {
+    return a.lo == b.lo && a.hi == b.hi;
+}
+
+bool same(const Time &a, const Time &b) {
+    return to_timestamp(a) == to_timestamp(b);
+}
+
+bool same(const FizeauSettings &a, const FizeauSettings &b) {
+    return same(a.temperature, b.temperature) && same(a.saturation, b.saturation) && same(a.hue, b.hue) &&
+        same(a.contrast, b.contrast) && same(a.gamma, b.gamma) && same(a.luminance, b.luminance) && same(a.range, b.range);
+}
+
+bool same(const FizeauKeyframe &a, const FizeauKeyframe &b) {
+    return same(a.time, b.time) && a.easing == b.easing && same(a.settings, b.settings);
+}
+
+// Sets the members of dst that differ between base and edited to their edited value
+template <typename T, typename... Ms>
+void carry(const T &base, const T &edited, T &dst, Ms T::*...members) {
+    ([&](auto T::*m) {
+        if (!same(edited.*m, base.*m))
+            dst.*m = edited.*m;
+    }(members), ...);
+}
+
+// Carries the fields edited since base over to dst, the keyframe count is left to the caller
+void merge_profile(const FizeauProfile &base, const FizeauProfile &edited, FizeauProfile &dst) {
+    for (auto s: { &FizeauProfile::day_settings, &FizeauProfile::night_settings }) {
+        carry(base.*s, edited.*s, dst.*s, &FizeauSettings::temperature, &FizeauSettings::saturation, &FizeauSettings::hue,
+            &FizeauSettings::contrast, &FizeauSettings::gamma, &FizeauSettings::luminance, &FizeauSettings::range);
+    }
+
+    carry(base, edited, dst, &FizeauProfile::components, &FizeauProfile::filter,
+        &FizeauProfile::dusk_begin, &FizeauProfile::dusk_end, &FizeauProfile::dawn_begin, &FizeauProfile::dawn_end,
+        &FizeauProfile::dimming_timeout, &FizeauProfile::dimming_fade,
+        &FizeauProfile::ambient_temperature, &FizeauProfile::ambient_luminance);
+
+    // The location is edited as a whole
+    if (edited.has_location != base.has_location || edited.latitude != base.latitude || edited.longitude != base.longitude)
+        dst.has_location = edited.has_location, dst.latitude = edited.latitude, dst.longitude = edited.longitude;
+}
+
+} // namespace
+
 std::string_view Config::find_config() {
     struct stat tmp;
     for (auto loc: config_locations) {
@@ -39,24 +135,92 @@ std::string_view Config::find_config() {
     return config_locations[1];
 };
 
-void Config::read() {
-    if (!this->parse_profile_switch_action) {
-        this->parse_profile_switch_action = +[](Config *self, FizeauProfileId profile_id) {
-            if (self->cur_profile_id != FizeauProfileId_Invalid)
-                if (auto rc = self->apply(); R_FAILED(rc))
-                    LOG("Failed to apply config: %#x\n", rc);
+Result Config::read() {
+    // Profiles are parsed into memory, seeded from the sysmodule copy so that missing keys keep their value,
+    // and only sent once the whole file has been read. The sysmodule then commits at most once per display
+    struct ReadContext: Config {
+        std::array<FizeauProfile, FizeauProfileId_Total> profiles, initial_profiles;
+        std::array<KeyframeArray, FizeauProfileId_Total> schedules, initial_schedules;
+        std::uint32_t parsed_mask;
+    } ctx = { *this, {}, {}, {}, {}, 0 };
+
+    ctx.cur_profile_id = FizeauProfileId_Invalid;
+    ctx.num_app_rules  = 0;
+    ctx.parse_profile_switch_action = +[](Config *config, FizeauProfileId profile_id) {
+        auto *self = static_cast<ReadContext *>(config);
+
+        if (self->cur_profile_id < FizeauProfileId_Total) {
+            self->profiles [self->cur_profile_id] = self->profile;
+            self->schedules[self->cur_profile_id] = self->keyframes;
+        }
+
+        if (profile_id >= FizeauProfileId_Total)
+            return;
+
+        if (!(self->parsed_mask & BIT(profile_id))) {
             if (auto rc = self->open_profile(profile_id); R_FAILED(rc))
                 LOG("Failed to open profile: %#x\n", rc);
-        };
+            self->profiles[profile_id] = self->initial_profiles[profile_id] = self->profile;
+            self->schedules[profile_id] = self->initial_schedules[profile_id] = self->keyframes;
+            self->parsed_mask |= BIT(profile_id);
+        }
+
+        self->profile   = self->profiles [profile_id];
+        self->keyframes = self->schedules[profile_id];
+    };
+
+    parse_config(Config::ini_handler, static_cast<Config *>(&ctx), this->file_hash);
+
+    // Flush the last section
+    ctx.parse_profile_switch_action(&ctx, FizeauProfileId_Invalid);
+
+    this->active              = ctx.active;
+    this->has_active_override = ctx.has_active_override;
+    this->internal_profile    = ctx.internal_profile;
+    this->external_profile    = ctx.external_profile;
+    this->app_rules           = ctx.app_rules;
+    this->num_app_rules       = ctx.num_app_rules;
+
+    // Failed writes do not stop the others, the first failure is returned
+    Result res = 0;
+    auto check = [&res](Result rc, const char *what) {
+        if (R_FAILED(rc)) {
+            LOG("Failed to %s: %#x\n", what, rc);
+            res = R_FAILED(res) ? res : rc;
+        }
+    };
+
+    check(retry_while_busy([this] { return this->send_app_rules(); }), "send application rules");
+
+    FizeauState state;
+    if (auto rc = fizeauGetState(false, &state); R_FAILED(rc)) {
+        LOG("Failed to get state: %#x\n", rc);
+        return rc;
     }
 
-    auto loc = Config::find_config();
-    ini_parse(loc.data(), Config::ini_handler, this);
+    // Profiles are staged without side effects, a commit is only needed if a displayed profile changed
+    bool needs_commit = state.is_active != this->active ||
+        state.internal_profile != this->internal_profile || state.external_profile != this->external_profile;
 
-    if (this->cur_profile_id != FizeauProfileId_Invalid) {
-        if (auto rc = this->apply(); R_FAILED(rc))
-            LOG("Failed to apply config: %#x\n", rc);
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id) {
+        if (!(ctx.parsed_mask & BIT(id)) || (!std::memcmp(&ctx.profiles[id], &ctx.initial_profiles[id], sizeof(FizeauProfile)) &&
+                !std::memcmp(&ctx.schedules[id], &ctx.initial_schedules[id], sizeof(KeyframeArray))))
+            continue;
+
+        ctx.profile   = ctx.profiles [id];
+        ctx.keyframes = ctx.schedules[id];
+        auto profile_id = static_cast<FizeauProfileId>(id);
+        check(retry_while_busy([&] { return ctx.stage_keyframes(profile_id); }), "stage keyframes");
+        check(retry_while_busy([&] { return fizeauStageProfile(profile_id, &ctx.profiles[id]); }), "stage profile");
+
+        needs_commit |= id == this->internal_profile || id == this->external_profile;
     }
+
+    if (needs_commit)
+        check(retry_while_busy([this] { return fizeauSetState(this->active, this->internal_profile, this->external_profile); }),
+            "apply config");
+
+    return res;
 }
 
 void Config::sanitize_profile() {
@@ -107,65 +271,127 @@ void Config::sanitize_profile() {
 
     sanitize_colorrange(this->profile.day_settings  .range);
     sanitize_colorrange(this->profile.night_settings.range);
+
+    sanitize_minmax(this->profile.latitude,  -90.0f,  90.0f);
+    sanitize_minmax(this->profile.longitude, -180.0f, 180.0f);
+
+    sanitize_minmax(this->profile.dimming_fade, 0, 10'000);
+
+    sanitize_minmax(this->profile.ambient_temperature, -static_cast<int>(MAX_TEMP - MIN_TEMP), MAX_TEMP - MIN_TEMP);
+    sanitize_minmax(this->profile.ambient_luminance,   MIN_LUMA - MAX_LUMA, MAX_LUMA - MIN_LUMA);
+
+    sanitize_minmax(this->profile.num_keyframes, 0, this->keyframes.size());
+    for (std::size_t i = 0; i < this->profile.num_keyframes; ++i) {
+        auto &k = this->keyframes[i];
+        sanitize_time(k.time);
+        sanitize_minmax(k.easing,               Easing_Linear, Easing_Exponential);
+        sanitize_minmax(k.settings.temperature, MIN_TEMP,      MAX_TEMP);
+        sanitize_minmax(k.settings.saturation,  MIN_SAT,       MAX_SAT);
+        sanitize_minmax(k.settings.hue,         MIN_HUE,       MAX_HUE);
+        sanitize_minmax(k.settings.contrast,    MIN_CONTRAST,  MAX_CONTRAST);
+        sanitize_minmax(k.settings.gamma,       MIN_GAMMA,     MAX_GAMMA);
+        sanitize_minmax(k.settings.luminance,   MIN_LUMA,      MAX_LUMA);
+        sanitize_colorrange(k.settings.range);
+    }
 }
 
-std::string Config::make() {
-    auto format = []<typename ...Args>(const std::string_view &fmt, Args &&...args) -> std::string {
-        std::string str(std::snprintf(nullptr, 0, fmt.data(), args...), 0);
-        std::snprintf(str.data(), str.capacity(), fmt.data(), args...);
-        return str;
-    };
+std::string_view Config::make(std::span<char> buf) {
+    // Formats in place, the output is truncated if the buffer is too small
+    struct Writer {
+        char *cur, *end;
 
-    auto format_profile = [&format](FizeauProfileId id) -> std::string {
-        return format("profile%u", id + 1);
-    };
+        void str(std::string_view s) {
+            auto len = std::min(s.size(), static_cast<std::size_t>(this->end - this->cur));
+            this->cur = std::copy_n(s.data(), len, this->cur);
+        }
 
-    auto format_filter = [](Component f) -> std::string {
-        switch (f) {
-            case Component_Red:   return "red";
-            case Component_Green: return "green";
-            case Component_Blue:  return "blue";
-            default:              return "none";
+        void chr(char c) {
+            if (this->cur != this->end)
+                *this->cur++ = c;
         }
-    };
 
-    auto format_components = [](Component c) -> std::string {
-        if (c == Component_None) {
-            return "none";
-        } else if (c == Component_All) {
-            return "all";
-        } else {
-            std::string s;
-            if (c & Component_Red)   s.push_back('r');
-            if (c & Component_Green) s.push_back('g');
-            if (c & Component_Blue)  s.push_back('b');
-            return s;
+        void num(std::uint32_t v, int width = 0) {
+            char tmp[10];
+            auto *p = std::to_chars(tmp, tmp + sizeof(tmp), v).ptr;
+            for (auto n = p - tmp; n < width; ++n)
+                this->chr('0');
+            this->str({ tmp, static_cast<std::size_t>(p - tmp) });
         }
-    };
 
-    auto format_time = [&format](Time t) -> std::string {
-        return format("%02d:%02d", t.h, t.m);
-    };
+        void num(float v, int precision) {
+            char tmp[0x30];
+            auto *p = std::to_chars(tmp, tmp + sizeof(tmp), v, std::chars_format::fixed, precision).ptr;
+            this->str({ tmp, static_cast<std::size_t>(p - tmp) });
+        }
 
-    auto format_range = [&format](ColorRange r) -> std::string {
-        return format("%.2f-%.2f", r.lo, r.hi);
-    };
+        void hex(std::uint64_t v) {
+            char tmp[16];
+            auto *p = std::to_chars(tmp, tmp + sizeof(tmp), v, 16).ptr;
+            for (auto n = p - tmp; n < 16; ++n)
+                this->chr('0');
+            this->str({ tmp, static_cast<std::size_t>(p - tmp) });
+        }
+
+        void entry(std::string_view key) {
+            this->str(key);
+            for (auto n = key.size(); n < 18; ++n)
+                this->chr(' ');
+            this->str("= ");
+        }
+
+        void profile(FizeauProfileId id) {
+            this->str("profile");
+            this->num(id + 1);
+        }
+
+        void time(std::uint32_t a, std::uint32_t b) {
+            this->num(a, 2), this->chr(':'), this->num(b, 2);
+        }
 
-    std::string str;
+        void range(ColorRange r) {
+            this->num(r.lo, 2), this->chr('-'), this->num(r.hi, 2);
+        }
+
+        void filter(Component f) {
+            switch (f) {
+                case Component_Red:   return this->str("red");
+                case Component_Green: return this->str("green");
+                case Component_Blue:  return this->str("blue");
+                default:              return this->str("none");
+            }
+        }
+
+        void easing(Easing e) {
+            switch (e) {
+                case Easing_Smoothstep:  return this->str("smoothstep");
+                case Easing_Exponential: return this->str("exponential");
+                default:                 return this->str("linear");
+            }
+        }
 
-    str += std::string(this->has_active_override ? "" : COMMENT) + "active            = " + (this->active ? "true" : "false") + '\n';
-    str += '\n';
+        void components(Component c) {
+            if (c == Component_None) {
+                this->str("none");
+            } else if (c == Component_All) {
+                this->str("all");
+            } else {
+                if (c & Component_Red)   this->chr('r');
+                if (c & Component_Green) this->chr('g');
+                if (c & Component_Blue)  this->chr('b');
+            }
+        }
+    } w = { buf.data(), buf.data() + buf.size() };
 
+    if (!this->has_active_override)
+        w.str(COMMENT);
+    w.entry("active"), w.str(this->active ? "true" : "false"), w.chr('\n');
+    w.chr('\n');
 
-    if (this->internal_profile < FizeauProfileId_Total)
-        str += "handheld_profile  = " + format_profile(this->internal_profile) + '\n';
-    else
-        str += "handheld_profile  = " + format_profile(FizeauProfileId_Profile1) + '\n';
-    if (this->external_profile < FizeauProfileId_Total)
-        str += "docked_profile    = " + format_profile(this->external_profile) + '\n';
-    else
-        str += "docked_profile    = " + format_profile(FizeauProfileId_Profile2) + '\n';
-    str += '\n';
+    w.entry("handheld_profile");
+    w.profile(this->internal_profile < FizeauProfileId_Total ? this->internal_profile : FizeauProfileId_Profile1), w.chr('\n');
+    w.entry("docked_profile");
+    w.profile(this->external_profile < FizeauProfileId_Total ? this->external_profile : FizeauProfileId_Profile2), w.chr('\n');
+    w.chr('\n');
 
     for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id) {
         if (auto rc = this->open_profile(static_cast<FizeauProfileId>(id)); R_FAILED(rc))
@@ -173,96 +399,252 @@ std::string Config::make() {
 
         this->sanitize_profile();
 
-        str += "[profile" + std::to_string(this->cur_profile_id + 1) + "]\n";
+        auto &p = this->profile;
+
+        w.chr('['), w.profile(this->cur_profile_id), w.str("]\n");
+
+        w.entry("dusk_begin"),        w.time(p.dusk_begin.h, p.dusk_begin.m),                 w.chr('\n');
+        w.entry("dusk_end"),          w.time(p.dusk_end.h,   p.dusk_end.m),                   w.chr('\n');
+        w.entry("dawn_begin"),        w.time(p.dawn_begin.h, p.dawn_begin.m),                 w.chr('\n');
+        w.entry("dawn_end"),          w.time(p.dawn_end.h,   p.dawn_end.m),                   w.chr('\n');
 
-        str += "dusk_begin        = " + format_time(this->profile.dusk_begin)                    + '\n';
-        str += "dusk_end          = " + format_time(this->profile.dusk_end)                      + '\n';
-        str += "dawn_begin        = " + format_time(this->profile.dawn_begin)                    + '\n';
-        str += "dawn_end          = " + format_time(this->profile.dawn_end)                      + '\n';
+        if (p.has_location)
+            w.entry("location"),      w.num(p.latitude, 4), w.chr(','), w.num(p.longitude, 4), w.chr('\n');
 
-        str += "temperature_day   = " + std::to_string(this->profile.day_settings  .temperature) + '\n';
-        str += "temperature_night = " + std::to_string(this->profile.night_settings.temperature) + '\n';
+        w.entry("temperature_day"),   w.num(p.day_settings  .temperature),                   w.chr('\n');
+        w.entry("temperature_night"), w.num(p.night_settings.temperature),                   w.chr('\n');
 
-        str += "saturation_day    = " + std::to_string(this->profile.day_settings  .saturation)  + '\n';
-        str += "saturation_night  = " + std::to_string(this->profile.night_settings.saturation)  + '\n';
+        w.entry("saturation_day"),    w.num(p.day_settings  .saturation, 6),                 w.chr('\n');
+        w.entry("saturation_night"),  w.num(p.night_settings.saturation, 6),                 w.chr('\n');
 
-        str += "hue_day           = " + std::to_string(this->profile.day_settings  .hue)         + '\n';
-        str += "hue_night         = " + std::to_string(this->profile.night_settings.hue)         + '\n';
+        w.entry("hue_day"),           w.num(p.day_settings  .hue, 6),                        w.chr('\n');
+        w.entry("hue_night"),         w.num(p.night_settings.hue, 6),                        w.chr('\n');
 
-        str += "components        = " + format_components(this->profile.components)              + '\n';
+        w.entry("components"),        w.components(p.components),                            w.chr('\n');
 
-        str += "filter            = " + format_filter(this->profile.filter)                      + '\n';
+        w.entry("filter"),            w.filter(p.filter),                                    w.chr('\n');
 
-        str += "contrast_day      = " + std::to_string(this->profile.day_settings  .contrast)    + '\n';
-        str += "contrast_night    = " + std::to_string(this->profile.night_settings.contrast)    + '\n';
+        w.entry("contrast_day"),      w.num(p.day_settings  .contrast, 6),                   w.chr('\n');
+        w.entry("contrast_night"),    w.num(p.night_settings.contrast, 6),                   w.chr('\n');
 
-        str += "gamma_day         = " + std::to_string(this->profile.day_settings  .gamma)       + '\n';
-        str += "gamma_night       = " + std::to_string(this->profile.night_settings.gamma)       + '\n';
+        w.entry("gamma_day"),         w.num(p.day_settings  .gamma, 6),                      w.chr('\n');
+        w.entry("gamma_night"),       w.num(p.night_settings.gamma, 6),                      w.chr('\n');
 
-        str += "luminance_day     = " + std::to_string(this->profile.day_settings  .luminance)   + '\n';
-        str += "luminance_night   = " + std::to_string(this->profile.night_settings.luminance)   + '\n';
+        w.entry("luminance_day"),     w.num(p.day_settings  .luminance, 6),                  w.chr('\n');
+        w.entry("luminance_night"),   w.num(p.night_settings.luminance, 6),                  w.chr('\n');
 
-        str += "range_day         = " + format_range(this->profile.day_settings  .range)         + '\n';
-        str += "range_night       = " + format_range(this->profile.night_settings.range)         + '\n';
+        w.entry("range_day"),         w.range(p.day_settings  .range),                       w.chr('\n');
+        w.entry("range_night"),       w.range(p.night_settings.range),                       w.chr('\n');
 
-        str += "dimming_timeout   = " + format_time({ this->profile.dimming_timeout.m, this->profile.dimming_timeout.s }) + '\n';
+        w.entry("dimming_timeout"),   w.time(p.dimming_timeout.m, p.dimming_timeout.s),      w.chr('\n');
+        w.entry("dimming_fade"),      w.num(p.dimming_fade),                                 w.chr('\n');
 
-        str += '\n';
+        if (p.ambient_temperature || p.ambient_luminance) {
+            w.entry("ambient");
+            if (p.ambient_temperature < 0)
+                w.chr('-');
+            w.num(static_cast<std::uint32_t>(p.ambient_temperature < 0 ? -p.ambient_temperature : p.ambient_temperature));
+            w.chr(' '), w.num(p.ambient_luminance, 6), w.chr('\n');
+        }
+
+        for (std::size_t i = 0; i < p.num_keyframes; ++i) {
+            auto &k = this->keyframes[i];
+            w.entry("keyframe"), w.time(k.time.h, k.time.m), w.chr(' '), w.easing(k.easing), w.chr(' ');
+            w.num(k.settings.temperature),   w.chr(' '), w.num(k.settings.saturation, 6), w.chr(' ');
+            w.num(k.settings.hue, 6),        w.chr(' '), w.num(k.settings.contrast, 6),   w.chr(' ');
+            w.num(k.settings.gamma, 6),      w.chr(' '), w.num(k.settings.luminance, 6),  w.chr(' ');
+            w.range(k.settings.range),       w.chr('\n');
+        }
+
+        w.chr('\n');
     }
 
-    return str;
+    if (this->num_app_rules) {
+        w.str("[applications]\n");
+        for (std::size_t i = 0; i < this->num_app_rules; ++i) {
+            auto &r = this->app_rules[i];
+            w.hex(r.program_id), w.str("  = "), w.profile(r.profile), w.chr('\n');
+        }
+    }
+
+    return { buf.data(), static_cast<std::size_t>(w.cur - buf.data()) };
 }
 
-void Config::write() {
-    auto str = this->make();
+bool Config::write() {
+    std::array<char, Config::max_config_size> buf;
+    auto str = this->make(buf);
+    if (str.size() == buf.size()) {
+        LOG("Config too large, not writing\n");
+        return false;
+    }
+
+    auto hash = hash_contents(str);
+    if (hash == this->file_hash)
+        return false;
 
     auto loc = Config::find_config();
     FILE *fp = std::fopen(loc.data(), "w");
-    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+    FZ_SCOPEGUARD([&fp] { if (fp) std::fclose(fp); });
     if (!fp)
-        return;
+        return false;
 
-    std::fwrite(str.c_str(), str.length(), 1, fp);
+    if (std::fwrite(str.data(), str.size(), 1, fp) != 1)
+        return false;
+
+    this->file_hash = hash;
+    return true;
 }
 
-Result update(Config &config) {
-    if (auto rc = fizeauGetIsActive(&config.active); R_FAILED(rc))
+Result Config::update(bool is_external) {
+    FizeauState state;
+    if (auto rc = fizeauGetState(is_external, &state); R_FAILED(rc))
         return rc;
 
-    if (auto rc = fizeauGetActiveProfileId(false, &config.internal_profile); R_FAILED(rc))
-        return rc;
+    this->active           = state.is_active;
+    this->internal_profile = state.internal_profile;
+    this->external_profile = state.external_profile;
 
-    if (auto rc = fizeauGetActiveProfileId(true,  &config.external_profile); R_FAILED(rc))
-        return rc;
+    // Without a profile set for the display, edit the one the config file would get (see make)
+    auto id = !is_external ? state.internal_profile : state.external_profile;
+    if (id >= FizeauProfileId_Total)
+        return this->open_profile(!is_external ? FizeauProfileId_Profile1 : FizeauProfileId_Profile2);
 
-    if (auto rc = fizeauGetProfile(config.internal_profile, &config.profile); R_FAILED(rc))
+    this->cur_profile_id   = id;
+    this->profile          = state.profile;
+    this->profile_version  = state.profile_version;
+    this->mark_changed();
+    if (auto rc = this->fetch_keyframes(this->cur_profile_id); R_FAILED(rc))
         return rc;
 
+    this->set_base();
     return 0;
 }
 
+void Config::read_active_override() {
+    this->num_app_rules = 0;
+    parse_config(+[](void *user, const char *section, const char *name, const char *value) -> int {
+        if (!section[0] && !std::strcmp(name, "active"))
+            static_cast<Config *>(user)->has_active_override = true;
+        else if (!std::strcmp(section, "applications"))
+            return Config::ini_handler(user, section, name, value);
+        return 1;
+    }, this, this->file_hash);
+}
+
+template <typename F>
+Result Config::write_profile(F &&edit) {
+    auto count = std::min<std::size_t>(this->profile.num_keyframes, this->keyframes.size());
+    bool keyframes_edited = this->profile.num_keyframes != this->base_profile.num_keyframes ||
+        !std::equal(this->keyframes.begin(), this->keyframes.begin() + count, this->base_keyframes.begin(),
+            [](auto &a, auto &b) { return same(a, b); });
+
+    for (int i = 0; i < Config::max_write_attempts; ++i) {
+        // Staging overwrites the keyframes of other clients, so they are only sent when edited here
+        if (keyframes_edited) {
+            if (auto rc = retry_while_busy([this] { return this->stage_keyframes(this->cur_profile_id); }); R_FAILED(rc))
+                return rc;
+        }
+
+        auto rc = retry_while_busy([this] {
+            return fizeauSetProfileIfVersion(this->cur_profile_id, &this->profile, &this->profile_version);
+        });
+        if (rc != FIZEAU_MAKERESULT(VERSION_MISMATCH)) {
+            if (R_SUCCEEDED(rc))
+                this->set_base();
+            return rc;
+        }
+
+        FizeauProfile current;
+        if (auto rc = fizeauGetVersionedProfile(this->cur_profile_id, &current, &this->profile_version); R_FAILED(rc))
+            return rc;
+
+        this->base_profile = current;
+        edit(current, keyframes_edited);
+        this->profile = current;
+        this->mark_changed();
+
+        if (!keyframes_edited) {
+            if (auto rc = this->fetch_keyframes(this->cur_profile_id); R_FAILED(rc))
+                return rc;
+            this->base_keyframes = this->keyframes;
+        }
+    }
+
+    return FIZEAU_MAKERESULT(VERSION_MISMATCH);
+}
+
+void Config::set_base() {
+    this->base_profile   = this->profile;
+    this->base_keyframes = this->keyframes;
+}
+
 Result Config::apply() {
-    return fizeauSetProfile(this->cur_profile_id, &this->profile);
+    return this->write_profile([base = this->base_profile, edited = this->profile](FizeauProfile &current, bool keyframes_edited) {
+        merge_profile(base, edited, current);
+        if (keyframes_edited)
+            current.num_keyframes = edited.num_keyframes;
+    });
 }
 
 Result Config::reset() {
-    this->profile.day_settings.temperature = DEFAULT_TEMP,     this->profile.night_settings.temperature = DEFAULT_TEMP;
-    this->profile.day_settings.saturation  = DEFAULT_SAT,      this->profile.night_settings.saturation  = DEFAULT_SAT;
-    this->profile.day_settings.hue         = DEFAULT_HUE,      this->profile.night_settings.hue         = DEFAULT_HUE;
-    this->profile.day_settings.contrast    = DEFAULT_CONTRAST, this->profile.night_settings.contrast    = DEFAULT_CONTRAST;
-    this->profile.day_settings.gamma       = DEFAULT_GAMMA,    this->profile.night_settings.gamma       = DEFAULT_GAMMA;
-    this->profile.day_settings.luminance   = DEFAULT_LUMA,     this->profile.night_settings.luminance   = DEFAULT_LUMA;
-    this->profile.day_settings.range       = DEFAULT_RANGE,    this->profile.night_settings.range       = DEFAULT_RANGE;
-    this->profile.components = Component_All;
-    this->profile.filter     = Component_None;
-    return this->apply();
+    auto reset_profile = [](FizeauProfile &profile, bool) {
+        profile.day_settings.temperature = DEFAULT_TEMP,     profile.night_settings.temperature = DEFAULT_TEMP;
+        profile.day_settings.saturation  = DEFAULT_SAT,      profile.night_settings.saturation  = DEFAULT_SAT;
+        profile.day_settings.hue         = DEFAULT_HUE,      profile.night_settings.hue         = DEFAULT_HUE;
+        profile.day_settings.contrast    = DEFAULT_CONTRAST, profile.night_settings.contrast    = DEFAULT_CONTRAST;
+        profile.day_settings.gamma       = DEFAULT_GAMMA,    profile.night_settings.gamma       = DEFAULT_GAMMA;
+        profile.day_settings.luminance   = DEFAULT_LUMA,     profile.night_settings.luminance   = DEFAULT_LUMA;
+        profile.day_settings.range       = DEFAULT_RANGE,    profile.night_settings.range       = DEFAULT_RANGE;
+        profile.components = Component_All;
+        profile.filter     = Component_None;
+        profile.num_keyframes = 0;
+    };
+
+    reset_profile(this->profile, false);
+    this->mark_changed();
+    return this->write_profile(reset_profile);
 }
 
 Result Config::open_profile(FizeauProfileId id) {
-    if (auto rc = fizeauGetProfile(id, &this->profile); R_FAILED(rc))
+    if (auto rc = fizeauGetVersionedProfile(id, &this->profile, &this->profile_version); R_FAILED(rc))
         return rc;
 
     this->cur_profile_id = id;
+    this->mark_changed();
+    if (auto rc = this->fetch_keyframes(id); R_FAILED(rc))
+        return rc;
+
+    this->set_base();
+    return 0;
+}
+
+Result Config::fetch_keyframes(FizeauProfileId id) {
+    auto count = std::min<std::size_t>(this->profile.num_keyframes, this->keyframes.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        if (auto rc = fizeauGetKeyframe(id, i, &this->keyframes[i]); R_FAILED(rc))
+            return rc;
+    }
+    return 0;
+}
+
+Result Config::send_app_rules() {
+    if (auto rc = fizeauClearAppProfiles(); R_FAILED(rc))
+        return rc;
+
+    for (std::size_t i = 0; i < this->num_app_rules; ++i) {
+        if (auto rc = fizeauSetAppProfile(this->app_rules[i].program_id, this->app_rules[i].profile); R_FAILED(rc))
+            return rc;
+    }
+
+    return 0;
+}
+
+Result Config::stage_keyframes(FizeauProfileId id) {
+    auto count = std::min<std::size_t>(this->profile.num_keyframes, this->keyframes.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        if (auto rc = fizeauStageKeyframe(id, i, &this->keyframes[i]); R_FAILED(rc))
+            return rc;
+    }
     return 0;
 }
 
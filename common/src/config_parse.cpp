@@ -1,6 +1,7 @@
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
+#include <algorithm>
 
 #include "config.hpp"
 
@@ -79,8 +80,11 @@ int Config::ini_handler(void *user, const char *section, const char *name, const
     Config *config = static_cast<Config *>(user);
     std::string_view v = value;
 
+    // Names past the last profile are invalid, the ids index fixed arrays of profiles
     auto profile_name_to_id = [](const std::string_view &str) -> FizeauProfileId {
-        return static_cast<FizeauProfileId>(str.back() - '0' - 1);
+        auto id = !str.empty() ? str.back() - '0' - 1 : -1;
+        return (id >= FizeauProfileId_Profile1 && id < FizeauProfileId_Total) ?
+            static_cast<FizeauProfileId>(id) : FizeauProfileId_Invalid;
     };
 
     auto parse_components = [](const std::string_view &str) -> Component {
@@ -127,21 +131,69 @@ int Config::ini_handler(void *user, const char *section, const char *name, const
 
     static_assert(parse_range("0.18-0.92") == ColorRange{0.18, 0.92});
 
+    // hh:mm easing [temperature saturation hue contrast gamma luminance range], missing settings take their default
+    auto parse_keyframe = [&](std::string_view str) -> FizeauKeyframe {
+        FizeauKeyframe k = { .easing = Easing_Linear, .settings = Config::default_settings };
+
+        auto next = [&str]() {
+            auto start = std::min(str.find_first_not_of(' '), str.size());
+            auto end   = std::min(str.find(' ', start), str.size());
+            auto tok   = substr(str, start, end - start);
+            str = substr(str, end);
+            return tok;
+        };
+
+        k.time = parse_time(next());
+
+        auto easing = next();
+        if (easing == "smoothstep")
+            k.easing = Easing_Smoothstep;
+        else if (easing == "exponential")
+            k.easing = Easing_Exponential;
+
+        auto &s = k.settings;
+        if (auto t = next(); !t.empty()) s.temperature = atoi(t);
+        if (auto t = next(); !t.empty()) s.saturation  = atof(t);
+        if (auto t = next(); !t.empty()) s.hue         = atof(t);
+        if (auto t = next(); !t.empty()) s.contrast    = atof(t);
+        if (auto t = next(); !t.empty()) s.gamma       = atof(t);
+        if (auto t = next(); !t.empty()) s.luminance   = atof(t);
+        if (auto t = next(); !t.empty()) s.range       = parse_range(t);
+        return k;
+    };
+
     if (MATCH_ENTRY("", "active")) {
         if (MATCH(value, "1") || strcasecmp(value, "true") == 0)
             config->active = true;
         else
             config->active = false;
         config->has_active_override = true;
-    } else if (MATCH_ENTRY("", "handheld_profile")) {
-        config->internal_profile = profile_name_to_id(v);
-    } else if (MATCH_ENTRY("", "docked_profile")) {
-        config->external_profile = profile_name_to_id(v);
+    } else if (MATCH_ENTRY("", "handheld_profile") || MATCH_ENTRY("", "docked_profile")) {
+        auto id = profile_name_to_id(v);
+        if (id == FizeauProfileId_Invalid)
+            return 0;
+        (MATCH(name, "handheld_profile") ? config->internal_profile : config->external_profile) = id;
+    } else if (MATCH(section, "applications")) {
+        // Program id in hex = profile, the last rule for an application wins
+        auto program_id = std::strtoull(name, nullptr, 16);
+        auto profile    = profile_name_to_id(v);
+        if (!program_id || profile < FizeauProfileId_Profile1 || profile >= FizeauProfileId_Total)
+            return 1;
+
+        auto begin = config->app_rules.begin(), end = begin + config->num_app_rules;
+        if (auto it = std::find_if(begin, end, [&](auto &r) { return r.program_id == program_id; }); it != end)
+            it->profile = profile;
+        else if (config->num_app_rules < config->app_rules.size())
+            config->app_rules[config->num_app_rules++] = { program_id, profile };
     } else if (std::strcmp(section, "profile") > 0) {
         auto id = profile_name_to_id(section);
+        if (id == FizeauProfileId_Invalid)
+            return 0;
+
         if (config->cur_profile_id != id && config->parse_profile_switch_action) {
             config->parse_profile_switch_action(config, id);
             config->cur_profile_id = id;
+            config->num_parsed_keyframes = 0;
         }
 
         void *target = nullptr;
@@ -195,6 +247,24 @@ int Config::ini_handler(void *user, const char *section, const char *name, const
         } else if (MATCH(name, "dimming_timeout")) {
             auto t = parse_time(v);
             config->profile.dimming_timeout = { 0, t.h, t.m };
+        } else if (MATCH(name, "dimming_fade")) {
+            p.dimming_fade = atoi(v);
+        } else if (MATCH(name, "location")) {
+            auto pos = v.find(',');
+            p.has_location = pos != std::string_view::npos;
+            p.latitude     = atof(substr(v, 0, pos));
+            p.longitude    = p.has_location ? atof(substr(v, pos + 1)) : 0.0f;
+        } else if (MATCH(name, "ambient")) {
+            // Temperature and luminance offsets in the dark
+            auto pos = std::min(v.find(' '), v.size());
+            p.ambient_temperature = atoi(substr(v, 0, pos));
+            auto luminance = substr(v, std::min(v.find_first_not_of(' ', pos), v.size()));
+            p.ambient_luminance   = !luminance.empty() ? atof(luminance) : 0.0f;
+        } else if (MATCH(name, "keyframe")) {
+            if (config->num_parsed_keyframes < config->keyframes.size()) {
+                config->keyframes[config->num_parsed_keyframes++] = parse_keyframe(v);
+                p.num_keyframes = config->num_parsed_keyframes;
+            }
         }
     } else {
         return 0;
@@ -99,3 +99,114 @@ Result fizeauSetActiveProfileId(bool is_external, FizeauProfileId id) {
     } tmp = { is_external, id };
     return serviceDispatchIn(&g_fizeau_srv, FizeauCommandId_SetActiveProfileId, tmp);
 }
+
+Result fizeauDumpTrace(void) {
+    return serviceDispatch(&g_fizeau_srv, FizeauCommandId_DumpTrace);
+}
+
+Result fizeauGetState(bool is_external, FizeauState *state) {
+    FizeauState tmp;
+    Result rc = serviceDispatchInOut(&g_fizeau_srv, FizeauCommandId_GetState, is_external, tmp);
+
+    if (R_SUCCEEDED(rc) && state)
+        *state = tmp;
+
+    return rc;
+}
+
+Result fizeauStageProfile(FizeauProfileId id, FizeauProfile *profile) {
+    struct {
+        FizeauProfileId id;
+        FizeauProfile profile;
+    } tmp = { id, *profile };
+    return serviceDispatchIn(&g_fizeau_srv, FizeauCommandId_StageProfile, tmp);
+}
+
+Result fizeauSetState(bool is_active, FizeauProfileId internal_profile, FizeauProfileId external_profile) {
+    struct {
+        bool is_active;
+        FizeauProfileId internal_profile, external_profile;
+    } tmp = { is_active, internal_profile, external_profile };
+    return serviceDispatchIn(&g_fizeau_srv, FizeauCommandId_SetState, tmp);
+}
+
+Result fizeauGetVersionedProfile(FizeauProfileId id, FizeauProfile *profile, uint32_t *version) {
+    struct {
+        uint32_t version;
+        FizeauProfile profile;
+    } tmp;
+    Result rc = serviceDispatchInOut(&g_fizeau_srv, FizeauCommandId_GetVersionedProfile, id, tmp);
+
+    if (R_SUCCEEDED(rc) && profile)
+        *profile = tmp.profile;
+    if (R_SUCCEEDED(rc) && version)
+        *version = tmp.version;
+
+    return rc;
+}
+
+Result fizeauSetProfileIfVersion(FizeauProfileId id, FizeauProfile *profile, uint32_t *version) {
+    struct {
+        FizeauProfileId id;
+        uint32_t version;
+        FizeauProfile profile;
+    } in = { id, *version, *profile };
+    struct {
+        bool written;
+        uint32_t version;
+    } out;
+    Result rc = serviceDispatchInOut(&g_fizeau_srv, FizeauCommandId_SetProfileIfVersion, in, out);
+
+    if (R_SUCCEEDED(rc)) {
+        *version = out.version;
+        if (!out.written)
+            rc = FIZEAU_MAKERESULT(VERSION_MISMATCH);
+    }
+
+    return rc;
+}
+
+Result fizeauGetKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe) {
+    struct {
+        FizeauProfileId id;
+        uint32_t index;
+    } in = { id, index };
+    FizeauKeyframe tmp;
+    Result rc = serviceDispatchInOut(&g_fizeau_srv, FizeauCommandId_GetKeyframe, in, tmp);
+
+    if (R_SUCCEEDED(rc) && keyframe)
+        *keyframe = tmp;
+
+    return rc;
+}
+
+Result fizeauStageKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe) {
+    struct {
+        FizeauProfileId id;
+        uint32_t index;
+        FizeauKeyframe keyframe;
+    } tmp = { id, index, *keyframe };
+    return serviceDispatchIn(&g_fizeau_srv, FizeauCommandId_StageKeyframe, tmp);
+}
+
+Result fizeauGetAppProfile(uint64_t program_id, FizeauProfileId *id) {
+    FizeauProfileId tmp;
+    Result rc = serviceDispatchInOut(&g_fizeau_srv, FizeauCommandId_GetAppProfile, program_id, tmp);
+
+    if (R_SUCCEEDED(rc) && id)
+        *id = tmp;
+
+    return rc;
+}
+
+Result fizeauSetAppProfile(uint64_t program_id, FizeauProfileId id) {
+    struct {
+        uint64_t program_id;
+        FizeauProfileId id;
+    } tmp = { program_id, id };
+    return serviceDispatchIn(&g_fizeau_srv, FizeauCommandId_SetAppProfile, tmp);
+}
+
+Result fizeauClearAppProfiles(void) {
+    return serviceDispatch(&g_fizeau_srv, FizeauCommandId_ClearAppProfiles);
+}
@@ -0,0 +1,252 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <algorithm>
+#include <numbers>
+
+#include <common.hpp>
+
+namespace fz {
+
+FizeauSettings interpolate_profile(const FizeauProfile &in, float factor, bool from_day) {
+    const FizeauSettings &from =  from_day ? in.day_settings : in.night_settings,
+                         &to   = !from_day ? in.day_settings : in.night_settings;
+
+    return {
+        .temperature     = static_cast<Temperature>(std::lerp(from.temperature, to.temperature, factor)),
+        .saturation      = std::lerp(from.saturation, to.saturation, factor),
+        .hue             = std::lerp(from.hue,        to.hue,        factor),
+        .contrast        = std::lerp(from.contrast,   to.contrast,   factor),
+        .gamma           = std::lerp(from.gamma,      to.gamma,      factor),
+        .luminance       = std::lerp(from.luminance,  to.luminance,  factor),
+        .range           = {
+                           std::lerp(from.range.lo,   to.range.lo,   factor),
+                           std::lerp(from.range.hi,   to.range.hi,   factor),
+        },
+    };
+}
+
+FizeauSettings evaluate_profile(const FizeauProfile &profile, Timestamp ts, bool &is_night) {
+    auto dub = to_timestamp(profile.dusk_begin), due = to_timestamp(profile.dusk_end),
+         dab = to_timestamp(profile.dawn_begin), dae = to_timestamp(profile.dawn_end);
+
+    if (Clock::is_in_interval(ts, dub, due)) {
+        is_night = true;
+        return interpolate_profile(profile, static_cast<float>(due - ts) / static_cast<float>(due - dub), false);
+    } else if (Clock::is_in_interval(ts, dab, dae)) {
+        is_night = false;
+        return interpolate_profile(profile, static_cast<float>(dae - ts) / static_cast<float>(dae - dab), true);
+    } else if (Clock::is_in_interval(ts, dae, dub)) {
+        is_night = false;
+        return profile.day_settings;
+    } else {
+        is_night = true;
+        return profile.night_settings;
+    }
+}
+
+namespace {
+
+constexpr Timestamp seconds_per_day = 24 * 60 * 60;
+
+// Time of day from minutes since midnight UTC, wrapped into the local day
+Time to_local_time(double utc_minutes, std::int32_t utc_offset) {
+    auto s = static_cast<std::int64_t>(std::round(utc_minutes * 60.0)) + utc_offset;
+    return from_timestamp(static_cast<Timestamp>((s % seconds_per_day + seconds_per_day) % seconds_per_day));
+}
+
+float ease(Easing easing, float t) {
+    switch (easing) {
+        case Easing_Smoothstep:
+            return t * t * (3.0f - 2.0f * t);
+        case Easing_Exponential:
+            // Normalized 2^(4t), slow start then fast finish
+            return (std::exp2(4.0f * t) - 1.0f) * (1.0f / 15.0f);
+        case Easing_Linear:
+        default:
+            return t;
+    }
+}
+
+} // namespace
+
+bool compute_solar_times(float latitude, float longitude, std::int64_t day, std::int32_t utc_offset, SolarTimes &times) {
+    constexpr double rad = std::numbers::pi / 180.0;
+
+    // Low precision solar coordinates from the Astronomical Almanac, evaluated at the local solar noon,
+    // n is in days from J2000.0 (2000-01-01 12:00 UTC, day 10957)
+    double n = static_cast<double>(day - 10957) - longitude / 360.0;
+
+    double l   = std::fmod(280.460 + 0.9856474 * n, 360.0);                        // Mean longitude
+    double g   = std::fmod(357.528 + 0.9856003 * n, 360.0) * rad;                  // Mean anomaly
+    double lam = (l + 1.915 * std::sin(g) + 0.020 * std::sin(2.0 * g)) * rad;      // Ecliptic longitude
+    double eps = (23.439 - 0.0000004 * n) * rad;                                   // Obliquity of the ecliptic
+
+    double ra   = std::atan2(std::cos(eps) * std::sin(lam), std::cos(lam));
+    double decl = std::asin(std::sin(eps) * std::sin(lam));
+
+    // Equation of time, in minutes
+    double eqt = std::remainder(l - ra / rad, 360.0) * 4.0;
+    double noon = 720.0 - 4.0 * longitude - eqt;
+
+    // Hour angle of the sun at an altitude, NaN if it stays above or below it
+    double phi = latitude * rad;
+    auto hour_angle = [&](double altitude) {
+        double cos_h = (std::sin(altitude * rad) - std::sin(phi) * std::sin(decl)) / (std::cos(phi) * std::cos(decl));
+        return (cos_h >= -1.0 && cos_h <= 1.0) ? std::acos(cos_h) / rad * 4.0 : NAN;
+    };
+
+    // Standard refraction and solar radius
+    double rise = hour_angle(-0.833);
+    if (std::isnan(rise))
+        return false;
+
+    double civil = hour_angle(-6.0);
+    if (std::isnan(civil))
+        civil = 720.0;
+
+    times = {
+        .civil_dawn = to_local_time(noon - civil, utc_offset),
+        .sunrise    = to_local_time(noon - rise,  utc_offset),
+        .sunset     = to_local_time(noon + rise,  utc_offset),
+        .civil_dusk = to_local_time(noon + civil, utc_offset),
+    };
+    return true;
+}
+
+void apply_solar_times(FizeauProfile &profile, std::int64_t day, std::int32_t utc_offset) {
+    SolarTimes times;
+    if (!profile.has_location || !compute_solar_times(profile.latitude, profile.longitude, day, utc_offset, times))
+        return;
+
+    profile.dawn_begin = times.civil_dawn, profile.dawn_end = times.sunrise;
+    profile.dusk_begin = times.sunset,     profile.dusk_end = times.civil_dusk;
+}
+
+void Timeline::add_segment(Timestamp begin, Timestamp end, const FizeauSettings &from, const FizeauSettings &to,
+        Easing easing, bool is_night) {
+    auto duration = (end + seconds_per_day - begin) % seconds_per_day;
+
+    auto &seg = this->segments[this->num_segments];
+    seg = {
+        .scale    = 0.0f,
+        .easing   = easing,
+        .is_night = is_night,
+        .from     = from,
+        .delta    = {
+            static_cast<float>(to.temperature) - static_cast<float>(from.temperature),
+            to.saturation - from.saturation,
+            to.hue        - from.hue,
+            to.contrast   - from.contrast,
+            to.gamma      - from.gamma,
+            to.luminance  - from.luminance,
+            to.range.lo   - from.range.lo,
+            to.range.hi   - from.range.hi,
+        },
+    };
+
+    if (std::any_of(seg.delta.begin(), seg.delta.end(), [](float d) { return d != 0.0f; }))
+        seg.scale = 1.0f / static_cast<float>(duration ? duration : seconds_per_day);
+
+    this->begins[this->num_segments++] = begin;
+}
+
+void Timeline::compile(const FizeauProfile &profile, std::span<const FizeauKeyframe> keyframes) {
+    this->num_segments = 0;
+
+    if (profile.num_keyframes == 0 || keyframes.empty()) {
+        // Same periods as evaluate_profile, a zero-length period is skipped
+        struct {
+            Time begin, end;
+            const FizeauSettings *from, *to;
+            bool is_night;
+        } periods[] = {
+            { profile.dawn_end,   profile.dusk_begin, &profile.day_settings,   &profile.day_settings,   false },
+            { profile.dusk_begin, profile.dusk_end,   &profile.day_settings,   &profile.night_settings, true  },
+            { profile.dusk_end,   profile.dawn_begin, &profile.night_settings, &profile.night_settings, true  },
+            { profile.dawn_begin, profile.dawn_end,   &profile.night_settings, &profile.day_settings,   false },
+        };
+
+        std::sort(std::begin(periods), std::end(periods), [](auto &a, auto &b) { return a.begin < b.begin; });
+        for (auto &p: periods) {
+            if (p.begin != p.end)
+                this->add_segment(to_timestamp(p.begin), to_timestamp(p.end), *p.from, *p.to, Easing_Linear, p.is_night);
+        }
+    } else {
+        std::array<const FizeauKeyframe *, MaxSegments> sorted;
+        auto count = std::min({ std::size_t(profile.num_keyframes), keyframes.size(), sorted.size() });
+        for (std::size_t i = 0; i < count; ++i)
+            sorted[i] = &keyframes[i];
+
+        std::stable_sort(sorted.begin(), sorted.begin() + count, [](auto *a, auto *b) { return a->time < b->time; });
+
+        for (std::size_t i = 0; i < count; ++i) {
+            auto &from = *sorted[i];
+            auto *to = sorted[(i + 1) % count];
+
+            if (from.time == to->time) {
+                // Keyframes at the same time make a step, the first one is skipped
+                if (i + 1 < count)
+                    continue;
+                // All keyframes are at the same time, hold the last one for the whole day
+                to = &from;
+            }
+
+            this->add_segment(to_timestamp(from.time), to_timestamp(to->time), from.settings, to->settings, from.easing, false);
+        }
+    }
+
+    // Every period was empty, which evaluate_profile treats as night
+    if (this->num_segments == 0)
+        this->add_segment(0, 0, profile.night_settings, profile.night_settings, Easing_Linear, true);
+}
+
+std::uint32_t Timeline::find(Timestamp ts) const {
+    auto *end = this->begins.data() + this->num_segments;
+    auto *it = std::upper_bound(this->begins.data(), end, static_cast<std::uint32_t>(ts));
+
+    // Before the first segment is the end of the last one, which wraps around midnight
+    return (it == this->begins.data() ? end : it) - this->begins.data() - 1;
+}
+
+FizeauSettings Timeline::evaluate(Timestamp ts, std::uint32_t segment) const {
+    auto &seg = this->segments[segment];
+    if (seg.scale == 0.0f)
+        return seg.from;
+
+    // The segment may wrap around midnight
+    auto begin = this->begins[segment];
+    auto elapsed = ts >= begin ? ts - begin : ts + seconds_per_day - begin;
+    auto f = ease(seg.easing, std::min(static_cast<float>(elapsed) * seg.scale, 1.0f));
+
+    auto &d = seg.delta;
+    return {
+        .temperature = static_cast<Temperature>(static_cast<float>(seg.from.temperature) + d[0] * f),
+        .saturation  = seg.from.saturation + d[1] * f,
+        .hue         = seg.from.hue        + d[2] * f,
+        .contrast    = seg.from.contrast   + d[3] * f,
+        .gamma       = seg.from.gamma      + d[4] * f,
+        .luminance   = seg.from.luminance  + d[5] * f,
+        .range       = {
+                       seg.from.range.lo   + d[6] * f,
+                       seg.from.range.hi   + d[7] * f,
+        },
+    };
+}
+
+} // namespace fz
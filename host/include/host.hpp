@@ -0,0 +1,89 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <switch.h>
+
+// Backends of the libnx shim. A host program installs its own implementations
+// in fz::host::backends, otherwise the shim falls back to inert defaults
+
+namespace fz::host {
+
+// When enabled, the system tick only advances through advance(), and the wall clock follows it
+struct VirtualClock {
+    bool enabled = false;
+    std::uint64_t tick  = 0; // System ticks since start
+    std::uint64_t epoch = 0; // POSIX time at tick 0
+    std::int32_t utc_offset = 0; // Of the local time zone, in s
+
+    void advance(std::uint64_t ns) {
+        this->tick += armNsToTicks(ns);
+    }
+};
+
+// nvdrv device nodes (nvOpen/nvIoctl/nvClose)
+class DisplayBackend {
+    public:
+        virtual Result open(u32 *fd, const char *path) = 0;
+        virtual Result ioctl(u32 fd, u32 request, void *argp) = 0;
+};
+
+// Physical IO regions (svcQueryMemoryMapping)
+class MmioBackend {
+    public:
+        virtual Result map(std::uint64_t *va, std::uint64_t pa, std::uint64_t size) = 0;
+
+        // Brings the modelled hardware up to a system tick, as virtual time passes
+        virtual void advance(std::uint64_t tick) { }
+
+        // Accesses to mapped registers (READ/WRITE)
+        virtual std::uint32_t read(std::uint64_t va) {
+            return *reinterpret_cast<volatile std::uint32_t *>(va);
+        }
+
+        virtual void write(std::uint64_t va, std::uint32_t val) {
+            *reinterpret_cast<volatile std::uint32_t *>(va) = val;
+        }
+};
+
+// System state normally reported by omm, insr and pm
+class EventBackend {
+    public:
+        virtual AppletOperationMode get_operation_mode() = 0;
+        virtual std::uint64_t get_last_activity_tick() = 0;
+        virtual std::uint64_t get_application_id() = 0; // Program id, 0 when no application runs
+};
+
+// Ambient light sensor normally read through lbl, reported unavailable if not installed
+class LightSensorBackend {
+    public:
+        virtual float get_illuminance() = 0; // lux
+};
+
+struct Backends {
+    VirtualClock clock;
+    DisplayBackend     *display = nullptr;
+    MmioBackend        *mmio    = nullptr;
+    EventBackend       *events  = nullptr;
+    LightSensorBackend *light   = nullptr;
+};
+
+extern constinit Backends backends;
+
+} // namespace fz::host
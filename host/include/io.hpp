@@ -0,0 +1,38 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <array>
+#include <string>
+
+#include <common.hpp>
+
+namespace fz::host {
+
+using ProfileArray  = std::array<FizeauProfile, FizeauProfileId_Total>;
+using ScheduleArray = std::array<KeyframeArray, FizeauProfileId_Total>;
+
+// Returns an empty string on failure
+std::string read_file(const char *path);
+
+// Parses a config file like the sysmodule does at boot, storing each profile section into the array.
+// Profiles absent from the file are left untouched. Keyframes are stored if schedules is given
+bool load_config(const char *path, Config &config, ProfileArray &profiles, ScheduleArray *schedules = nullptr);
+
+} // namespace fz::host
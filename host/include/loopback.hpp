@@ -0,0 +1,64 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <switch.h>
+
+// In-process loopback for the kernel IPC primitives used by sysmodule/src/ipc_server.c.
+// Everything runs on one thread: clients queue connections and requests, then the server
+// is stepped with ipcServerProcess until their replies are available.
+// The libnx client functions used by common/src/fizeau.c are implemented on top of it
+
+namespace fz::host::loopback {
+
+using ClientId = std::uint32_t;
+
+// Queues a connection to a registered service, accepted on the next server step
+Result connect(const char *name, ClientId *id);
+
+// Closes the client end. The server sees it on its next step, and deletes its session
+void close(ClientId id);
+
+// Sends a request. Only one request can be pending per session
+Result send(ClientId id, std::uint64_t cmd_id, const void *in, std::size_t in_size);
+
+template <typename T>
+Result send(ClientId id, std::uint64_t cmd_id, const T &in) {
+    return send(id, cmd_id, &in, sizeof(in));
+}
+
+// Returns whether the reply to the pending request has arrived, and if so its result and output data.
+// KERNELRESULT(ConnectionClosed) is returned in rc if the server closed the session
+bool receive(ClientId id, Result *rc, void *out = nullptr, std::size_t out_size = 0);
+
+// Whether the session was accepted and is still open on both ends
+bool is_connected(ClientId id);
+
+// Whether the server has anything to process
+bool has_pending();
+
+// Drops all ports and sessions
+void reset();
+
+// Server step run by the blocking client functions of the libnx shim (smGetService, serviceDispatch)
+// while they wait for a reply, in place of the sysmodule thread
+void set_server_step(void (*step)(void *user), void *user);
+
+} // namespace fz::host::loopback
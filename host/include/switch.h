@@ -0,0 +1,438 @@
+/**
+ * Copyright (c) 2024 averne
+ *
+ * This file is part of Fizeau.
+ *
+ * Fizeau is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Fizeau is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Minimal stand-in for the libnx headers, so that the platform-independent parts
+// of the code can be built and profiled on a workstation.
+// Only what is used by the host build is declared here, implementations are in src/nx.cpp
+
+#ifndef _FZ_HOST_SWITCH_H
+#define _FZ_HOST_SWITCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t   s8;
+typedef int16_t  s16;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+typedef u32 Result;
+typedef u32 Handle;
+
+#define INVALID_HANDLE ((Handle)0)
+
+#define BIT(n) (1U << (n))
+
+#define NX_INLINE __attribute__((always_inline)) static inline
+#ifdef __cplusplus
+#   define NX_CONSTEXPR NX_INLINE constexpr
+#else
+#   define NX_CONSTEXPR NX_INLINE
+#endif
+
+// Result codes
+
+#define R_SUCCEEDED(res)   ((res) == 0)
+#define R_FAILED(res)      ((res) != 0)
+#define R_MODULE(res)      ((res) & 0x1ff)
+#define R_DESCRIPTION(res) (((res) >> 9) & 0x1fff)
+#define R_VALUE(res)       ((res) & 0x3fffff)
+
+#define MAKERESULT(module, description) \
+    ((((module) & 0x1ff)) | ((description) & 0x1fff) << 9)
+
+enum {
+    Module_Kernel = 1,
+    Module_Libnx  = 345,
+};
+
+enum {
+    KernelError_OutOfSessions    = 7,
+    KernelError_NotImplemented   = 33,
+    KernelError_TimedOut         = 117,
+    KernelError_ConnectionClosed = 123,
+};
+
+enum {
+    LibnxError_OutOfMemory    = 2,
+    LibnxError_NotInitialized = 8,
+    LibnxError_NotFound       = 9,
+    LibnxError_BadInput       = 11,
+};
+
+#define KERNELRESULT(desc) MAKERESULT(Module_Kernel, KernelError_##desc)
+
+#define MAX_WAIT_OBJECTS 0x40
+
+// Diagnostics
+
+__attribute__((noreturn)) void diagAbortWithResult(Result res);
+
+// Services
+
+typedef struct {
+    Handle session;
+} Service;
+
+typedef struct {
+    char name[8];
+} SmServiceName;
+
+NX_INLINE SmServiceName smEncodeName(const char *name) {
+    SmServiceName out = {};
+    for (int i = 0; i < 8 && name[i]; ++i)
+        out.name[i] = name[i];
+    return out;
+}
+
+Result smRegisterService(Handle *handle_out, SmServiceName name, bool is_light, s32 max_sessions);
+Result smUnregisterService(SmServiceName name);
+
+// Client side, for common/src/fizeau.c. Dispatches only carry inline data, and block until the server replied
+
+Result smGetService(Service *service_out, const char *name);
+void serviceClose(Service *s);
+
+Result serviceDispatchImpl(Service *s, u32 request_id, const void *in_data, u32 in_data_size, void *out_data, u32 out_data_size);
+
+#define serviceDispatch(_s, _rid, ...) \
+    serviceDispatchImpl((_s), (_rid), NULL, 0, NULL, 0)
+#define serviceDispatchIn(_s, _rid, _in, ...) \
+    serviceDispatchImpl((_s), (_rid), &(_in), sizeof(_in), NULL, 0)
+#define serviceDispatchOut(_s, _rid, _out, ...) \
+    serviceDispatchImpl((_s), (_rid), NULL, 0, &(_out), sizeof(_out))
+#define serviceDispatchInOut(_s, _rid, _in, _out, ...) \
+    serviceDispatchImpl((_s), (_rid), &(_in), sizeof(_in), &(_out), sizeof(_out))
+
+typedef struct {
+    Handle session;
+} TipcService;
+
+TipcService *smGetServiceSessionTipc(void);
+
+// Only the sm extension querying whether a service is registered is implemented
+Result tipcDispatchImpl(TipcService *s, u32 request_id, const void *in_data, u32 in_data_size, void *out_data, u32 out_data_size);
+
+#define tipcDispatchInOut(_s, _rid, _in, _out, ...) \
+    tipcDispatchImpl((_s), (_rid), &(_in), sizeof(_in), &(_out), sizeof(_out))
+
+// IPC, carried by the in-process loopback transport of src/loopback.cpp.
+// Messages use a simplified layout: a type word, a size word, then the CMIF data aligned to 16 bytes
+
+typedef enum {
+    CmifCommandType_Invalid = 0,
+    CmifCommandType_Close   = 2,
+    CmifCommandType_Request = 4,
+} CmifCommandType;
+
+#define CMIF_IN_HEADER_MAGIC  0x49434653 // "SFCI"
+#define CMIF_OUT_HEADER_MAGIC 0x4F434653 // "SFCO"
+
+typedef struct {
+    u32 type;
+    u32 num_data_words;
+} HipcMetadata;
+
+typedef struct {
+    HipcMetadata meta;
+    struct {
+        u32 *data_words;
+    } data;
+} HipcParsedRequest;
+
+typedef struct {
+    u32 *data_words;
+} HipcRequest;
+
+void *armGetTls(void);
+
+HipcParsedRequest hipcParseRequest(void *base);
+HipcRequest hipcMakeRequest(void *base, HipcMetadata meta);
+#define hipcMakeRequestInline(_base, ...) hipcMakeRequest((_base), (HipcMetadata){ __VA_ARGS__ })
+
+NX_INLINE void *cmifGetAlignedDataStart(u32 *data_words, void *base) {
+    return (void *)(((uintptr_t)data_words + 15) & ~(uintptr_t)15);
+}
+
+Result svcCloseHandle(Handle handle);
+Result svcAcceptSession(Handle *session_handle, Handle port_handle);
+Result svcWaitSynchronization(s32 *index, const Handle *handles, s32 handle_count, s64 timeout);
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handle_count, Handle reply_target, u64 timeout);
+
+// Kernel memory mappings
+
+Result svcQueryMemoryMapping(u64 *virtaddr, u64 *out_size, u64 physaddr, u64 size);
+
+// Synchronization and threads.
+// No threads are spawned on the host, the functions run by sysmodule threads are called directly instead
+
+// Advances the virtual clock when enabled
+void svcSleepThread(s64 nano);
+
+typedef u32 Mutex;
+
+void mutexLock(Mutex *m);
+bool mutexTryLock(Mutex *m);
+void mutexUnlock(Mutex *m);
+
+typedef struct {
+    Handle revent, wevent;
+    bool autoclear;
+} Event;
+
+typedef struct {
+    bool signaled, auto_clear;
+} UEvent;
+
+typedef enum {
+    TimerType_OneShot,
+    TimerType_Repeating,
+} TimerType;
+
+typedef struct {
+    TimerType type;
+    bool started;
+    u64 next_tick;
+    u64 interval;
+} UTimer;
+
+typedef struct {
+    u32 type;
+    void *object;
+} Waiter;
+
+NX_INLINE Waiter waiterForEvent(Event *e)   { return (Waiter){ 0, e }; }
+NX_INLINE Waiter waiterForUEvent(UEvent *e) { return (Waiter){ 1, e }; }
+NX_INLINE Waiter waiterForUTimer(UTimer *t) { return (Waiter){ 2, t }; }
+
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout);
+
+#define waitMulti(idx_out, timeout, ...) ({                                                 \
+    Waiter __waiters[] = { __VA_ARGS__ };                                                   \
+    waitObjects((idx_out), __waiters, sizeof(__waiters) / sizeof(Waiter), (timeout));       \
+})
+
+void eventClose(Event *t);
+void ueventCreate(UEvent *e, bool auto_clear);
+void ueventSignal(UEvent *e);
+void utimerCreate(UTimer *t, u64 interval, TimerType type);
+void utimerStart(UTimer *t);
+
+typedef void (*ThreadFunc)(void *);
+
+typedef struct {
+    Handle handle;
+    ThreadFunc entry;
+    void *arg;
+} Thread;
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid);
+Result threadStart(Thread *t);
+Result threadWaitForExit(Thread *t);
+Result threadClose(Thread *t);
+
+// Applet
+
+typedef enum {
+    AppletOperationMode_Handheld = 0,
+    AppletOperationMode_Console  = 1,
+} AppletOperationMode;
+
+// Input detection
+
+Result insrInitialize(void);
+void insrExit(void);
+Result insrGetLastTick(u32 id, u64 *tick);
+Result insrGetReadableEvent(u32 id, Event *out);
+
+// Process management
+
+typedef enum {
+    PmProcessEvent_None         = 0,
+    PmProcessEvent_Exit         = 1,
+    PmProcessEvent_Start        = 2,
+    PmProcessEvent_Exception    = 3,
+    PmProcessEvent_DebugRunning = 4,
+    PmProcessEvent_DebugBreak   = 5,
+} PmProcessEvent;
+
+typedef struct {
+    PmProcessEvent event;
+    u64 process_id;
+} PmProcessEventInfo;
+
+Result pmdmntInitialize(void);
+void pmdmntExit(void);
+Result pmdmntGetApplicationProcessId(u64 *pid_out);
+
+Result pminfoInitialize(void);
+void pminfoExit(void);
+Result pminfoGetProgramId(u64 *program_id_out, u64 pid);
+
+typedef struct {
+    Service s;
+} PglEventObserver;
+
+Result pglInitialize(void);
+void pglExit(void);
+Result pglGetEventObserver(PglEventObserver *out);
+Result pglEventObserverGetProcessEvent(PglEventObserver *observer, Event *out);
+Result pglEventObserverGetProcessEventInfo(PglEventObserver *observer, PmProcessEventInfo *out);
+void pglEventObserverClose(PglEventObserver *observer);
+
+// Backlight
+
+Result lblInitialize(void);
+void lblExit(void);
+Result lblIsAmbientLightSensorAvailable(bool *out);
+Result lblGetAmbientLightSensorValue(bool *over_limit, float *lux);
+
+// Arm
+
+u64 armGetSystemTick(void);
+u64 armGetSystemTickFreq(void);
+
+// Plain inline functions like in libnx, so that they cannot be used in constant expressions here either
+static inline u64 armNsToTicks(u64 ns) {
+    return (ns * 12) / 625;
+}
+
+static inline u64 armTicksToNs(u64 tick) {
+    return (tick * 625) / 12;
+}
+
+// Time
+
+typedef enum {
+    TimeType_UserSystemClock,
+    TimeType_NetworkSystemClock,
+    TimeType_LocalSystemClock,
+    TimeType_Default = TimeType_UserSystemClock,
+} TimeType;
+
+typedef struct {
+    u16 year;
+    u8  month;
+    u8  day;
+    u8  hour;
+    u8  minute;
+    u8  second;
+    u8  pad;
+} TimeCalendarTime;
+
+typedef struct {
+    u32 wday;
+    u32 yday;
+    struct {
+        char time_zone[8];
+    } timezoneName;
+    u32 DST;
+    s32 offset;
+} TimeCalendarAdditionalInfo;
+
+Result timeInitialize(void);
+void timeExit(void);
+Result timeGetCurrentTime(TimeType type, u64 *timestamp);
+Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime *caltime, TimeCalendarAdditionalInfo *info);
+
+// Filesystem, rooted at $FZ_SDMC_ROOT (or the working directory)
+
+#define FS_MAX_PATH 0x301
+
+typedef struct {
+    Service s;
+} FsFileSystem;
+
+typedef struct {
+    Service s;
+} FsFile;
+
+typedef enum {
+    FsOpenMode_Read   = BIT(0),
+    FsOpenMode_Write  = BIT(1),
+    FsOpenMode_Append = BIT(2),
+} FsOpenMode;
+
+typedef enum {
+    FsReadOption_None = 0,
+} FsReadOption;
+
+typedef enum {
+    FsWriteOption_None  = 0,
+    FsWriteOption_Flush = BIT(0),
+} FsWriteOption;
+
+Result fsInitialize(void);
+void fsExit(void);
+Result fsOpenSdCardFileSystem(FsFileSystem *out);
+void fsFsClose(FsFileSystem *fs);
+Result fsFsCreateFile(FsFileSystem *fs, const char *path, s64 size, u32 option);
+Result fsFsDeleteFile(FsFileSystem *fs, const char *path);
+Result fsFsOpenFile(FsFileSystem *fs, const char *path, u32 mode, FsFile *out);
+Result fsFileRead(FsFile *f, s64 off, void *buf, u64 read_size, u32 option, u64 *bytes_read);
+Result fsFileWrite(FsFile *f, s64 off, const void *buf, u64 write_size, u32 option);
+void fsFileClose(FsFile *f);
+
+// Nvidia driver
+
+#define __nv_in
+#define __nv_out
+#define __nv_inout
+
+#define _NV_IOC_NRBITS   8
+#define _NV_IOC_TYPEBITS 8
+#define _NV_IOC_SIZEBITS 14
+
+#define _NV_IOC_NRSHIFT   0
+#define _NV_IOC_TYPESHIFT (_NV_IOC_NRSHIFT   + _NV_IOC_NRBITS)
+#define _NV_IOC_SIZESHIFT (_NV_IOC_TYPESHIFT + _NV_IOC_TYPEBITS)
+#define _NV_IOC_DIRSHIFT  (_NV_IOC_SIZESHIFT + _NV_IOC_SIZEBITS)
+
+#define _NV_IOC_NONE  0U
+#define _NV_IOC_WRITE 1U
+#define _NV_IOC_READ  2U
+
+#define _NV_IOC(dir, type, nr, size) \
+    (((dir) << _NV_IOC_DIRSHIFT) | ((type) << _NV_IOC_TYPESHIFT) | ((nr) << _NV_IOC_NRSHIFT) | ((size) << _NV_IOC_SIZESHIFT))
+
+#define _NV_IOR(type, nr, size)  _NV_IOC(_NV_IOC_READ,                  (type), (nr), sizeof(size))
+#define _NV_IOW(type, nr, size)  _NV_IOC(_NV_IOC_WRITE,                 (type), (nr), sizeof(size))
+#define _NV_IOWR(type, nr, size) _NV_IOC(_NV_IOC_READ | _NV_IOC_WRITE,  (type), (nr), sizeof(size))
+
+#define _NV_IOC_NR(nr)   (((nr) >> _NV_IOC_NRSHIFT)   & ((1 << _NV_IOC_NRBITS)   - 1))
+#define _NV_IOC_SIZE(nr) (((nr) >> _NV_IOC_SIZESHIFT) & ((1 << _NV_IOC_SIZEBITS) - 1))
+
+Result nvOpen(u32 *fd, const char *devicepath);
+Result nvIoctl(u32 fd, u32 request, void *argp);
+Result nvClose(u32 fd);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // _FZ_HOST_SWITCH_H
@@ -0,0 +1,3 @@
+// Forwards the libnx header included by common/src/service_guard.h to the host shim
+#pragma once
+#include <switch.h>
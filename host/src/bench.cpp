@@ -0,0 +1,436 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <numeric>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ini.h>
+#include <common.hpp>
+
+#include "nvdisp.hpp"
+#include "io.hpp"
+
+// Microbenchmarks of the color pipeline and config hot paths.
+// Build with OPT=Os (the sysmodule flags) or OPT=O2 and compare the JSON/CSV reports between commits
+
+#ifndef FZ_BENCH_OPT
+#   define FZ_BENCH_OPT unknown
+#endif
+
+namespace {
+
+template <typename T>
+inline void do_not_optimize(T &&val) {
+    asm volatile("" : : "g"(&val) : "memory");
+}
+
+// Prevents constant-folding of benchmark inputs
+template <typename T>
+inline T launder(T val) {
+    asm volatile("" : "+m"(val));
+    return val;
+}
+
+struct Measurement {
+    std::string name;
+    double min, median, mean;
+    std::size_t iterations;
+};
+
+class Bench {
+    public:
+        constexpr static auto MinSampleDuration = std::chrono::milliseconds(10);
+        constexpr static std::size_t NumSamples = 15;
+
+    public:
+        Bench(std::string_view filter): filter(filter) { }
+
+        template <typename F>
+        void run(std::string_view name, F &&f) {
+            if (!this->filter.empty() && name.find(this->filter) == std::string_view::npos)
+                return;
+
+            // Find an iteration count which takes long enough to be measured reliably
+            std::size_t iters = 1;
+            while (measure(f, iters) < MinSampleDuration)
+                iters *= 2;
+
+            std::array<double, NumSamples> samples;
+            for (auto &sample: samples)
+                sample = std::chrono::duration<double, std::nano>(measure(f, iters)).count() / iters;
+
+            std::sort(samples.begin(), samples.end());
+            this->results.push_back({
+                .name       = std::string(name),
+                .min        = samples.front(),
+                .median     = samples[samples.size() / 2],
+                .mean       = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size(),
+                .iterations = iters,
+            });
+        }
+
+        const std::vector<Measurement> &get_results() const {
+            return this->results;
+        }
+
+    private:
+        template <typename F>
+        static std::chrono::nanoseconds measure(F &f, std::size_t iters) {
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < iters; ++i)
+                f();
+            return std::chrono::steady_clock::now() - start;
+        }
+
+    private:
+        std::string_view filter;
+        std::vector<Measurement> results;
+};
+
+void write_table(FILE *fp, const std::vector<Measurement> &results) {
+    std::fprintf(fp, "%-32s %12s %12s %12s %12s\n", "benchmark", "min (ns)", "median (ns)", "mean (ns)", "iterations");
+    for (auto &r: results)
+        std::fprintf(fp, "%-32s %12.1f %12.1f %12.1f %12zu\n", r.name.c_str(), r.min, r.median, r.mean, r.iterations);
+}
+
+void write_csv(FILE *fp, const std::vector<Measurement> &results) {
+    std::fprintf(fp, "benchmark,min_ns,median_ns,mean_ns,iterations,opt,compiler\n");
+    for (auto &r: results)
+        std::fprintf(fp, "%s,%.2f,%.2f,%.2f,%zu,%s,\"%s\"\n", r.name.c_str(), r.min, r.median, r.mean, r.iterations,
+            FZ_STR(FZ_BENCH_OPT), __VERSION__);
+}
+
+void write_json(FILE *fp, const std::vector<Measurement> &results) {
+    std::fprintf(fp, "{\n  \"opt\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [\n", FZ_STR(FZ_BENCH_OPT), __VERSION__);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        std::fprintf(fp, "    { \"name\": \"%s\", \"min_ns\": %.2f, \"median_ns\": %.2f, \"mean_ns\": %.2f, \"iterations\": %zu }%s\n",
+            r.name.c_str(), r.min, r.median, r.mean, r.iterations, (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(fp, "  ]\n}\n");
+}
+
+// Replays application sessions (read on launch, write on exit) against a scratch config file,
+// editing a setting every edit_period sessions, and returns the number of file writes
+std::uint32_t count_config_writes(std::uint32_t num_sessions, std::uint32_t edit_period) {
+    std::uint32_t num_writes = 0;
+    for (std::uint32_t i = 0; i < num_sessions; ++i) {
+        fz::Config config;
+        config.read();
+
+        if (i % edit_period == 0) {
+            config.open_profile(FizeauProfileId_Profile1);
+            config.profile.night_settings.temperature += 100;
+            config.apply();
+        }
+
+        num_writes += config.write();
+    }
+    return num_writes;
+}
+
+void print_usage(const char *argv0) {
+    std::fprintf(stderr, "Usage: %s [-f table|csv|json] [-o out] [-k filter] config.ini...\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::string_view format = "table", filter;
+    const char *out_path = nullptr;
+
+    std::vector<const char *> config_paths;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-f") && i + 1 < argc)
+            format = argv[++i];
+        else if (!std::strcmp(argv[i], "-o") && i + 1 < argc)
+            out_path = argv[++i];
+        else if (!std::strcmp(argv[i], "-k") && i + 1 < argc)
+            filter = argv[++i];
+        else if (argv[i][0] == '-')
+            return print_usage(argv[0]), 1;
+        else
+            config_paths.push_back(argv[i]);
+    }
+
+    if (format != "table" && format != "csv" && format != "json")
+        return print_usage(argv[0]), 1;
+
+    FizeauProfile profile = {
+        .day_settings   = fz::Config::default_settings,
+        .night_settings = fz::Config::default_settings,
+        .components     = Component_All,
+        .filter         = Component_None,
+        .dusk_begin     = { 21, 0, 0 },
+        .dusk_end       = { 21, 30, 0 },
+        .dawn_begin     = { 7, 0, 0 },
+        .dawn_end       = { 7, 30, 0 },
+        .dimming_timeout = { 0, 5, 0 },
+    };
+    profile.night_settings.temperature = 3000;
+    profile.night_settings.saturation  = 1.2f;
+    profile.night_settings.hue         = 0.1f;
+    profile.night_settings.contrast    = 1.1f;
+    profile.night_settings.gamma       = 2.2f;
+    profile.night_settings.luminance   = -0.3f;
+    profile.night_settings.range       = { 0.1f, 0.9f };
+
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id)
+        fizeauSetProfile(static_cast<FizeauProfileId>(id), &profile);
+
+    // Representative inputs for the parser: the shipped config (comment-heavy), and one generated by Config::make
+    std::vector<std::pair<std::string, std::string>> configs;
+    for (auto *path: config_paths) {
+        auto str = fz::host::read_file(path);
+        if (str.empty()) {
+            std::fprintf(stderr, "Failed to read %s\n", path);
+            return 1;
+        }
+
+        auto name = std::string_view(path);
+        name = name.substr(name.find_last_of('/') + 1);
+        configs.emplace_back(name, std::move(str));
+    }
+    std::array<char, fz::Config::max_config_size> make_buf;
+    configs.emplace_back("generated", fz::Config().make(make_buf));
+
+    Bench bench(filter);
+
+    // color.cpp
+    bench.run("dot", [] {
+        do_not_optimize(fz::dot(launder(fz::ColorMatrix{ 1, 2, 3, 4, 5, 6, 7, 8, 9 }), launder(fz::ColorMatrix{ 9, 8, 7, 6, 5, 4, 3, 2, 1 })));
+    });
+
+    bench.run("filter_matrix", [] {
+        do_not_optimize(fz::filter_matrix(launder(Component_Red)));
+    });
+
+    bench.run("whitepoint/3000", [] {
+        do_not_optimize(fz::whitepoint(launder<Temperature>(3000)));
+    });
+
+    bench.run("whitepoint/6500", [] {
+        do_not_optimize(fz::whitepoint(launder<Temperature>(6500)));
+    });
+
+    bench.run("hue_matrix", [] {
+        do_not_optimize(fz::hue_matrix(launder(0.1f)));
+    });
+
+    bench.run("saturation_matrix", [] {
+        do_not_optimize(fz::saturation_matrix(launder(1.2f)));
+    });
+
+    bench.run("contrast_slant", [] {
+        do_not_optimize(fz::contrast_slant(launder(1.1f)));
+    });
+
+    bench.run("degamma", [] {
+        do_not_optimize(fz::degamma(launder(0.5f), launder(2.4f)));
+    });
+
+    bench.run("regamma", [] {
+        do_not_optimize(fz::regamma(launder(0.5f), launder(2.4f)));
+    });
+
+    bench.run("degamma_ramp/lut1", [] {
+        std::array<std::uint16_t, 256> lut;
+        fz::degamma_ramp(lut.data(), lut.size(), launder(DEFAULT_GAMMA), 12);
+        do_not_optimize(lut);
+    });
+
+    bench.run("regamma_ramp/lut2", [] {
+        std::array<std::uint16_t, 960> lut;
+        fz::regamma_ramp(lut.data(), 512, launder(2.2f), 8, 0.0f, 0.125f, 0.0f);
+        fz::regamma_ramp(lut.data() + 512, lut.size() - 512, launder(2.2f), 8, 0.125f, 1.0f, 0.0f);
+        do_not_optimize(lut);
+    });
+
+    std::array<std::uint16_t, 960> ramp;
+    fz::regamma_ramp(ramp.data(), ramp.size(), DEFAULT_GAMMA, 8);
+
+    bench.run("apply_luma/lut2", [&ramp] {
+        auto lut = ramp;
+        fz::apply_luma(lut.data(), lut.size(), 8, launder(-0.3f));
+        do_not_optimize(lut);
+    });
+
+    bench.run("apply_range/lut2", [&ramp] {
+        auto lut = ramp;
+        fz::apply_range(lut.data(), lut.size(), 8, launder(0.1f), launder(0.9f));
+        do_not_optimize(lut);
+    });
+
+    // schedule.cpp, nvdisp.cpp
+    bench.run("interpolate_profile", [&profile] {
+        do_not_optimize(fz::interpolate_profile(profile, launder(0.5f), true));
+    });
+
+    // Sample times across the day, so that every segment is visited
+    std::uint32_t sample = 0;
+    auto next_ts = [&sample] { return (sample += 7919) % (24 * 60 * 60); };
+
+    bench.run("evaluate_profile", [&profile, &next_ts] {
+        bool is_night;
+        do_not_optimize(fz::evaluate_profile(profile, launder(next_ts()), is_night));
+    });
+
+    // Full schedule of transitions with every easing
+    fz::KeyframeArray keyframes;
+    for (std::size_t i = 0; i < keyframes.size(); ++i) {
+        keyframes[i] = {
+            .time     = from_timestamp(i * 3 * 60 * 60),
+            .easing   = static_cast<Easing>(i % Easing_Total),
+            .settings = (i % 2) ? profile.night_settings : profile.day_settings,
+        };
+    }
+    auto keyframe_profile = profile;
+    keyframe_profile.num_keyframes = keyframes.size();
+
+    bench.run("Timeline::compile/day-night", [&profile] {
+        fz::Timeline timeline;
+        timeline.compile(launder(profile), {});
+        do_not_optimize(timeline);
+    });
+
+    bench.run("Timeline::compile/keyframes", [&keyframe_profile, &keyframes] {
+        fz::Timeline timeline;
+        timeline.compile(launder(keyframe_profile), keyframes);
+        do_not_optimize(timeline);
+    });
+
+    fz::Timeline day_night, keyframed;
+    day_night.compile(profile, {});
+    keyframed.compile(keyframe_profile, keyframes);
+
+    bench.run("Timeline::evaluate/day-night", [&day_night, &next_ts] {
+        do_not_optimize(day_night.evaluate(launder(next_ts())));
+    });
+
+    bench.run("Timeline::evaluate/keyframes", [&keyframed, &next_ts] {
+        do_not_optimize(keyframed.evaluate(launder(next_ts())));
+    });
+
+    bench.run("calculate_cmu/day", [&profile] {
+        do_not_optimize(fz::calculate_cmu(profile.day_settings, profile.components, profile.filter));
+    });
+
+    bench.run("calculate_cmu/night", [&profile] {
+        do_not_optimize(fz::calculate_cmu(profile.night_settings, profile.components, profile.filter));
+    });
+
+    // CPU preview of the application, over a 500x500 RGBA image
+    std::vector<std::uint8_t> pixels(500 * 500 * 4);
+    for (std::size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = static_cast<std::uint8_t>(i * 31);
+    auto night_cmu = fz::calculate_cmu(profile.night_settings, profile.components, profile.filter);
+
+    bench.run("cmu::Model/build", [&night_cmu] {
+        do_not_optimize(fz::cmu::Model(launder(night_cmu)));
+    });
+
+    bench.run("cmu::Model/apply/500x500", [&pixels, model = fz::cmu::Model(night_cmu)] {
+        auto out = pixels;
+        model.apply(pixels.data(), out.data(), pixels.size() / 4, 4);
+        do_not_optimize(out);
+    });
+
+    // QS18 conversions, as done when filling the CSC and its shadow
+    bench.run("QS18/from_float", [] {
+        auto coeffs = launder(fz::ColorMatrix{ 0.9f, 0.1f, -0.05f, 0.02f, 0.8f, 0.03f, -0.1f, 0.0f, 0.6f });
+        std::array<fz::QS18, 9> csc;
+        std::copy(coeffs.begin(), coeffs.end(), csc.begin());
+        do_not_optimize(csc);
+    });
+
+    bench.run("QS18/to_float", [] {
+        auto csc = launder(std::array<fz::QS18, 9>{ 0.9f, 0.1f, -0.05f, 0.02f, 0.8f, 0.03f, -0.1f, 0.0f, 0.6f });
+        std::array<float, 9> coeffs;
+        std::transform(csc.begin(), csc.end(), coeffs.begin(), [](fz::QS18 c) { return static_cast<float>(c); });
+        do_not_optimize(coeffs);
+    });
+
+    bench.run("QS18/to_register", [] {
+        auto csc = launder(std::array<fz::QS18, 9>{ 0.9f, 0.1f, -0.05f, 0.02f, 0.8f, 0.03f, -0.1f, 0.0f, 0.6f });
+        fz::DisplayController::Csc shadow;
+        std::transform(csc.begin(), csc.end(), shadow.begin(),
+            [](fz::QS18 c) -> std::uint16_t { return static_cast<fz::DisplayController::Csc::value_type>(c) & fz::QS18::BitMask; });
+        do_not_optimize(shadow);
+    });
+
+    // config_parse.cpp, config.cpp
+    for (auto &[name, str]: configs) {
+        bench.run("Config::ini_handler/" + name, [&str] {
+            fz::Config config;
+            ini_parse_string(str.c_str(), fz::Config::ini_handler, &config);
+            do_not_optimize(config);
+        });
+    }
+
+    bench.run("Config::make", [&make_buf] {
+        fz::Config config;
+        do_not_optimize(config.make(make_buf));
+    });
+
+    // Config::write, against a scratch file
+    auto *tmp_dir = std::getenv("TMPDIR");
+    auto config_path = std::string(tmp_dir ? tmp_dir : "/tmp") + "/fizeau-bench-config.ini";
+    fz::Config::config_locations = { config_path, config_path };
+
+    if (auto *fp = std::fopen(config_path.c_str(), "w"); fp) {
+        std::fwrite(configs.front().second.data(), configs.front().second.size(), 1, fp);
+        std::fclose(fp);
+    }
+
+    bench.run("Config::write/unchanged", [] {
+        fz::Config config;
+        config.read();
+        config.write();
+        do_not_optimize(config);
+    });
+
+    if (filter.empty() || std::string_view("Config::write").find(filter) != std::string_view::npos) {
+        constexpr std::uint32_t num_sessions = 100, edit_period = 10;
+        auto num_writes = count_config_writes(num_sessions, edit_period);
+        std::fprintf(stderr, "Config::write: %u file writes over %u sessions, %u with edits\n",
+            num_writes, num_sessions, num_sessions / edit_period);
+    }
+    std::remove(config_path.c_str());
+
+    auto *fp = out_path ? std::fopen(out_path, "w") : stdout;
+    if (!fp) {
+        std::fprintf(stderr, "Failed to open %s\n", out_path);
+        return 1;
+    }
+    FZ_SCOPEGUARD([&fp] { if (fp != stdout) std::fclose(fp); });
+
+    if (format == "json")
+        write_json(fp, bench.get_results());
+    else if (format == "csv")
+        write_csv(fp, bench.get_results());
+    else
+        write_table(fp, bench.get_results());
+
+    return 0;
+}
@@ -0,0 +1,291 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <common.hpp>
+
+#include "nvdisp.hpp"
+#include "io.hpp"
+
+// Evaluates the profiles of a config file into the CMU values the sysmodule would commit,
+// and renders images through a model of the hardware pipeline
+
+namespace {
+
+struct Image {
+    std::size_t width = 0, height = 0;
+    std::vector<std::uint8_t> data; // Packed RGB8
+};
+
+struct Evaluation {
+    Timestamp ts;
+    bool is_night;
+    FizeauSettings settings;
+    fz::Cmu cmu;
+};
+
+bool read_ppm(const char *path, Image &img) {
+    auto *fp = std::fopen(path, "rb");
+    if (!fp)
+        return false;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    // Header fields, separated by whitespace and possibly comments
+    auto read_field = [fp](char *buf, std::size_t size) {
+        int c;
+        std::size_t len = 0;
+        while ((c = std::fgetc(fp)) != EOF) {
+            if (c == '#') {
+                while ((c = std::fgetc(fp)) != EOF && c != '\n');
+            } else if (std::isspace(c)) {
+                if (len)
+                    break;
+            } else if (len < size - 1) {
+                buf[len++] = c;
+            }
+        }
+        buf[len] = '\0';
+        return len != 0;
+    };
+
+    char magic[4], width[16], height[16], maxval[16];
+    if (!read_field(magic, sizeof(magic)) || std::strcmp(magic, "P6") || !read_field(width, sizeof(width)) ||
+            !read_field(height, sizeof(height)) || !read_field(maxval, sizeof(maxval)) || std::strcmp(maxval, "255"))
+        return false;
+
+    img.width  = std::strtoul(width,  nullptr, 10);
+    img.height = std::strtoul(height, nullptr, 10);
+    img.data.resize(img.width * img.height * 3);
+    return std::fread(img.data.data(), 1, img.data.size(), fp) == img.data.size();
+}
+
+bool write_ppm(const char *path, const Image &img) {
+    auto *fp = std::fopen(path, "wb");
+    if (!fp)
+        return false;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    std::fprintf(fp, "P6\n%zu %zu\n255\n", img.width, img.height);
+    return std::fwrite(img.data.data(), 1, img.data.size(), fp) == img.data.size();
+}
+
+// Hue/value sweep at full saturation, above a gray ramp
+Image make_test_image() {
+    Image img = { .width = 768, .height = 256 };
+    img.data.resize(img.width * img.height * 3);
+
+    for (std::size_t y = 0; y < img.height; ++y) {
+        for (std::size_t x = 0; x < img.width; ++x) {
+            auto *px = &img.data[(y * img.width + x) * 3];
+
+            if (y >= 192) {
+                px[0] = px[1] = px[2] = x * 256 / img.width;
+                continue;
+            }
+
+            float h = 6.0f * x / img.width, v = 1.0f - static_cast<float>(y) / 192;
+            float f = h - std::floor(h), p = 0.0f, q = v * (1.0f - f), t = v * f;
+            float r, g, b;
+            switch (static_cast<int>(h)) {
+                case 0:  r = v, g = t, b = p; break;
+                case 1:  r = q, g = v, b = p; break;
+                case 2:  r = p, g = v, b = t; break;
+                case 3:  r = p, g = q, b = v; break;
+                case 4:  r = t, g = p, b = v; break;
+                default: r = v, g = p, b = q; break;
+            }
+
+            px[0] = std::lround(r * 255.0f), px[1] = std::lround(g * 255.0f), px[2] = std::lround(b * 255.0f);
+        }
+    }
+
+    return img;
+}
+
+bool parse_clock_time(const char *str, Timestamp &out) {
+    unsigned int h = 0, m = 0, s = 0;
+    if (std::sscanf(str, "%u:%u:%u", &h, &m, &s) < 2 || h >= 24 || m >= 60 || s >= 60)
+        return false;
+
+    out = 60 * 60 * h + 60 * m + s;
+    return true;
+}
+
+void write_json(FILE *fp, const std::vector<Evaluation> &evals) {
+    auto write_array = [fp](const char *name, auto begin, auto end, const char *suffix) {
+        std::fprintf(fp, "\"%s\": [", name);
+        for (auto it = begin; it != end; ++it)
+            std::fprintf(fp, "%s%u", (it != begin) ? "," : "", static_cast<unsigned int>(*it));
+        std::fprintf(fp, "]%s", suffix);
+    };
+
+    std::fprintf(fp, "[\n");
+    for (std::size_t i = 0; i < evals.size(); ++i) {
+        auto &e = evals[i];
+        auto t  = from_timestamp(e.ts);
+        auto *csc = reinterpret_cast<const std::uint16_t *>(&e.cmu.krr);
+
+        std::fprintf(fp, "  { \"time\": \"%02u:%02u:%02u\", \"night\": %s, ", t.h, t.m, t.s, e.is_night ? "true" : "false");
+        std::fprintf(fp, "\"settings\": { \"temperature\": %u, \"saturation\": %g, \"hue\": %g, \"contrast\": %g, "
+            "\"gamma\": %g, \"luminance\": %g, \"range\": [%g, %g] }, ",
+            e.settings.temperature, e.settings.saturation, e.settings.hue, e.settings.contrast,
+            e.settings.gamma, e.settings.luminance, e.settings.range.lo, e.settings.range.hi);
+        std::fprintf(fp, "\"enable\": %u, ", e.cmu.enable);
+        write_array("csc",  csc, csc + 9, ", ");
+        write_array("lut1", e.cmu.lut_1.begin(), e.cmu.lut_1.end(), ", ");
+        write_array("lut2", e.cmu.lut_2.begin(), e.cmu.lut_2.end(), "");
+        std::fprintf(fp, " }%s\n", (i + 1 < evals.size()) ? "," : "");
+    }
+    std::fprintf(fp, "]\n");
+}
+
+void print_usage(const char *argv0) {
+    std::fprintf(stderr,
+        "Usage: %s [options] config.ini\n"
+        "  -p <1-4>         profile to evaluate (default: the handheld profile of the config)\n"
+        "  -t <hh:mm[:ss]>  time of day (default: 12:00)\n"
+        "  -s <seconds>     evaluate the whole day in steps of <seconds>, instead of a single time\n"
+        "  -f <bin|json>    dump format, bin is the raw nvdisp Cmu struct, concatenated in batch mode (default: json)\n"
+        "  -o <path>        dump to a file instead of stdout\n"
+        "  -r <out.ppm>     render an image through the CMU model (single time only)\n"
+        "  -i <in.ppm>      image to render, instead of the built-in test pattern\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *config_path = nullptr, *out_path = nullptr, *render_path = nullptr, *image_path = nullptr;
+    std::string_view format = "json";
+    FizeauProfileId profile_id = FizeauProfileId_Invalid;
+    Timestamp ts = 12 * 60 * 60, step = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        auto has_arg = i + 1 < argc;
+        if (!std::strcmp(argv[i], "-p") && has_arg)
+            profile_id = static_cast<FizeauProfileId>(std::strtoul(argv[++i], nullptr, 10) - 1);
+        else if (!std::strcmp(argv[i], "-t") && has_arg && parse_clock_time(argv[i + 1], ts))
+            ++i;
+        else if (!std::strcmp(argv[i], "-s") && has_arg)
+            step = std::strtoul(argv[++i], nullptr, 10);
+        else if (!std::strcmp(argv[i], "-f") && has_arg)
+            format = argv[++i];
+        else if (!std::strcmp(argv[i], "-o") && has_arg)
+            out_path = argv[++i];
+        else if (!std::strcmp(argv[i], "-r") && has_arg)
+            render_path = argv[++i];
+        else if (!std::strcmp(argv[i], "-i") && has_arg)
+            image_path = argv[++i];
+        else if (argv[i][0] == '-' || config_path)
+            return print_usage(argv[0]), 1;
+        else
+            config_path = argv[i];
+    }
+
+    if (!config_path || (format != "json" && format != "bin") || (step && render_path))
+        return print_usage(argv[0]), 1;
+
+    fz::Config config;
+    fz::host::ProfileArray  profiles  = {};
+    fz::host::ScheduleArray schedules = {};
+    if (!fz::host::load_config(config_path, config, profiles, &schedules)) {
+        std::fprintf(stderr, "Failed to load %s\n", config_path);
+        return 1;
+    }
+
+    if (profile_id == FizeauProfileId_Invalid)
+        profile_id = config.internal_profile;
+    if (profile_id >= FizeauProfileId_Total) {
+        std::fprintf(stderr, "Invalid profile\n");
+        return 1;
+    }
+
+    auto &profile = profiles[profile_id];
+
+    fz::Timeline timeline;
+    timeline.compile(profile, schedules[profile_id]);
+
+    std::vector<Evaluation> evals;
+    evals.reserve(step ? (24 * 60 * 60 + step - 1) / step : 1);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto t = step ? 0 : ts; t < (step ? 24 * 60 * 60 : ts + 1); t += step ? step : 1) {
+        auto &e = evals.emplace_back(Evaluation{ .ts = t });
+        auto segment = timeline.find(t);
+        e.settings = timeline.evaluate(t, segment);
+        e.is_night = timeline.is_night(segment);
+        e.cmu      = fz::calculate_cmu(e.settings, profile.components, profile.filter);
+
+        // The sysmodule bypasses the CMU instead of committing an identity
+        if (fz::cmu::is_identity(e.cmu))
+            e.cmu.reset(false);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    auto elapsed = std::chrono::duration<double>(end - start).count();
+    std::fprintf(stderr, "Evaluated %zu times in %.2fms (%.0f/s)\n", evals.size(), elapsed * 1e3, evals.size() / elapsed);
+
+    if (out_path || !render_path) {
+        auto *fp = out_path ? std::fopen(out_path, "wb") : stdout;
+        if (!fp) {
+            std::fprintf(stderr, "Failed to open %s\n", out_path);
+            return 1;
+        }
+        FZ_SCOPEGUARD([&fp] { if (fp != stdout) std::fclose(fp); });
+
+        if (format == "json") {
+            write_json(fp, evals);
+        } else {
+            for (auto &e: evals)
+                std::fwrite(&e.cmu, sizeof(e.cmu), 1, fp);
+        }
+    }
+
+    if (render_path) {
+        Image img;
+        if (image_path) {
+            if (!read_ppm(image_path, img)) {
+                std::fprintf(stderr, "Failed to read %s (only binary 8-bit PPM is supported)\n", image_path);
+                return 1;
+            }
+        } else {
+            img = make_test_image();
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        fz::cmu::Model(evals.front().cmu).apply(img.data.data(), img.data.data(), img.width * img.height, 3);
+        auto end   = std::chrono::steady_clock::now();
+
+        std::fprintf(stderr, "Rendered %zux%zu in %.2fms\n", img.width, img.height,
+            std::chrono::duration<double, std::milli>(end - start).count());
+
+        if (!write_ppm(render_path, img)) {
+            std::fprintf(stderr, "Failed to write %s\n", render_path);
+            return 1;
+        }
+    }
+
+    return 0;
+}
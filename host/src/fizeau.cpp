@@ -0,0 +1,218 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <array>
+
+#include <common.hpp>
+
+// In-process replacement for the fizeau service client (common/src/fizeau.c),
+// holding the state the sysmodule would otherwise keep
+
+namespace {
+
+struct {
+    bool is_active = true;
+    FizeauProfileId internal_profile = FizeauProfileId_Profile1, external_profile = FizeauProfileId_Profile2;
+    std::array<FizeauProfile, FizeauProfileId_Total> profiles = {};
+    std::array<std::uint32_t, FizeauProfileId_Total> profile_versions = {};
+    std::array<fz::KeyframeArray, FizeauProfileId_Total> keyframes = {};
+    std::array<fz::AppRule, FIZEAU_MAX_APP_RULES> app_rules = {};
+    std::size_t num_app_rules = 0;
+} state;
+
+Service srv = {};
+
+bool is_valid(FizeauProfileId id) {
+    return id >= FizeauProfileId_Profile1 && id < FizeauProfileId_Total;
+}
+
+} // namespace
+
+extern "C" {
+
+Result fizeauIsServiceActive(bool *out) {
+    if (out)
+        *out = true;
+    return 0;
+}
+
+Result fizeauInitialize() {
+    return 0;
+}
+
+void fizeauExit() { }
+
+Service *fizeauGetServiceSession() {
+    return &srv;
+}
+
+Result fizeauGetIsActive(bool *is_active) {
+    if (is_active)
+        *is_active = state.is_active;
+    return 0;
+}
+
+Result fizeauSetIsActive(bool is_active) {
+    state.is_active = is_active;
+    return 0;
+}
+
+Result fizeauGetProfile(FizeauProfileId id, FizeauProfile *profile) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    if (profile)
+        *profile = state.profiles[id];
+    return 0;
+}
+
+Result fizeauSetProfile(FizeauProfileId id, FizeauProfile *profile) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    state.profiles[id] = *profile;
+    ++state.profile_versions[id];
+    return 0;
+}
+
+Result fizeauGetActiveProfileId(bool is_external, FizeauProfileId *id) {
+    if (id)
+        *id = !is_external ? state.internal_profile : state.external_profile;
+    return 0;
+}
+
+Result fizeauSetActiveProfileId(bool is_external, FizeauProfileId id) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    (!is_external ? state.internal_profile : state.external_profile) = id;
+    return 0;
+}
+
+Result fizeauDumpTrace(void) {
+    return MAKERESULT(10, 221);
+}
+
+Result fizeauGetState(bool is_external, FizeauState *out) {
+    if (out) {
+        *out = {
+            .is_active        = state.is_active,
+            .internal_profile = state.internal_profile,
+            .external_profile = state.external_profile,
+            .profile          = state.profiles[!is_external ? state.internal_profile : state.external_profile],
+            .profile_version  = state.profile_versions[!is_external ? state.internal_profile : state.external_profile],
+        };
+    }
+    return 0;
+}
+
+Result fizeauStageProfile(FizeauProfileId id, FizeauProfile *profile) {
+    return fizeauSetProfile(id, profile);
+}
+
+Result fizeauSetState(bool is_active, FizeauProfileId internal_profile, FizeauProfileId external_profile) {
+    if (!is_valid(internal_profile) || !is_valid(external_profile))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    state.is_active        = is_active;
+    state.internal_profile = internal_profile;
+    state.external_profile = external_profile;
+    return 0;
+}
+
+Result fizeauGetVersionedProfile(FizeauProfileId id, FizeauProfile *profile, uint32_t *version) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    if (profile)
+        *profile = state.profiles[id];
+    if (version)
+        *version = state.profile_versions[id];
+    return 0;
+}
+
+Result fizeauSetProfileIfVersion(FizeauProfileId id, FizeauProfile *profile, uint32_t *version) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    if (*version != state.profile_versions[id]) {
+        *version = state.profile_versions[id];
+        return FIZEAU_MAKERESULT(VERSION_MISMATCH);
+    }
+
+    state.profiles[id] = *profile;
+    *version = ++state.profile_versions[id];
+    return 0;
+}
+
+Result fizeauGetKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+    if (index >= FIZEAU_MAX_KEYFRAMES)
+        return FIZEAU_MAKERESULT(INVALID_KEYFRAME);
+
+    if (keyframe)
+        *keyframe = state.keyframes[id][index];
+    return 0;
+}
+
+Result fizeauStageKeyframe(FizeauProfileId id, uint32_t index, FizeauKeyframe *keyframe) {
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+    if (index >= FIZEAU_MAX_KEYFRAMES)
+        return FIZEAU_MAKERESULT(INVALID_KEYFRAME);
+
+    state.keyframes[id][index] = *keyframe;
+    return 0;
+}
+
+Result fizeauGetAppProfile(uint64_t program_id, FizeauProfileId *id) {
+    auto end = state.app_rules.begin() + state.num_app_rules;
+    auto it = std::find_if(state.app_rules.begin(), end, [program_id](auto &r) { return r.program_id == program_id; });
+    *id = (it != end) ? it->profile : FizeauProfileId_Invalid;
+    return 0;
+}
+
+Result fizeauSetAppProfile(uint64_t program_id, FizeauProfileId id) {
+    auto end = state.app_rules.begin() + state.num_app_rules;
+    auto it = std::find_if(state.app_rules.begin(), end, [program_id](auto &r) { return r.program_id == program_id; });
+
+    if (id == FizeauProfileId_Invalid) {
+        if (it != end)
+            *it = state.app_rules[--state.num_app_rules];
+        return 0;
+    }
+
+    if (!is_valid(id))
+        return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+    if (it != end)
+        it->profile = id;
+    else if (state.num_app_rules < state.app_rules.size())
+        state.app_rules[state.num_app_rules++] = { program_id, id };
+    else
+        return FIZEAU_MAKERESULT(TOO_MANY_APPS);
+    return 0;
+}
+
+Result fizeauClearAppProfiles(void) {
+    state.num_app_rules = 0;
+    return 0;
+}
+
+} // extern "C"
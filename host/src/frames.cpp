@@ -0,0 +1,174 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include <cmu.hpp>
+#include <color.hpp>
+
+#include "scheduler.hpp"
+
+// Drives the application frame scheduler through a synthetic session, polled at 60Hz like on the console,
+// and checks that every input and state change is followed by the frames needed to display it.
+// Also times, on the host, the settings-dependent work of the drawn frames (gamma graph ramps, preview CMU and
+// its CPU fallback pass), redone every frame or only when the config generation changes
+
+namespace {
+
+constexpr std::uint32_t PollRate = 60;
+
+struct Phase {
+    std::string_view name;
+    std::uint32_t seconds;
+    bool (*input)(std::uint32_t poll);    // Input pattern, by poll index in the phase
+    std::uint32_t settings_period = 0;    // Polls between settings changes made without input, 0 for none
+    bool edits = false;                   // Whether the input edits the settings
+};
+
+constexpr Phase session[] = {
+    { "startup idle",  10, [](std::uint32_t)   { return false; } },
+    { "reading help",  30, [](std::uint32_t)   { return false; } },
+    { "slider drag",    5, [](std::uint32_t)   { return true;  }, 0, true },
+    { "idle",          10, [](std::uint32_t)   { return false; } },
+    { "button taps",   20, [](std::uint32_t p) { return p % (2 * PollRate) < 6; } }, // 100ms press every 2s
+    { "idle",          30, [](std::uint32_t)   { return false; } },
+    { "reloads",       10, [](std::uint32_t)   { return false; }, 3 * PollRate + 7 }, // Config generation bumps off the clock
+};
+
+constexpr FizeauSettings night_settings = {
+    .temperature = 2500,
+    .saturation  = 1.0f,
+    .hue         = 0.0f,
+    .contrast    = 1.1f,
+    .gamma       = 2.4f,
+    .luminance   = -0.1f,
+    .range       = { 0.0627f, 0.92f },
+};
+
+// Preview image, same size as the one of the application
+constexpr std::size_t PreviewPixels = 500 * 500;
+
+enum class Rebuild {
+    None,           // Scheduling only
+    EveryFrame,     // Settings work redone by every drawn frame
+    OnGeneration,   // Settings work redone when the config generation changes
+};
+
+// Work of a drawn frame that only depends on the settings: the ramps of draw_graph_window, the CMU of the preview and,
+// when the GPU is unavailable, its pass through the CPU model
+void settings_work(const FizeauSettings &set, bool cpu_preview, std::vector<std::uint8_t> &pixels) {
+    std::array<std::uint16_t, 256> lut1;
+    std::array<std::uint16_t, 960> lut2;
+
+    float off = (1.0f - fz::contrast_slant(set.contrast)) / 2.0f;
+    fz::degamma_ramp(lut1.data(), lut1.size(), DEFAULT_GAMMA, 8);
+    fz::regamma_ramp(lut2.data(), lut2.size(), set.gamma, 8, 0.0f, 1.0f, off);
+    fz::apply_luma(lut2.data(), lut2.size(), 8, set.luminance);
+    fz::apply_range(lut2.data(), lut2.size(), 8, set.range.lo, std::min(set.range.hi, lut2.back() / 255.0f));
+
+    auto cmu = fz::calculate_cmu(set, Component_All, Component_None);
+    if (cpu_preview)
+        fz::cmu::Model(cmu).apply(pixels.data(), pixels.data(), PreviewPixels, 4);
+
+    asm volatile("" :: "r"(lut1.data()), "r"(lut2.data()), "r"(&cmu) : "memory");
+}
+
+struct Stats {
+    std::uint32_t polls = 0, frames = 0, violations = 0, rebuilds = 0;
+    double work_us = 0;
+};
+
+Stats run(bool on_demand, bool verbose, Rebuild rebuild = Rebuild::None, bool cpu_preview = false) {
+    fz::FrameScheduler scheduler;
+    scheduler.on_demand = on_demand;
+
+    Stats total;
+    std::uint32_t since_input = UINT32_MAX, global_poll = 0;
+    std::uint32_t generation = 0, built_generation = -1;
+    std::vector<std::uint8_t> pixels(PreviewPixels * 4, 0x80);
+
+    if (verbose)
+        std::printf("%-14s %8s %8s %8s\n", "phase", "polls", "frames", "ratio");
+
+    for (auto &phase: session) {
+        Stats stats;
+        for (std::uint32_t i = 0; i < phase.seconds * PollRate; ++i, ++global_poll) {
+            bool input   = phase.input(i);
+            bool edited  = (phase.edits && input) ||
+                (phase.settings_period && i % phase.settings_period == phase.settings_period - 1);
+            bool changed = global_poll % PollRate == 0 || edited; // Clock text changes once per second
+            bool drawn   = scheduler.update({ .input = input, .changed = changed });
+
+            generation += edited;
+            if (drawn && (rebuild == Rebuild::EveryFrame || (rebuild == Rebuild::OnGeneration && generation != built_generation))) {
+                auto start = std::chrono::steady_clock::now();
+                settings_work(night_settings, cpu_preview, pixels);
+                total.work_us += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                built_generation = generation, ++total.rebuilds;
+            }
+
+            since_input = input ? 0 : since_input + (since_input != UINT32_MAX);
+
+            // Input, the frames that follow its release, and clock and settings changes must all be drawn
+            if (!drawn && (input || changed || since_input < fz::FrameScheduler::SettleFrames)) {
+                if (!total.violations++)
+                    std::fprintf(stderr, "%s: poll %u not drawn\n", phase.name.data(), i);
+            }
+
+            ++stats.polls, stats.frames += drawn;
+        }
+
+        if (verbose)
+            std::printf("%-14s %8u %8u %7.1f%%\n", phase.name.data(), stats.polls, stats.frames, 100.0 * stats.frames / stats.polls);
+
+        total.polls += stats.polls, total.frames += stats.frames;
+    }
+
+    return total;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && !std::strcmp(argv[1], "-v");
+
+    auto always    = run(false, false);
+    auto on_demand = run(true,  verbose);
+
+    std::printf("always-on: %u frames, on-demand: %u frames (%.1f%%), %u violations\n",
+        always.frames, on_demand.frames, 100.0 * on_demand.frames / always.frames, on_demand.violations);
+
+    // Host timings, for the relative cost of caching by generation; console figures need a profile on the device
+    std::printf("%-14s %10s %10s %12s %12s\n", "preview", "rebuild", "rebuilds", "work (ms)", "us/frame");
+    for (bool cpu_preview: { false, true }) {
+        for (auto rebuild: { Rebuild::EveryFrame, Rebuild::OnGeneration }) {
+            auto stats = run(true, false, rebuild, cpu_preview);
+            std::printf("%-14s %10s %10u %12.1f %12.1f\n", cpu_preview ? "cpu" : "gpu",
+                rebuild == Rebuild::EveryFrame ? "always" : "generation", stats.rebuilds,
+                stats.work_us / 1000.0, stats.work_us / stats.frames);
+        }
+    }
+
+    return on_demand.violations ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <ini.h>
+
+#include "io.hpp"
+
+namespace fz::host {
+
+std::string read_file(const char *path) {
+    std::string str;
+
+    auto *fp = std::fopen(path, "rb");
+    if (!fp)
+        return str;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    char buf[0x1000];
+    while (auto read = std::fread(buf, 1, sizeof(buf), fp))
+        str.append(buf, read);
+    return str;
+}
+
+bool load_config(const char *path, Config &config, ProfileArray &profiles, ScheduleArray *schedules) {
+    struct LoadContext: Config {
+        ProfileArray &profiles;
+        ScheduleArray *schedules;
+    } ctx = { config, profiles, schedules };
+
+    ctx.parse_profile_switch_action = +[](Config *self, FizeauProfileId profile_id) {
+        if (self->cur_profile_id == FizeauProfileId_Invalid)
+            return;
+
+        auto *ctx = static_cast<LoadContext *>(self);
+        ctx->profiles[self->cur_profile_id] = self->profile;
+        if (ctx->schedules)
+            (*ctx->schedules)[self->cur_profile_id] = self->keyframes;
+        self->profile = {};
+    };
+
+    auto *fp = std::fopen(path, "r");
+    if (!fp)
+        return false;
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    // Invalid entries are skipped like the sysmodule does, with a warning
+    ini_handler handler = +[](void *user, const char *section, const char *name, const char *value) -> int {
+        if (!Config::ini_handler(user, section, name, value))
+            std::fprintf(stderr, "Skipping invalid config entry [%s] %s = %s\n", section, name, value);
+        return 1;
+    };
+
+    if (auto res = ini_parse_file(fp, handler, static_cast<Config *>(&ctx)); res < 0)
+        return false;
+    else if (res > 0)
+        std::fprintf(stderr, "Config syntax error on line %d\n", res);
+
+    // Flush the last section
+    ctx.parse_profile_switch_action(&ctx, FizeauProfileId_Invalid);
+
+    config = ctx;
+    config.parse_profile_switch_action = nullptr;
+    return true;
+}
+
+} // namespace fz::host
@@ -0,0 +1,673 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <common.hpp>
+
+#include "loopback.hpp"
+#include "server.hpp"
+#include "../sim/backends.hpp"
+
+// Exercises the sysmodule IPC server (ipc_server.c and Server::command_handler) over the loopback transport:
+//  - churn: clients connecting, sending requests and disconnecting at random, including past the session limit,
+//    checking that the server session table follows
+//  - fairness: every session resending as soon as it gets a reply, the wait of each request is bounded by the
+//    number of sessions
+//  - throughput: requests per second through the full server path
+//  - conflicts: sessions concurrently incrementing a field of the same profile, with compare-and-set writes
+//    (SetProfileIfVersion) not a single increment is lost, unlike with blind read-modify-writes (SetProfile)
+//  - commands: every command issued through the client library (common/src/fizeau.c), checking that the payloads
+//    make it across with their layout intact, then requests per second and round-trip latency of each
+//  - boot: the service registered before the rest of the sysmodule, answering queries from the default state and
+//    rejecting writes as busy, then the loaded state replacing it under new profile versions
+
+namespace {
+
+namespace lo = fz::host::loopback;
+
+struct Stats {
+    std::uint64_t requests = 0, connects = 0, rejected = 0, disconnects = 0, errors = 0;
+    std::uint32_t max_wait = 0; // In server steps
+    double seconds = 0;
+};
+
+class Harness {
+    public:
+        // When booting, only the service is started, like the sysmodule does before handing the rest to its boot worker
+        Harness(bool is_booting = false): display(regs), disp(), profile(context, disp), server(context, profile) {
+            fz::host::backends = {
+                .clock   = { .enabled = true, .tick = 0, .epoch = 0 },
+                .display = &this->display,
+                .mmio    = &this->regs,
+                .events  = &this->events,
+            };
+
+            lo::reset();
+            lo::set_server_step([](void *user) { static_cast<Harness *>(user)->step(); }, this);
+
+            this->context.is_booting = true;
+
+            Result rc;
+            if (rc = this->server.initialize(); R_FAILED(rc))
+                diagAbortWithResult(rc);
+
+            if (!is_booting)
+                this->finish_boot();
+        }
+
+        // Same steps as the boot worker, with an active state on the first profile standing for the loaded config
+        void finish_boot() {
+            Result rc;
+            if (rc = fz::Clock::initialize(); R_FAILED(rc))
+                diagAbortWithResult(rc);
+            if (rc = this->disp.initialize(false); R_FAILED(rc))
+                diagAbortWithResult(rc);
+            if (rc = this->profile.initialize(); R_FAILED(rc))
+                diagAbortWithResult(rc);
+
+            mutexLock(&this->context.mutex);
+            this->context.is_active        = true;
+            this->context.internal_profile = FizeauProfileId_Profile1;
+            this->context.external_profile = FizeauProfileId_Profile1;
+            for (auto &version: this->context.profile_versions)
+                ++version;
+
+            if (rc = this->profile.apply(); R_FAILED(rc))
+                diagAbortWithResult(rc);
+            mutexUnlock(&this->context.mutex);
+
+            this->context.is_booting = false;
+        }
+
+        ~Harness() {
+            this->server .finalize();
+            this->profile.finalize();
+            this->disp   .finalize();
+
+            lo::set_server_step(nullptr, nullptr);
+            fz::host::backends = {};
+        }
+
+        // Processes everything queued, returns the number of steps taken
+        std::uint32_t drain() {
+            std::uint32_t steps = 0;
+            while (lo::has_pending())
+                this->step(), ++steps;
+            return steps;
+        }
+
+        void step() {
+            switch (auto rc = this->server.process()) {
+                case 0:
+                case KERNELRESULT(ConnectionClosed):
+                    break;
+                default:
+                    if (R_MODULE(rc) != FIZEAU_RC_MODULE)
+                        diagAbortWithResult(rc);
+            }
+        }
+
+        // Live sessions, not counting the port
+        std::uint32_t num_sessions() const {
+            return this->server.count - 1;
+        }
+
+    private:
+        fz::sim::RegisterFile     regs;
+        fz::sim::RecordingDisplay display;
+        fz::sim::ScriptedEvents   events;
+
+        fz::Context context = {};
+        fz::DisplayController disp;
+        fz::ProfileManager profile;
+        fz::Server server;
+};
+
+bool check_reply(Result rc, bool is_active, Stats &stats) {
+    if (R_FAILED(rc) || !is_active) {
+        if (!stats.errors++)
+            std::fprintf(stderr, "bad reply: %#x, %d\n", rc, is_active);
+        return false;
+    }
+    return true;
+}
+
+Stats churn(std::uint32_t num_rounds) {
+    Harness h;
+    Stats stats;
+    std::mt19937 rng(0xf12);
+
+    struct Client {
+        lo::ClientId id;
+        bool waiting;
+    };
+    std::vector<Client> clients;
+
+    for (std::uint32_t round = 0; round < num_rounds; ++round) {
+        // Up to twice the session limit, to check that extra connections are turned away cleanly
+        auto action = rng() % 4;
+        if (action == 0 && clients.size() < 2 * fz::Server::ServiceNumSessions) {
+            lo::ClientId id;
+            switch (auto rc = lo::connect(fz::Server::ServiceName.data(), &id)) {
+                case 0:
+                    clients.push_back({ id, false });
+                    ++stats.connects;
+                    break;
+                case KERNELRESULT(OutOfSessions):
+                    ++stats.rejected;
+                    break;
+                default:
+                    diagAbortWithResult(rc);
+            }
+        } else if (action == 1 && !clients.empty()) {
+            auto it = clients.begin() + rng() % clients.size();
+            lo::close(it->id);
+            clients.erase(it);
+            ++stats.disconnects;
+        } else {
+            for (auto &c: clients) {
+                if (!c.waiting && lo::send(c.id, FizeauCommandId_GetIsActive, u8(0)) == 0)
+                    c.waiting = true;
+            }
+        }
+
+        h.drain();
+
+        for (auto it = clients.begin(); it != clients.end();) {
+            Result rc;
+            bool is_active = false;
+            if (it->waiting && lo::receive(it->id, &rc, &is_active, sizeof(is_active))) {
+                it->waiting = false;
+                stats.requests += check_reply(rc, is_active, stats);
+            }
+            ++it;
+        }
+
+        auto num_connected = std::count_if(clients.begin(), clients.end(), [](auto &c) { return lo::is_connected(c.id); });
+        if (h.num_sessions() != num_connected || h.num_sessions() > fz::Server::ServiceNumSessions) {
+            if (!stats.errors++)
+                std::fprintf(stderr, "round %u: %u server sessions for %zd clients\n", round, h.num_sessions(), num_connected);
+        }
+    }
+
+    return stats;
+}
+
+Stats fairness(std::uint32_t num_steps) {
+    Harness h;
+    Stats stats;
+
+    std::vector<lo::ClientId> clients(fz::Server::ServiceNumSessions);
+    std::vector<std::uint32_t> sent_at(clients.size());
+    for (auto &id: clients)
+        lo::connect(fz::Server::ServiceName.data(), &id);
+
+    for (std::uint32_t i = 0; i < clients.size(); ++i)
+        lo::send(clients[i], FizeauCommandId_GetIsActive, u8(0)), sent_at[i] = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t s = 0; s < num_steps; ++s) {
+        h.step();
+
+        for (std::uint32_t i = 0; i < clients.size(); ++i) {
+            Result rc;
+            bool is_active = false;
+            if (!lo::receive(clients[i], &rc, &is_active, sizeof(is_active)))
+                continue;
+
+            stats.requests += check_reply(rc, is_active, stats);
+            stats.max_wait = std::max(stats.max_wait, s - sent_at[i]);
+            lo::send(clients[i], FizeauCommandId_GetIsActive, u8(0)), sent_at[i] = s + 1;
+        }
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Requests still waiting count too, a starved session never gets its reply
+    for (auto t: sent_at)
+        stats.max_wait = std::max(stats.max_wait, num_steps - t);
+
+    // The connection steps are included in the first waits
+    if (stats.max_wait > 2 * clients.size()) {
+        if (!stats.errors++)
+            std::fprintf(stderr, "a request waited %u steps with %zu sessions\n", stats.max_wait, clients.size());
+    }
+
+    return stats;
+}
+
+struct ConflictStats {
+    std::uint64_t writes = 0, reads = 0, conflicts = 0, lost = 0;
+};
+
+// Each client increments the day temperature of the profile num_increments times. With compare-and-set, a client
+// keeps its copy of the profile between writes and only reads it again after a conflict.
+// This is the worst case, every session writes back as soon as it can
+ConflictStats conflicts(std::uint32_t num_increments, bool compare_and_set) {
+    Harness h;
+    ConflictStats stats;
+
+    constexpr auto id = FizeauProfileId_Profile4;
+
+    struct VersionedProfile {
+        std::uint32_t version;
+        FizeauProfile profile;
+    };
+
+    struct SetProfile {
+        FizeauProfileId id;
+        FizeauProfile profile;
+    };
+
+    struct SetProfileIfVersion {
+        FizeauProfileId id;
+        std::uint32_t version;
+        FizeauProfile profile;
+    };
+
+    struct SetProfileIfVersionOut {
+        bool written;
+        std::uint32_t version;
+    };
+
+    struct Client {
+        lo::ClientId id;
+        enum class State { Read, Reading, Write, Writing } state;
+        std::uint32_t remaining;
+        VersionedProfile cache;
+    };
+
+    std::vector<Client> clients(fz::Server::ServiceNumSessions);
+    for (auto &c: clients) {
+        lo::connect(fz::Server::ServiceName.data(), &c.id);
+        c.state = Client::State::Read, c.remaining = num_increments;
+    }
+
+    Result rc;
+    auto base = VersionedProfile{};
+    lo::send(clients[0].id, FizeauCommandId_GetVersionedProfile, id), h.drain();
+    lo::receive(clients[0].id, &rc, &base, sizeof(base));
+
+    while (std::any_of(clients.begin(), clients.end(), [](auto &c) { return c.remaining; })) {
+        for (auto &c: clients) {
+            if (!c.remaining)
+                continue;
+
+            if (c.state == Client::State::Read) {
+                lo::send(c.id, compare_and_set ? FizeauCommandId_GetVersionedProfile : FizeauCommandId_GetProfile, id);
+                c.state = Client::State::Reading, ++stats.reads;
+            } else if (c.state == Client::State::Write) {
+                ++c.cache.profile.day_settings.temperature;
+                if (compare_and_set)
+                    lo::send(c.id, FizeauCommandId_SetProfileIfVersion, SetProfileIfVersion{ id, c.cache.version, c.cache.profile });
+                else
+                    lo::send(c.id, FizeauCommandId_SetProfile, SetProfile{ id, c.cache.profile });
+                c.state = Client::State::Writing;
+            }
+        }
+
+        // One session served per step, the others keep their request pending and so race with it
+        h.step();
+
+        for (auto &c: clients) {
+            rc = 0;
+            if (c.state == Client::State::Reading) {
+                if (compare_and_set && lo::receive(c.id, &rc, &c.cache, sizeof(c.cache)))
+                    c.state = Client::State::Write;
+                else if (!compare_and_set && lo::receive(c.id, &rc, &c.cache.profile, sizeof(c.cache.profile)))
+                    c.state = Client::State::Write;
+            } else if (c.state == Client::State::Writing) {
+                SetProfileIfVersionOut out = { .written = true };
+                if (!lo::receive(c.id, &rc, &out, compare_and_set ? sizeof(out) : 0))
+                    continue;
+
+                if (out.written) {
+                    --c.remaining, ++stats.writes;
+                    c.cache.version = out.version;
+                    c.state = compare_and_set ? Client::State::Write : Client::State::Read;
+                } else {
+                    ++stats.conflicts;
+                    c.state = Client::State::Read;
+                }
+            }
+
+            if (R_FAILED(rc))
+                diagAbortWithResult(rc);
+        }
+    }
+
+    VersionedProfile result;
+    lo::send(clients[0].id, FizeauCommandId_GetVersionedProfile, id), h.drain();
+    lo::receive(clients[0].id, &rc, &result, sizeof(result));
+
+    stats.lost = base.profile.day_settings.temperature + stats.writes - result.profile.day_settings.temperature;
+    if (result.version != base.version + stats.writes)
+        ++stats.lost;
+    return stats;
+}
+
+struct CommandStats {
+    const char *name;
+    double rps;
+    std::uint64_t p50, p99; // Round-trip latency in ns
+    std::uint64_t errors;
+};
+
+// Field by field, the padding of Time is not preserved by struct copies
+bool same_settings(const FizeauSettings &a, const FizeauSettings &b) {
+    return a.temperature == b.temperature && a.saturation == b.saturation && a.hue == b.hue &&
+        a.contrast == b.contrast && a.gamma == b.gamma && a.luminance == b.luminance &&
+        a.range.lo == b.range.lo && a.range.hi == b.range.hi;
+}
+
+bool same_profile(const FizeauProfile &a, const FizeauProfile &b) {
+    return same_settings(a.day_settings, b.day_settings) && same_settings(a.night_settings, b.night_settings) &&
+        a.components == b.components && a.filter == b.filter &&
+        a.dusk_begin == b.dusk_begin && a.dusk_end == b.dusk_end && a.dawn_begin == b.dawn_begin &&
+        a.dawn_end == b.dawn_end && a.dimming_timeout == b.dimming_timeout && a.dimming_fade == b.dimming_fade &&
+        a.num_keyframes == b.num_keyframes &&
+        a.has_location == b.has_location && a.latitude == b.latitude && a.longitude == b.longitude &&
+        a.ambient_temperature == b.ambient_temperature && a.ambient_luminance == b.ambient_luminance;
+}
+
+bool check_boot() {
+    bool ok = true;
+    auto check = [&ok](bool cond, const char *what) {
+        if (!cond)
+            std::fprintf(stderr, "boot: %s\n", what), ok = false;
+    };
+
+    Harness h(true);
+
+    lo::ClientId c;
+    lo::connect(fz::Server::ServiceName.data(), &c), h.drain();
+    check(lo::is_connected(c), "service not registered while booting");
+
+    struct VersionedProfile {
+        std::uint32_t version;
+        FizeauProfile profile;
+    } defaults, loaded;
+
+    struct SetProfileIfVersion {
+        FizeauProfileId id;
+        std::uint32_t version;
+        FizeauProfile profile;
+    };
+
+    struct SetProfileIfVersionOut {
+        bool written;
+        std::uint32_t version;
+    } out;
+
+    Result rc = -1;
+    FizeauState state;
+    // No profile is set before the config is loaded
+    lo::send(c, FizeauCommandId_GetState, false), h.drain();
+    check(lo::receive(c, &rc, &state, sizeof(state)) && R_SUCCEEDED(rc) && !state.is_active &&
+        state.internal_profile == FizeauProfileId_Invalid && state.external_profile == FizeauProfileId_Invalid,
+        "query not answered from the default state");
+
+    lo::send(c, FizeauCommandId_GetVersionedProfile, FizeauProfileId_Profile1), h.drain();
+    check(lo::receive(c, &rc, &defaults, sizeof(defaults)) && R_SUCCEEDED(rc) &&
+        same_settings(defaults.profile.day_settings, fz::Config::default_settings), "GetVersionedProfile failed while booting");
+
+    // Writes are turned away rather than held, which would stall the other sessions
+    lo::send(c, FizeauCommandId_SetIsActive, true), h.drain();
+    check(lo::receive(c, &rc) && rc == FIZEAU_MAKERESULT(BUSY), "write not rejected as busy while booting");
+
+    h.finish_boot();
+
+    lo::send(c, FizeauCommandId_GetState, false), h.drain();
+    check(lo::receive(c, &rc, &state, sizeof(state)) && R_SUCCEEDED(rc) && state.is_active, "loaded state not published");
+
+    // A profile edited from the defaults is not blindly written over the loaded one
+    lo::send(c, FizeauCommandId_SetProfileIfVersion, SetProfileIfVersion{ FizeauProfileId_Profile1, defaults.version, defaults.profile });
+    h.drain();
+    check(lo::receive(c, &rc, &out, sizeof(out)) && R_SUCCEEDED(rc) && !out.written, "write based on the defaults accepted");
+
+    lo::send(c, FizeauCommandId_GetVersionedProfile, FizeauProfileId_Profile1), h.drain();
+    check(lo::receive(c, &rc, &loaded, sizeof(loaded)) && R_SUCCEEDED(rc) && loaded.version == out.version,
+        "version mismatch not reported");
+
+    lo::send(c, FizeauCommandId_SetIsActive, false), h.drain();
+    check(lo::receive(c, &rc) && R_SUCCEEDED(rc), "write failed after boot");
+
+    return ok;
+}
+
+// Round-trips every payload layout through fizeau.c and the server, including the packed id/profile and
+// bool/id pairs that the server reads at an aligned offset
+bool check_commands() {
+    bool ok = true;
+    auto check = [&ok](bool cond, const char *what) {
+        if (!cond)
+            std::fprintf(stderr, "commands: %s\n", what), ok = false;
+    };
+
+    bool is_service_active = false;
+    check(R_SUCCEEDED(fizeauIsServiceActive(&is_service_active)) && is_service_active, "service not registered");
+
+    FizeauProfile profile, read;
+    check(R_SUCCEEDED(fizeauGetProfile(FizeauProfileId_Profile3, &profile)), "GetProfile failed");
+    profile.day_settings.temperature   = 5500;
+    profile.night_settings.temperature = 2700;
+    profile.night_settings.saturation  = 0.75f;
+    profile.has_location = true, profile.latitude = 48.8566f, profile.longitude = 2.3522f;
+    profile.ambient_temperature = -1500, profile.ambient_luminance = -0.2f;
+    check(R_SUCCEEDED(fizeauSetProfile(FizeauProfileId_Profile3, &profile)), "SetProfile failed");
+    check(R_SUCCEEDED(fizeauGetProfile(FizeauProfileId_Profile3, &read)) && same_profile(profile, read),
+        "SetProfile payload mismatch");
+
+    FizeauProfileId internal, external;
+    check(R_SUCCEEDED(fizeauGetActiveProfileId(false, &internal)), "GetActiveProfileId failed");
+    check(R_SUCCEEDED(fizeauSetActiveProfileId(true, FizeauProfileId_Profile3)), "SetActiveProfileId failed");
+    check(R_SUCCEEDED(fizeauGetActiveProfileId(true, &external)) && external == FizeauProfileId_Profile3,
+        "SetActiveProfileId payload mismatch");
+    check(R_SUCCEEDED(fizeauGetActiveProfileId(false, &external)) && external == internal,
+        "SetActiveProfileId changed the other display");
+
+    FizeauState state;
+    check(R_SUCCEEDED(fizeauGetState(true, &state)) && state.is_active &&
+        state.external_profile == FizeauProfileId_Profile3 && same_profile(state.profile, profile),
+        "GetState payload mismatch");
+
+    profile.day_settings.temperature = 6000;
+    check(R_SUCCEEDED(fizeauStageProfile(FizeauProfileId_Profile2, &profile)), "StageProfile failed");
+    check(R_SUCCEEDED(fizeauGetProfile(FizeauProfileId_Profile2, &read)) && same_profile(profile, read),
+        "StageProfile payload mismatch");
+
+    bool is_active = true;
+    check(R_SUCCEEDED(fizeauSetState(false, FizeauProfileId_Profile2, FizeauProfileId_Profile1)), "SetState failed");
+    check(R_SUCCEEDED(fizeauGetIsActive(&is_active)) && !is_active, "SetState is_active mismatch");
+    check(R_SUCCEEDED(fizeauGetState(false, &state)) && state.internal_profile == FizeauProfileId_Profile2 &&
+        state.external_profile == FizeauProfileId_Profile1, "SetState profile id mismatch");
+
+    check(R_SUCCEEDED(fizeauSetIsActive(true)) && R_SUCCEEDED(fizeauGetIsActive(&is_active)) && is_active,
+        "SetIsActive payload mismatch");
+
+    std::uint32_t version, stale;
+    check(R_SUCCEEDED(fizeauGetVersionedProfile(FizeauProfileId_Profile2, &read, &version)) && same_profile(profile, read),
+        "GetVersionedProfile payload mismatch");
+    profile.dimming_timeout = { 0, 5, 0 }, profile.dimming_fade = 1500;
+    stale = version;
+    check(R_SUCCEEDED(fizeauSetProfileIfVersion(FizeauProfileId_Profile2, &profile, &version)) && version == stale + 1,
+        "SetProfileIfVersion failed");
+    check(R_SUCCEEDED(fizeauGetProfile(FizeauProfileId_Profile2, &read)) && same_profile(profile, read),
+        "SetProfileIfVersion payload mismatch");
+    check(fizeauSetProfileIfVersion(FizeauProfileId_Profile2, &profile, &stale) == FIZEAU_MAKERESULT(VERSION_MISMATCH) &&
+        stale == version, "SetProfileIfVersion conflict not reported");
+
+    FizeauKeyframe keyframe = { .time = { 19, 30, 0 }, .easing = Easing_Smoothstep, .settings = profile.night_settings }, kf;
+    check(R_SUCCEEDED(fizeauStageKeyframe(FizeauProfileId_Profile2, 3, &keyframe)) &&
+        R_SUCCEEDED(fizeauGetKeyframe(FizeauProfileId_Profile2, 3, &kf)) && kf.time == keyframe.time &&
+        kf.easing == keyframe.easing && same_settings(kf.settings, keyframe.settings), "StageKeyframe payload mismatch");
+    check(fizeauGetKeyframe(FizeauProfileId_Profile2, FIZEAU_MAX_KEYFRAMES, &kf) == FIZEAU_MAKERESULT(INVALID_KEYFRAME),
+        "invalid keyframe index accepted");
+
+    FizeauProfileId app_profile;
+    check(R_SUCCEEDED(fizeauSetAppProfile(0x0100000000010000, FizeauProfileId_Profile4)) &&
+        R_SUCCEEDED(fizeauGetAppProfile(0x0100000000010000, &app_profile)) && app_profile == FizeauProfileId_Profile4,
+        "SetAppProfile payload mismatch");
+    check(R_SUCCEEDED(fizeauSetAppProfile(0x0100000000010000, FizeauProfileId_Invalid)) &&
+        R_SUCCEEDED(fizeauGetAppProfile(0x0100000000010000, &app_profile)) && app_profile == FizeauProfileId_Invalid,
+        "SetAppProfile did not remove the rule");
+    bool filled = true;
+    for (std::uint64_t i = 0; i < FIZEAU_MAX_APP_RULES; ++i)
+        filled &= R_SUCCEEDED(fizeauSetAppProfile(0x0100000000010000 + (i << 16), FizeauProfileId_Profile3));
+    check(filled, "SetAppProfile failed");
+    check(fizeauSetAppProfile(0x0100000000ff0000, FizeauProfileId_Profile3) == FIZEAU_MAKERESULT(TOO_MANY_APPS),
+        "app rule past the table capacity accepted");
+    check(R_SUCCEEDED(fizeauClearAppProfiles()) &&
+        R_SUCCEEDED(fizeauGetAppProfile(0x0100000000010000, &app_profile)) && app_profile == FizeauProfileId_Invalid,
+        "ClearAppProfiles left rules behind");
+
+    check(fizeauSetActiveProfileId(false, FizeauProfileId_Invalid) == FIZEAU_MAKERESULT(INVALID_PROFILEID),
+        "invalid profile id accepted");
+
+    return ok;
+}
+
+template <typename F>
+CommandStats time_command(const char *name, std::uint32_t count, F &&f) {
+    std::vector<std::uint64_t> latencies(count);
+    CommandStats stats = { .name = name };
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        auto t = std::chrono::steady_clock::now();
+        stats.errors += R_FAILED(f(i));
+        latencies[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t).count();
+    }
+    stats.rps = count / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::sort(latencies.begin(), latencies.end());
+    stats.p50 = latencies[count / 2];
+    stats.p99 = latencies[count * 99 / 100];
+    return stats;
+}
+
+// Setters alternate between two values, so that every request does the same work as a user edit
+std::vector<CommandStats> commands(std::uint32_t count, bool &ok) {
+    Harness h;
+    if (auto rc = fizeauInitialize(); R_FAILED(rc))
+        diagAbortWithResult(rc);
+
+    ok &= check_commands();
+
+    FizeauProfile profiles[2];
+    fizeauGetProfile(FizeauProfileId_Profile1, &profiles[0]);
+    profiles[1] = profiles[0];
+    profiles[1].day_settings.temperature = 4500;
+
+    auto id = [](std::uint32_t i) { return (i & 1) ? FizeauProfileId_Profile2 : FizeauProfileId_Profile1; };
+
+    std::vector<CommandStats> stats;
+    stats.push_back(time_command("GetIsActive", count, [](std::uint32_t i) {
+        bool is_active;
+        return fizeauGetIsActive(&is_active);
+    }));
+    stats.push_back(time_command("SetIsActive", count, [](std::uint32_t i) {
+        return fizeauSetIsActive(i & 1);
+    }));
+    fizeauSetIsActive(true);
+    stats.push_back(time_command("GetProfile", count, [&id](std::uint32_t i) {
+        FizeauProfile profile;
+        return fizeauGetProfile(id(i), &profile);
+    }));
+    stats.push_back(time_command("SetProfile", count, [&profiles](std::uint32_t i) {
+        return fizeauSetProfile(FizeauProfileId_Profile1, &profiles[i & 1]);
+    }));
+    stats.push_back(time_command("GetActiveProfileId", count, [](std::uint32_t i) {
+        FizeauProfileId id;
+        return fizeauGetActiveProfileId(i & 1, &id);
+    }));
+    stats.push_back(time_command("SetActiveProfileId", count, [&id](std::uint32_t i) {
+        return fizeauSetActiveProfileId(false, id(i));
+    }));
+    stats.push_back(time_command("GetState", count, [](std::uint32_t i) {
+        FizeauState state;
+        return fizeauGetState(i & 1, &state);
+    }));
+    stats.push_back(time_command("StageProfile", count, [&profiles](std::uint32_t i) {
+        return fizeauStageProfile(FizeauProfileId_Profile1, &profiles[i & 1]);
+    }));
+    stats.push_back(time_command("SetState", count, [&id](std::uint32_t i) {
+        return fizeauSetState(true, id(i), FizeauProfileId_Profile1);
+    }));
+
+    stats.push_back(time_command("GetVersionedProfile", count, [&id](std::uint32_t i) {
+        FizeauProfile profile;
+        std::uint32_t version;
+        return fizeauGetVersionedProfile(id(i), &profile, &version);
+    }));
+    std::uint32_t version;
+    fizeauGetVersionedProfile(FizeauProfileId_Profile1, nullptr, &version);
+    stats.push_back(time_command("SetProfileIfVersion", count, [&profiles, &version](std::uint32_t i) {
+        return fizeauSetProfileIfVersion(FizeauProfileId_Profile1, &profiles[i & 1], &version);
+    }));
+
+    stats.push_back(time_command("SetAppProfile", count, [](std::uint32_t i) {
+        return fizeauSetAppProfile(0x0100000000010000 + ((i & 15) << 16), (i & 16) ? FizeauProfileId_Invalid : FizeauProfileId_Profile3);
+    }));
+    stats.push_back(time_command("GetAppProfile", count, [](std::uint32_t i) {
+        FizeauProfileId id;
+        return fizeauGetAppProfile(0x0100000000010000 + ((i & 15) << 16), &id);
+    }));
+
+    fizeauExit();
+    return stats;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool ok = true;
+
+    auto c = churn(100'000);
+    std::printf("churn:      %lu connects, %lu disconnects, %lu refused past %d sessions, %lu requests, %lu errors\n",
+        c.connects, c.disconnects, c.rejected, fz::Server::ServiceNumSessions, c.requests, c.errors);
+    ok &= !c.errors;
+
+    auto f = fairness(1'000'000);
+    std::printf("fairness:   %d sessions, max wait %u steps, %lu errors\n",
+        fz::Server::ServiceNumSessions, f.max_wait, f.errors);
+    std::printf("throughput: %.0f requests/s\n", f.requests / f.seconds);
+    ok &= !f.errors;
+
+    auto cas = conflicts(10'000, true), blind = conflicts(10'000, false);
+    std::printf("conflicts:  compare-and-set: %lu writes, %lu conflicts, %.2f reads/write, %lu lost\n",
+        cas.writes, cas.conflicts, double(cas.reads) / cas.writes, cas.lost);
+    std::printf("            read-modify-write: %lu writes, %.2f reads/write, %lu lost\n",
+        blind.writes, double(blind.reads) / blind.writes, blind.lost);
+    ok &= !cas.lost;
+
+    auto boot_ok = check_boot();
+    std::printf("boot:       %s\n", boot_ok ? "queries answered and writes busy while booting, loaded state published" : "failed");
+    ok &= boot_ok;
+
+    std::printf("commands:   %-20s %12s %10s %10s\n", "", "requests/s", "p50 (ns)", "p99 (ns)");
+    for (auto &cmd: commands(100'000, ok)) {
+        std::printf("            %-20s %12.0f %10lu %10lu\n", cmd.name, cmd.rps, cmd.p50, cmd.p99);
+        ok &= !cmd.errors;
+    }
+
+    return ok ? 0 : 1;
+}
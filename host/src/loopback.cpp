@@ -0,0 +1,355 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+
+#include "loopback.hpp"
+
+namespace {
+
+constexpr Handle port_handle_base    = 0x100;
+constexpr Handle session_handle_base = 0x10000;
+
+constexpr std::size_t msg_size       = 0x200;
+constexpr std::size_t msg_data_start = 0x10; // After the type and size words, aligned to 16
+
+using Message = std::array<u8, msg_size>;
+
+struct Port {
+    SmServiceName name;
+    std::vector<fz::host::loopback::ClientId> backlog;
+    std::uint32_t max_sessions, num_sessions;
+    bool registered;
+};
+
+struct Session {
+    enum class State {
+        Connecting,      // Queued on the port
+        Idle,
+        RequestPending,  // Sent by the client, not yet received by the server
+        Processing,      // Received by the server, not yet replied to
+        Replied,
+        Closed,
+    } state;
+
+    std::uint32_t port;
+    bool client_closed, server_closed, sent_while_connecting;
+    Message request, reply;
+};
+
+std::vector<Port>    ports;
+std::vector<Session> sessions; // Indexed by client id, ids are not reused
+
+alignas(16) Message tls;
+
+void (*server_step)(void *) = nullptr;
+void  *server_user          = nullptr;
+
+Port *get_port(Handle h) {
+    return (h >= port_handle_base && h - port_handle_base < ports.size()) ? &ports[h - port_handle_base] : nullptr;
+}
+
+Session *get_session(Handle h) {
+    return (h >= session_handle_base && h - session_handle_base < sessions.size()) ? &sessions[h - session_handle_base] : nullptr;
+}
+
+bool is_signaled(Handle h) {
+    if (auto *port = get_port(h); port)
+        return !port->backlog.empty();
+    if (auto *session = get_session(h); session)
+        return !session->server_closed && (session->client_closed || session->state == Session::State::RequestPending);
+    return false;
+}
+
+void release(Session &session) {
+    session.state = Session::State::Closed;
+    --ports[session.port].num_sessions;
+}
+
+// There is no other thread to wake us up, so waits never block
+Result wait(s32 *index, const Handle *handles, s32 count) {
+    for (s32 i = 0; i < count; ++i) {
+        if (is_signaled(handles[i])) {
+            *index = i;
+            return 0;
+        }
+    }
+    return KERNELRESULT(TimedOut);
+}
+
+} // namespace
+
+namespace fz::host::loopback {
+
+Result connect(const char *name, ClientId *id) {
+    auto encoded = smEncodeName(name);
+    auto it = std::find_if(ports.begin(), ports.end(), [&encoded](auto &port) {
+        return port.registered && !std::memcmp(&port.name, &encoded, sizeof(encoded));
+    });
+    if (it == ports.end())
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    // Sessions count against the limit until both ends are closed
+    if (it->num_sessions >= it->max_sessions)
+        return KERNELRESULT(OutOfSessions);
+    ++it->num_sessions;
+
+    *id = sessions.size();
+    sessions.push_back({ .state = Session::State::Connecting, .port = static_cast<std::uint32_t>(it - ports.begin()) });
+    it->backlog.push_back(*id);
+    return 0;
+}
+
+void close(ClientId id) {
+    auto &session = sessions[id];
+    if (std::exchange(session.client_closed, true))
+        return;
+
+    // Not accepted yet, the server will never see it
+    if (session.state == Session::State::Connecting) {
+        auto &backlog = ports[session.port].backlog;
+        backlog.erase(std::remove(backlog.begin(), backlog.end(), id), backlog.end());
+        session.server_closed = true;
+    }
+
+    if (session.server_closed)
+        release(session);
+}
+
+Result send(ClientId id, std::uint64_t cmd_id, const void *in, std::size_t in_size) {
+    auto &session = sessions[id];
+    if (session.client_closed || session.server_closed)
+        return KERNELRESULT(ConnectionClosed);
+    bool can_send = session.state == Session::State::Idle || session.state == Session::State::Replied ||
+        (session.state == Session::State::Connecting && !session.sent_while_connecting);
+    if (!can_send)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    struct {
+        u64 magic;
+        u64 cmd_id;
+    } header = { CMIF_IN_HEADER_MAGIC, cmd_id };
+    if (msg_data_start + sizeof(header) + in_size > msg_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    // Sizes include the 0x10 bytes of alignment padding, as real CMIF messages do
+    HipcMetadata meta = {
+        .type           = CmifCommandType_Request,
+        .num_data_words = static_cast<u32>((sizeof(header) + in_size + 0x10 + 3) / 4),
+    };
+    std::memcpy(session.request.data(), &meta, sizeof(meta));
+    std::memcpy(session.request.data() + msg_data_start, &header, sizeof(header));
+    std::memcpy(session.request.data() + msg_data_start + sizeof(header), in, in_size);
+
+    // Requests sent before the connection was accepted are delivered right after
+    if (session.state == Session::State::Connecting)
+        session.sent_while_connecting = true;
+    else
+        session.state = Session::State::RequestPending;
+    return 0;
+}
+
+bool receive(ClientId id, Result *rc, void *out, std::size_t out_size) {
+    auto &session = sessions[id];
+    if (session.server_closed && session.state != Session::State::Replied) {
+        *rc = KERNELRESULT(ConnectionClosed);
+        return true;
+    }
+    if (session.state != Session::State::Replied)
+        return false;
+
+    struct {
+        u64 magic;
+        u64 result;
+    } header;
+    std::memcpy(&header, session.reply.data() + msg_data_start, sizeof(header));
+
+    *rc = static_cast<Result>(header.result);
+    if (out && R_SUCCEEDED(*rc))
+        std::memcpy(out, session.reply.data() + msg_data_start + sizeof(header), out_size);
+
+    session.state = Session::State::Idle;
+    return true;
+}
+
+bool is_connected(ClientId id) {
+    auto &session = sessions[id];
+    return session.state != Session::State::Connecting && !session.client_closed && !session.server_closed;
+}
+
+bool has_pending() {
+    return std::any_of(ports.begin(), ports.end(), [](auto &p) { return !p.backlog.empty(); }) ||
+        std::any_of(sessions.begin(), sessions.end(), [](auto &s) {
+            return s.state != Session::State::Closed && !s.server_closed &&
+                (s.state == Session::State::RequestPending || (s.client_closed && s.state != Session::State::Connecting));
+        });
+}
+
+void reset() {
+    ports.clear();
+    sessions.clear();
+}
+
+void set_server_step(void (*step)(void *user), void *user) {
+    server_step = step, server_user = user;
+}
+
+} // namespace fz::host::loopback
+
+extern "C" {
+
+Result smRegisterService(Handle *handle_out, SmServiceName name, bool is_light, s32 max_sessions) {
+    ports.push_back({
+        .name         = name,
+        .backlog      = {},
+        .max_sessions = static_cast<std::uint32_t>(max_sessions),
+        .num_sessions = 0,
+        .registered   = true,
+    });
+    *handle_out = port_handle_base + ports.size() - 1;
+    return 0;
+}
+
+Result smUnregisterService(SmServiceName name) {
+    for (auto &port: ports) {
+        if (port.registered && !std::memcmp(&port.name, &name, sizeof(name))) {
+            port.registered = false;
+            return 0;
+        }
+    }
+    return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+}
+
+Result smGetService(Service *service_out, const char *name) {
+    fz::host::loopback::ClientId id;
+    if (auto rc = fz::host::loopback::connect(name, &id); R_FAILED(rc))
+        return rc;
+
+    service_out->session = session_handle_base + id;
+    return 0;
+}
+
+void serviceClose(Service *s) {
+    if (get_session(s->session))
+        fz::host::loopback::close(s->session - session_handle_base);
+    s->session = INVALID_HANDLE;
+}
+
+Result serviceDispatchImpl(Service *s, u32 request_id, const void *in_data, u32 in_data_size, void *out_data, u32 out_data_size) {
+    if (!get_session(s->session))
+        return MAKERESULT(Module_Libnx, LibnxError_NotInitialized);
+
+    auto id = s->session - session_handle_base;
+    if (auto rc = fz::host::loopback::send(id, request_id, in_data, in_data_size); R_FAILED(rc))
+        return rc;
+
+    Result rc;
+    while (!fz::host::loopback::receive(id, &rc, out_data, out_data_size)) {
+        // Nobody to serve the request, a real client would block forever
+        if (!server_step || !fz::host::loopback::has_pending())
+            return KERNELRESULT(TimedOut);
+        server_step(server_user);
+    }
+    return rc;
+}
+
+TipcService *smGetServiceSessionTipc(void) {
+    static TipcService sm = {};
+    return &sm;
+}
+
+Result tipcDispatchImpl(TipcService *s, u32 request_id, const void *in_data, u32 in_data_size, void *out_data, u32 out_data_size) {
+    // AMS HasService
+    if (request_id != 65100 || in_data_size != sizeof(SmServiceName) || out_data_size != sizeof(bool))
+        return KERNELRESULT(NotImplemented);
+
+    auto *name = static_cast<const SmServiceName *>(in_data);
+    *static_cast<bool *>(out_data) = std::any_of(ports.begin(), ports.end(), [name](auto &port) {
+        return port.registered && !std::memcmp(&port.name, name, sizeof(*name));
+    });
+    return 0;
+}
+
+void *armGetTls(void) {
+    return tls.data();
+}
+
+HipcParsedRequest hipcParseRequest(void *base) {
+    HipcParsedRequest r;
+    std::memcpy(&r.meta, base, sizeof(r.meta));
+    r.data.data_words = reinterpret_cast<u32 *>(static_cast<u8 *>(base) + sizeof(r.meta));
+    return r;
+}
+
+HipcRequest hipcMakeRequest(void *base, HipcMetadata meta) {
+    std::memcpy(base, &meta, sizeof(meta));
+    return { reinterpret_cast<u32 *>(static_cast<u8 *>(base) + sizeof(meta)) };
+}
+
+Result svcCloseHandle(Handle handle) {
+    if (auto *session = get_session(handle); session && !std::exchange(session->server_closed, true)) {
+        if (session->client_closed)
+            release(*session);
+    }
+    return 0;
+}
+
+Result svcAcceptSession(Handle *session_handle, Handle port_handle) {
+    auto *port = get_port(port_handle);
+    if (!port || port->backlog.empty())
+        return KERNELRESULT(TimedOut);
+
+    auto id = port->backlog.front();
+    port->backlog.erase(port->backlog.begin());
+
+    auto &session = sessions[id];
+    session.state = session.sent_while_connecting ? Session::State::RequestPending : Session::State::Idle;
+
+    *session_handle = session_handle_base + id;
+    return 0;
+}
+
+Result svcWaitSynchronization(s32 *index, const Handle *handles, s32 handle_count, s64 timeout) {
+    return wait(index, handles, handle_count);
+}
+
+Result svcReplyAndReceive(s32 *index, const Handle *handles, s32 handle_count, Handle reply_target, u64 timeout) {
+    if (auto *session = get_session(reply_target); session && session->state == Session::State::Processing) {
+        session->reply = tls;
+        session->state = Session::State::Replied;
+    }
+
+    if (auto rc = wait(index, handles, handle_count); R_FAILED(rc))
+        return rc;
+
+    auto *session = get_session(handles[*index]);
+    if (!session)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    if (session->client_closed)
+        return KERNELRESULT(ConnectionClosed);
+
+    tls = session->request;
+    session->state = Session::State::Processing;
+    return 0;
+}
+
+} // extern "C"
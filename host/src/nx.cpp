@@ -0,0 +1,412 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <utility>
+#include <switch.h>
+#include <omm.h>
+
+#include "host.hpp"
+
+// Host implementations of the libnx functions declared in include/switch.h
+
+namespace {
+
+constexpr u64 tick_freq = 19'200'000;
+
+// Open files, indexed by session handle - 1
+std::array<FILE *, 0x10> files = {};
+
+std::string sdmc_path(const char *path) {
+    auto *root = std::getenv("FZ_SDMC_ROOT");
+    return std::string(root ? root : ".") + path;
+}
+
+FILE *get_file(FsFile *f) {
+    return (f->s.session != INVALID_HANDLE && f->s.session <= files.size()) ? files[f->s.session - 1] : nullptr;
+}
+
+} // namespace
+
+namespace fz::host {
+
+constinit Backends backends = {};
+
+// Registers are only reachable through svcQueryMemoryMapping, which needs the backend
+std::uint32_t mmio_read(std::uint64_t va) {
+    return backends.mmio->read(va);
+}
+
+void mmio_write(std::uint64_t va, std::uint32_t val) {
+    backends.mmio->write(va, val);
+}
+
+} // namespace fz::host
+
+using fz::host::backends;
+
+extern "C" {
+
+void diagAbortWithResult(Result res) {
+    std::fprintf(stderr, "Aborted with result %#x (%04d-%04d)\n", res, 2000 + R_MODULE(res), R_DESCRIPTION(res));
+    std::abort();
+}
+
+u64 armGetSystemTick(void) {
+    if (backends.clock.enabled)
+        return backends.clock.tick;
+
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return armNsToTicks(static_cast<u64>(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec);
+}
+
+u64 armGetSystemTickFreq(void) {
+    return tick_freq;
+}
+
+Result timeInitialize(void) {
+    return 0;
+}
+
+void timeExit(void) { }
+
+Result timeGetCurrentTime(TimeType type, u64 *timestamp) {
+    if (backends.clock.enabled)
+        *timestamp = backends.clock.epoch + armTicksToNs(backends.clock.tick) / 1'000'000'000;
+    else
+        *timestamp = static_cast<u64>(std::time(nullptr));
+    return 0;
+}
+
+Result timeToCalendarTimeWithMyRule(u64 timestamp, TimeCalendarTime *caltime, TimeCalendarAdditionalInfo *info) {
+    std::time_t t = static_cast<std::time_t>(timestamp);
+    std::tm tm;
+
+    // The virtual clock has its own time zone, to be independent from the host one
+    if (backends.clock.enabled) {
+        t += backends.clock.utc_offset;
+        if (!gmtime_r(&t, &tm))
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+        tm.tm_gmtoff = backends.clock.utc_offset;
+    } else if (!localtime_r(&t, &tm)) {
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    }
+
+    *caltime = {
+        .year   = static_cast<u16>(tm.tm_year + 1900),
+        .month  = static_cast<u8>(tm.tm_mon + 1),
+        .day    = static_cast<u8>(tm.tm_mday),
+        .hour   = static_cast<u8>(tm.tm_hour),
+        .minute = static_cast<u8>(tm.tm_min),
+        .second = static_cast<u8>(tm.tm_sec),
+    };
+
+    if (info) {
+        *info = {
+            .wday   = static_cast<u32>(tm.tm_wday),
+            .yday   = static_cast<u32>(tm.tm_yday),
+            .DST    = static_cast<u32>(tm.tm_isdst > 0),
+            .offset = static_cast<s32>(tm.tm_gmtoff),
+        };
+    }
+
+    return 0;
+}
+
+Result fsInitialize(void) {
+    return 0;
+}
+
+void fsExit(void) { }
+
+Result fsOpenSdCardFileSystem(FsFileSystem *out) {
+    *out = {};
+    return 0;
+}
+
+void fsFsClose(FsFileSystem *fs) { }
+
+Result fsFsCreateFile(FsFileSystem *fs, const char *path, s64 size, u32 option) {
+    auto *fp = std::fopen(sdmc_path(path).c_str(), "wb");
+    if (!fp)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+    std::fclose(fp);
+    return 0;
+}
+
+Result fsFsDeleteFile(FsFileSystem *fs, const char *path) {
+    return std::remove(sdmc_path(path).c_str()) ? MAKERESULT(Module_Libnx, LibnxError_NotFound) : 0;
+}
+
+Result fsFsOpenFile(FsFileSystem *fs, const char *path, u32 mode, FsFile *out) {
+    auto it = std::find(files.begin(), files.end(), nullptr);
+    if (it == files.end())
+        return MAKERESULT(Module_Libnx, LibnxError_OutOfMemory);
+
+    auto *fp = std::fopen(sdmc_path(path).c_str(), (mode & FsOpenMode_Write) ? "r+b" : "rb");
+    if (!fp)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    *it = fp;
+    out->s.session = static_cast<Handle>(it - files.begin() + 1);
+    return 0;
+}
+
+Result fsFileRead(FsFile *f, s64 off, void *buf, u64 read_size, u32 option, u64 *bytes_read) {
+    auto *fp = get_file(f);
+    if (!fp || std::fseek(fp, off, SEEK_SET))
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    *bytes_read = std::fread(buf, 1, read_size, fp);
+    return 0;
+}
+
+Result fsFileWrite(FsFile *f, s64 off, const void *buf, u64 write_size, u32 option) {
+    auto *fp = get_file(f);
+    if (!fp || std::fseek(fp, off, SEEK_SET) || std::fwrite(buf, 1, write_size, fp) != write_size)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    if (option & FsWriteOption_Flush)
+        std::fflush(fp);
+    return 0;
+}
+
+void fsFileClose(FsFile *f) {
+    if (auto *fp = get_file(f); fp) {
+        std::fclose(fp);
+        files[f->s.session - 1] = nullptr;
+    }
+    f->s.session = INVALID_HANDLE;
+}
+
+Result svcQueryMemoryMapping(u64 *virtaddr, u64 *out_size, u64 physaddr, u64 size) {
+    if (!backends.mmio)
+        return KERNELRESULT(NotImplemented);
+
+    *out_size = size;
+    return backends.mmio->map(virtaddr, physaddr, size);
+}
+
+void svcSleepThread(s64 nano) {
+    if (!backends.clock.enabled) {
+        timespec ts = { .tv_sec = nano / 1'000'000'000, .tv_nsec = nano % 1'000'000'000 };
+        nanosleep(&ts, nullptr);
+        return;
+    }
+
+    backends.clock.advance(nano);
+    if (backends.mmio)
+        backends.mmio->advance(backends.clock.tick);
+}
+
+void mutexLock(Mutex *m) {
+    // Nothing else runs to release it, the caller would wait forever on the console
+    if (std::exchange(*m, 1)) {
+        std::fprintf(stderr, "Deadlock on mutex %p\n", static_cast<void *>(m));
+        std::abort();
+    }
+}
+
+bool mutexTryLock(Mutex *m) {
+    return !std::exchange(*m, 1);
+}
+
+void mutexUnlock(Mutex *m) {
+    *m = 0;
+}
+
+Result waitObjects(s32 *idx_out, const Waiter *objects, s32 num_objects, u64 timeout) {
+    // Nothing else runs while the caller waits, only user events signaled beforehand complete it
+    for (s32 i = 0; i < num_objects; ++i) {
+        auto *e = static_cast<UEvent *>(objects[i].object);
+        if (objects[i].type != 1 || !e->signaled)
+            continue;
+
+        if (e->auto_clear)
+            e->signaled = false;
+        *idx_out = i;
+        return 0;
+    }
+
+    return KERNELRESULT(TimedOut);
+}
+
+void eventClose(Event *t) { }
+
+void ueventCreate(UEvent *e, bool auto_clear) {
+    *e = { .signaled = false, .auto_clear = auto_clear };
+}
+
+void ueventSignal(UEvent *e) {
+    e->signaled = true;
+}
+
+void utimerCreate(UTimer *t, u64 interval, TimerType type) {
+    *t = { .type = type, .started = false, .next_tick = 0, .interval = interval };
+}
+
+void utimerStart(UTimer *t) {
+    t->started   = true;
+    t->next_tick = armGetSystemTick() + armNsToTicks(t->interval);
+}
+
+Result threadCreate(Thread *t, ThreadFunc entry, void *arg, void *stack_mem, size_t stack_sz, int prio, int cpuid) {
+    *t = { .handle = INVALID_HANDLE, .entry = entry, .arg = arg };
+    return 0;
+}
+
+Result threadStart(Thread *t) {
+    return 0;
+}
+
+Result threadWaitForExit(Thread *t) {
+    return 0;
+}
+
+Result threadClose(Thread *t) {
+    return 0;
+}
+
+Result ommInitialize(void) {
+    return 0;
+}
+
+void ommExit() { }
+
+Result ommGetOperationMode(AppletOperationMode *mode) {
+    *mode = backends.events ? backends.events->get_operation_mode() : AppletOperationMode_Handheld;
+    return 0;
+}
+
+Result ommGetOperationModeChangeEvent(Event *out, bool autoclear) {
+    *out = { .revent = INVALID_HANDLE, .wevent = INVALID_HANDLE, .autoclear = autoclear };
+    return 0;
+}
+
+Result insrInitialize(void) {
+    return 0;
+}
+
+void insrExit(void) { }
+
+Result insrGetLastTick(u32 id, u64 *tick) {
+    *tick = backends.events ? backends.events->get_last_activity_tick() : armGetSystemTick();
+    return 0;
+}
+
+Result insrGetReadableEvent(u32 id, Event *out) {
+    *out = { .revent = INVALID_HANDLE, .wevent = INVALID_HANDLE, .autoclear = false };
+    return 0;
+}
+
+Result pmdmntInitialize(void) {
+    return 0;
+}
+
+void pmdmntExit(void) { }
+
+// Process ids stand for the program ids
+Result pmdmntGetApplicationProcessId(u64 *pid_out) {
+    auto id = backends.events ? backends.events->get_application_id() : 0;
+    if (!id)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    *pid_out = id;
+    return 0;
+}
+
+Result pminfoInitialize(void) {
+    return 0;
+}
+
+void pminfoExit(void) { }
+
+Result pminfoGetProgramId(u64 *program_id_out, u64 pid) {
+    *program_id_out = pid;
+    return 0;
+}
+
+Result pglInitialize(void) {
+    return 0;
+}
+
+void pglExit(void) { }
+
+Result pglGetEventObserver(PglEventObserver *out) {
+    *out = {};
+    return 0;
+}
+
+Result pglEventObserverGetProcessEvent(PglEventObserver *observer, Event *out) {
+    *out = { .revent = INVALID_HANDLE, .wevent = INVALID_HANDLE, .autoclear = true };
+    return 0;
+}
+
+// Events are not queued, the backend is queried for the current application instead
+Result pglEventObserverGetProcessEventInfo(PglEventObserver *observer, PmProcessEventInfo *out) {
+    *out = { .event = PmProcessEvent_None, .process_id = 0 };
+    return 0;
+}
+
+void pglEventObserverClose(PglEventObserver *observer) { }
+
+Result lblInitialize(void) {
+    return 0;
+}
+
+void lblExit(void) { }
+
+Result lblIsAmbientLightSensorAvailable(bool *out) {
+    *out = backends.light != nullptr;
+    return 0;
+}
+
+// The sensor saturates around 10klx, in direct sunlight
+Result lblGetAmbientLightSensorValue(bool *over_limit, float *lux) {
+    if (!backends.light)
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    auto value  = backends.light->get_illuminance();
+    *over_limit = value > 10'000.0f;
+    *lux        = std::min(value, 10'000.0f);
+    return 0;
+}
+
+Result nvOpen(u32 *fd, const char *devicepath) {
+    if (backends.display)
+        return backends.display->open(fd, devicepath);
+
+    static u32 next_fd = 1;
+    *fd = next_fd++;
+    return 0;
+}
+
+Result nvIoctl(u32 fd, u32 request, void *argp) {
+    return backends.display ? backends.display->ioctl(fd, request, argp) : 0;
+}
+
+Result nvClose(u32 fd) {
+    return 0;
+}
+
+} // extern "C"
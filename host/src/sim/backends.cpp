@@ -0,0 +1,218 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstring>
+#include <algorithm>
+#include <tuple>
+#include <string_view>
+
+#include "t210_regs.hpp"
+
+#include "backends.hpp"
+
+namespace fz::sim {
+
+namespace {
+
+constexpr std::uint32_t disp0_fd = 1, disp1_fd = 2;
+
+} // namespace
+
+RegisterFile::RegisterFile(): clock(CLOCK_IO_SIZE / sizeof(std::uint32_t)), disp(DISP_IO_SIZE / sizeof(std::uint32_t)) {
+    this->set_display_clocks(true);
+    this->disp_reg(false, DC_CMD_DISPLAY_COMMAND) = DISP_CTRL_MODE_C_DISP;
+    this->disp_reg(true,  DC_CMD_DISPLAY_COMMAND) = DISP_CTRL_MODE_C_DISP;
+}
+
+Result RegisterFile::map(std::uint64_t *va, std::uint64_t pa, std::uint64_t size) {
+    if (pa == CLOCK_IO_BASE && size <= CLOCK_IO_SIZE)
+        *va = reinterpret_cast<std::uint64_t>(this->clock.data());
+    else if (pa == DISP_IO_BASE && size <= DISP_IO_SIZE)
+        *va = reinterpret_cast<std::uint64_t>(this->disp.data());
+    else
+        return KERNELRESULT(NotImplemented);
+
+    return 0;
+}
+
+void RegisterFile::advance(std::uint64_t tick) {
+    if (tick <= this->last_tick)
+        return;
+
+    // Requests written since the last call are dated from it
+    auto period     = armNsToTicks(FramePeriod);
+    auto next_frame = (this->last_tick / period + 1) * period;
+    auto enabled    = this->clock_reg(CLK_RST_CONTROLLER_CLK_OUT_ENB_L);
+
+    for (bool external: { false, true }) {
+        auto &ctrl = this->disp_reg(external, DC_CMD_STATE_CONTROL);
+        auto &request_tick = this->request_ticks[external];
+        if (!(ctrl & GENERAL_ACT_REQ))
+            continue;
+
+        if (request_tick == UINT64_MAX)
+            request_tick = this->last_tick;
+
+        if (next_frame > tick || !(enabled & (!external ? CLK_ENB_DISP1 : CLK_ENB_DISP2)))
+            continue;
+
+        ctrl &= ~(GENERAL_ACT_REQ | GENERAL_UPDATE);
+        this->latches.push_back({ next_frame, external, armTicksToNs(next_frame - request_tick) });
+        request_tick = UINT64_MAX;
+    }
+
+    this->last_tick = tick;
+}
+
+std::uint32_t RegisterFile::read(std::uint64_t va) {
+    auto off = va - reinterpret_cast<std::uint64_t>(this->disp.data());
+    if (off >= DISP_IO_SIZE)
+        return MmioBackend::read(va);
+
+    // The data registers return the entry selected in the read registers, when enabled
+    bool external = off >= 0x40000;
+    auto reg = off % 0x40000;
+    if (reg == DC_COM_CMU_LUT1 && (this->disp_reg(external, DC_COM_CMU_LUT1_READ) & LUT1_READ_EN)) {
+        auto idx = (this->disp_reg(external, DC_COM_CMU_LUT1_READ) >> 8) & 0xff;
+        ++this->num_lut_reads;
+        return LUT1_ADDR(idx) | LUT1_DATA(this->lut_1[external][idx]);
+    }
+
+    if (reg == DC_COM_CMU_LUT2 && (this->disp_reg(external, DC_COM_CMU_LUT2_READ) & LUT2_READ_EN)) {
+        auto idx = (this->disp_reg(external, DC_COM_CMU_LUT2_READ) >> 8) & 0x3ff;
+        ++this->num_lut_reads;
+        return LUT2_ADDR(idx) | LUT2_DATA((idx < this->lut_2[external].size()) ? this->lut_2[external][idx] : 0);
+    }
+
+    return MmioBackend::read(va);
+}
+
+void RegisterFile::write(std::uint64_t va, std::uint32_t val) {
+    MmioBackend::write(va, val);
+
+    auto off = va - reinterpret_cast<std::uint64_t>(this->disp.data());
+    if (off >= DISP_IO_SIZE)
+        return;
+
+    // Entries are written with their index
+    bool external = off >= 0x40000;
+    auto reg = off % 0x40000;
+    if (reg == DC_CMD_STATE_CONTROL && (val & GENERAL_ACT_REQ))
+        ++this->num_requests;
+    else if (reg == DC_COM_CMU_LUT1)
+        this->lut_1[external][LUT1_ADDR(val)] = LUT1_READ_DATA(val);
+    else if (reg == DC_COM_CMU_LUT2 && LUT2_ADDR(val) < this->lut_2[external].size())
+        this->lut_2[external][LUT2_ADDR(val)] = LUT2_READ_DATA(val);
+}
+
+void RegisterFile::set_display_clocks(bool enable) {
+    auto &reg = this->clock_reg(CLK_RST_CONTROLLER_CLK_OUT_ENB_L);
+    reg = enable ? (reg | CLK_ENB_DISP1 | CLK_ENB_DISP2) : (reg & ~(CLK_ENB_DISP1 | CLK_ENB_DISP2));
+}
+
+void RegisterFile::reset_cmu(bool external) {
+    this->disp_reg(external, DC_DISP_DISP_COLOR_CONTROL) &= ~CMU_ENABLE;
+    for (std::size_t i = 0; i < std::tuple_size_v<DisplayController::Csc>; ++i)
+        this->disp_reg(external, DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t)) = 0;
+}
+
+void RegisterFile::enable_cmu(bool external) {
+    this->disp_reg(external, DC_DISP_DISP_COLOR_CONTROL) |= CMU_ENABLE;
+    for (std::size_t i = 0; i < std::tuple_size_v<DisplayController::Csc>; ++i)
+        this->disp_reg(external, DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t)) = (i % 4 == 0) ? 0x100 : 0;
+}
+
+void RegisterFile::load_luts(bool external, const Cmu &cmu) {
+    std::transform(cmu.lut_1.begin(), cmu.lut_1.end(), this->lut_1[external].begin(), [](std::uint16_t v) { return v & 0xfff; });
+    std::transform(cmu.lut_2.begin(), cmu.lut_2.end(), this->lut_2[external].begin(), [](std::uint16_t v) { return v & 0xff; });
+}
+
+Cmu RegisterFile::read_cmu(bool external) {
+    Cmu cmu(!!(this->disp_reg(external, DC_DISP_DISP_COLOR_CONTROL) & CMU_ENABLE));
+    for (std::size_t i = 0; i < std::tuple_size_v<DisplayController::Csc>; ++i)
+        (&cmu.krr)[i] = QS18(static_cast<std::int16_t>(this->disp_reg(external, DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t))));
+    std::copy(this->lut_1[external].begin(), this->lut_1[external].end(), cmu.lut_1.begin());
+    std::copy(this->lut_2[external].begin(), this->lut_2[external].end(), cmu.lut_2.begin());
+    return cmu;
+}
+
+void RegisterFile::corrupt_lut(bool external, std::size_t index) {
+    if (index < this->lut_1[external].size())
+        this->lut_1[external][index] ^= 0xfff;
+    else
+        this->lut_2[external][index - this->lut_1[external].size()] ^= 0xff;
+}
+
+Result RecordingDisplay::open(u32 *fd, const char *path) {
+    auto p = std::string_view(path);
+    if (p == "/dev/nvdisp-disp0")
+        *fd = disp0_fd;
+    else if (p == "/dev/nvdisp-disp1")
+        *fd = disp1_fd;
+    else
+        return MAKERESULT(Module_Libnx, LibnxError_NotFound);
+
+    return 0;
+}
+
+Result RecordingDisplay::ioctl(u32 fd, u32 request, void *argp) {
+    if (fd != disp0_fd && fd != disp1_fd)
+        return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+
+    switch (_NV_IOC_NR(request)) {
+        case 14: { // SetCmu
+            auto *cmu = static_cast<Cmu *>(argp);
+            bool external = fd == disp1_fd;
+
+            Commit commit = {
+                .tick     = armGetSystemTick(),
+                .external = external,
+                .enable   = !!cmu->enable,
+            };
+            std::transform(&cmu->krr, &cmu->krr + commit.csc.size(), commit.csc.begin(),
+                [](QS18 c) -> std::uint16_t { return static_cast<DisplayController::Csc::value_type>(c) & QS18::BitMask; });
+            this->commits.push_back(commit);
+
+            auto &ctrl = this->regs.disp_reg(external, DC_DISP_DISP_COLOR_CONTROL);
+            ctrl = cmu->enable ? (ctrl | CMU_ENABLE) : (ctrl & ~CMU_ENABLE);
+            for (std::size_t i = 0; i < commit.csc.size(); ++i)
+                this->regs.disp_reg(external, DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t)) = commit.csc[i];
+            if (cmu->enable)
+                this->regs.load_luts(external, *cmu);
+            break;
+        }
+        case 16: // GetAviInfoframe
+            std::memcpy(argp, &this->infoframe, sizeof(this->infoframe));
+            break;
+        case 17: // SetAviInfoframe
+            std::memcpy(&this->infoframe, argp, sizeof(this->infoframe));
+            ++this->num_infoframe_writes;
+            break;
+        default:
+            return MAKERESULT(Module_Libnx, LibnxError_BadInput);
+    }
+
+    return 0;
+}
+
+float ScriptedLight::get_illuminance() {
+    auto jitter = std::uniform_real_distribution<float>(-this->noise, this->noise)(this->rng);
+    return std::max(this->lux * (1.0f + jitter), 0.0f);
+}
+
+} // namespace fz::sim
@@ -0,0 +1,151 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <random>
+#include <vector>
+#include <switch.h>
+
+#include "host.hpp"
+#include "nvdisp.hpp"
+
+namespace fz::sim {
+
+// Backing memory for the clock and display controller register blocks, mapped in place of the real IO regions.
+// The sysmodule reads it through the READ() macro exactly like it would the hardware.
+// Both heads scan out at 60Hz from tick 0, and clear activation requests at the first frame start that follows.
+// The LUTs are kept aside, and reached through their indexed data registers
+class RegisterFile: public host::MmioBackend {
+    public:
+        constexpr static std::uint64_t FramePeriod = 16'666'667; // ns
+
+        // Activation of the general state staged by the sysmodule
+        struct Latch {
+            std::uint64_t tick;
+            bool external;
+            std::uint64_t latency; // ns, from the first time the request was seen
+        };
+
+    public:
+        RegisterFile();
+
+        Result map(std::uint64_t *va, std::uint64_t pa, std::uint64_t size) override;
+        void advance(std::uint64_t tick) override;
+        std::uint32_t read(std::uint64_t va) override;
+        void write(std::uint64_t va, std::uint32_t val) override;
+
+        std::uint32_t &clock_reg(std::uint32_t off) {
+            return this->clock[off / sizeof(std::uint32_t)];
+        }
+
+        // DISPLAY_A drives the internal panel, DISPLAY_B the external output
+        std::uint32_t &disp_reg(bool external, std::uint32_t off) {
+            return this->disp[((external ? 0x40000 : 0) + off) / sizeof(std::uint32_t)];
+        }
+
+        void set_display_clocks(bool enable);
+
+        // State of a display head after nvdrv reinitializes it (panel power cycle, sleep)
+        void reset_cmu(bool external);
+
+        // State of a display head after another process commits an identity CMU to it
+        void enable_cmu(bool external);
+
+        void load_luts(bool external, const Cmu &cmu);
+
+        // CMU active on a display head, as the display controller would apply it to the next frame
+        Cmu read_cmu(bool external);
+
+        // Flips the bits of an entry of the LUTs (LUT1 then LUT2), as a foreign write would
+        void corrupt_lut(bool external, std::size_t index);
+
+    public:
+        std::vector<Latch> latches;
+        std::uint64_t num_requests  = 0; // Activation requests written, latched or not yet
+        std::uint64_t num_lut_reads = 0;
+
+    private:
+        std::vector<std::uint32_t> clock, disp;
+        std::array<DisplayController::Lut1, 2> lut_1 = {};
+        std::array<DisplayController::Lut2, 2> lut_2 = {};
+        std::uint64_t last_tick = 0;
+        std::array<std::uint64_t, 2> request_ticks = { UINT64_MAX, UINT64_MAX }; // When pending requests were first seen
+};
+
+// Fake nvdisp device nodes, recording every CMU commit and mirroring it to the register file
+class RecordingDisplay: public host::DisplayBackend {
+    public:
+        struct Commit {
+            std::uint64_t tick;
+            bool external, enable;
+            DisplayController::Csc csc;
+        };
+
+    public:
+        RecordingDisplay(RegisterFile &regs): regs(regs) { }
+
+        Result open(u32 *fd, const char *path) override;
+        Result ioctl(u32 fd, u32 request, void *argp) override;
+
+    public:
+        std::vector<Commit> commits;
+        std::size_t num_infoframe_writes = 0;
+
+    private:
+        RegisterFile &regs;
+        AviInfoframe infoframe = {};
+};
+
+// Dock and activity state, driven by the scenario
+class ScriptedEvents: public host::EventBackend {
+    public:
+        AppletOperationMode get_operation_mode() override {
+            return this->operation_mode;
+        }
+
+        std::uint64_t get_last_activity_tick() override {
+            return this->activity_tick;
+        }
+
+        std::uint64_t get_application_id() override {
+            return this->application_id;
+        }
+
+    public:
+        AppletOperationMode operation_mode = AppletOperationMode_Handheld;
+        std::uint64_t activity_tick = 0;
+        std::uint64_t application_id = 0;
+};
+
+// Ambient light, driven by the scenario. Readings jitter around the set illuminance, as those of a real sensor do
+class ScriptedLight: public host::LightSensorBackend {
+    public:
+        float get_illuminance() override;
+
+    public:
+        float lux   = 0.0f;
+        float noise = 0.0f; // Relative amplitude of the jitter
+
+    private:
+        std::minstd_rand rng{0xf12};
+};
+
+} // namespace fz::sim
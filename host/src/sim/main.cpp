@@ -0,0 +1,423 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+#include <common.hpp>
+
+#include "context.hpp"
+#include "nvdisp.hpp"
+#include "profile.hpp"
+#include "server.hpp"
+
+#include "host.hpp"
+#include "io.hpp"
+#include "backends.hpp"
+#include "scenario.hpp"
+
+// Replays scenario files against the sysmodule logic (ProfileManager, DisplayController, Server),
+// with the hardware and system services replaced by the fakes in backends.hpp, under a virtual clock.
+// Commit and wakeup counts are deterministic, apply latencies are host CPU time.
+// Commits are either nvdisp ioctls or CSC writes staged in the registers and latched at the next frame
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::uint64_t transition_period = std::chrono::nanoseconds(100ms).count();
+
+struct Report {
+    std::string name;
+    std::uint64_t duration = 0, wakeups = 0, applies = 0, commits = 0, infoframe_writes = 0;
+    std::uint64_t lut_reads = 0; // Entries read back by the verifier
+    std::vector<double> apply_latencies;   // us, host time
+    std::vector<double> recovery_latencies; // ms, virtual time from wake/dock to the next commit
+    std::vector<double> convergence_times;  // s, virtual time from a light change to the last commit it caused
+    std::vector<double> latch_latencies;    // ms, virtual time from a staged CSC write to its activation on vblank
+};
+
+bool load_config(const std::string &path, fz::Context &context) {
+    fz::Config config;
+    if (!fz::host::load_config(path.c_str(), config, context.profiles, &context.keyframes))
+        return false;
+
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id)
+        context.compile_timeline(static_cast<FizeauProfileId>(id));
+
+    for (std::size_t i = 0; i < config.num_app_rules; ++i)
+        context.app_profiles.insert(config.app_rules[i].program_id, config.app_rules[i].profile);
+    context.app_profile_mask = context.app_profiles.profile_mask();
+
+    context.is_active        = config.active;
+    context.internal_profile = config.internal_profile;
+    context.external_profile = config.external_profile;
+    return true;
+}
+
+// Largest difference of an output channel between two CMUs, over a cube of input colors
+int max_deviation(const fz::Cmu &a, const fz::Cmu &b) {
+    constexpr int step = 5;
+    std::vector<std::uint8_t> colors;
+    for (int r = 0; r <= 255; r += step)
+        for (int g = 0; g <= 255; g += step)
+            for (int b = 0; b <= 255; b += step)
+                colors.insert(colors.end(), { std::uint8_t(r), std::uint8_t(g), std::uint8_t(b) });
+
+    auto out_a = colors, out_b = colors;
+    fz::cmu::Model(a).apply(colors.data(), out_a.data(), colors.size() / 3, 3);
+    fz::cmu::Model(b).apply(colors.data(), out_b.data(), colors.size() / 3, 3);
+
+    int deviation = 0;
+    for (std::size_t i = 0; i < colors.size(); ++i)
+        deviation = std::max(deviation, std::abs(out_a[i] - out_b[i]));
+    return deviation;
+}
+
+template <typename T>
+Result dispatch(fz::Server &server, FizeauCommandId cmd, const T &in) {
+    IpcServerRequest r = {
+        .hipc = {},
+        .data = {
+            .cmdId = cmd,
+            .ptr   = const_cast<T *>(&in),
+            .size  = sizeof(in),
+        },
+    };
+
+    std::uint8_t out[IPC_SERVER_EXT_RESPONSE_MAX_DATA_SIZE];
+    std::size_t out_size = 0;
+    return fz::Server::command_handler(&server, &r, out, &out_size);
+}
+
+std::optional<Report> run(const fz::sim::Scenario &sc) {
+    fz::sim::RegisterFile     regs;
+    fz::sim::RecordingDisplay display(regs);
+    fz::sim::ScriptedEvents   events;
+    fz::sim::ScriptedLight    light;
+
+    light.lux = sc.lux, light.noise = sc.light_noise;
+
+    fz::host::backends = {
+        .clock   = {
+            .enabled    = true,
+            .tick       = 0,
+            .epoch      = static_cast<std::uint64_t>(sc.date * 24 * 60 * 60 + sc.start - sc.utc_offset),
+            .utc_offset = sc.utc_offset,
+        },
+        .display = &display,
+        .mmio    = &regs,
+        .events  = &events,
+        .light   = sc.has_light_sensor ? &light : nullptr,
+    };
+
+    fz::Context context = {};
+    context.is_lite           = sc.is_lite;
+    context.lut_verify_blocks = sc.lut_verify_blocks;
+
+    fz::DisplayController disp = {};
+    fz::ProfileManager profile(context, disp);
+    fz::Server server(context, profile);
+
+    if (auto rc = fz::Clock::initialize(); R_FAILED(rc))
+        return std::nullopt;
+
+    if (auto rc = disp.initialize(context.is_lite); R_FAILED(rc))
+        return std::nullopt;
+
+    if (auto rc = profile.initialize(); R_FAILED(rc))
+        return std::nullopt;
+
+    if (!sc.config_path.empty() && !load_config(sc.config_path, context)) {
+        std::fprintf(stderr, "%s: could not load %s\n", sc.name.c_str(), sc.config_path.c_str());
+        return std::nullopt;
+    }
+
+    Report report = { .name = sc.name, .duration = sc.duration };
+
+    auto &clock = fz::host::backends.clock;
+    std::uint64_t recovery_start = UINT64_MAX;
+    std::uint64_t light_change = UINT64_MAX, last_light_commit = UINT64_MAX;
+
+    // A reset leaves a bypassed CMU as the sysmodule wants it, then there is nothing to recover
+    auto start_recovery = [&](bool external) {
+        auto &shadow = !external ? context.cmu_shadow_internal : context.cmu_shadow_external;
+        recovery_start = shadow.is_bypassed ? UINT64_MAX : clock.tick;
+    };
+
+    auto end_convergence = [&] {
+        if (light_change != UINT64_MAX && last_light_commit != UINT64_MAX)
+            report.convergence_times.push_back(armTicksToNs(last_light_commit - light_change) / 1e9);
+        light_change = last_light_commit = UINT64_MAX;
+    };
+
+    // Runs a step of the sysmodule and attributes its cost to an apply if it committed anything.
+    // Staged CSC writes count when they are requested, they latch after the step
+    auto num_commits = [&] {
+        return display.commits.size() + regs.latches.size();
+    };
+
+    auto step = [&](auto &&f) {
+        auto prev_commits = display.commits.size() + regs.num_requests;
+
+        auto start = std::chrono::steady_clock::now();
+        f();
+        auto end   = std::chrono::steady_clock::now();
+
+        if (display.commits.size() + regs.num_requests != prev_commits) {
+            report.applies++;
+            report.apply_latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+
+            if (recovery_start != UINT64_MAX) {
+                report.recovery_latencies.push_back(armTicksToNs(clock.tick - recovery_start) / 1e6);
+                recovery_start = UINT64_MAX;
+            }
+
+            if (light_change != UINT64_MAX)
+                last_light_commit = clock.tick;
+        }
+    };
+
+    step([&] { profile.apply(); });
+
+    std::uint64_t next_transition = transition_period;
+    auto evt = sc.events.begin();
+
+    while (true) {
+        auto next_evt = (evt != sc.events.end()) ? evt->time : UINT64_MAX;
+        auto now = std::min(next_transition, next_evt);
+        if (now >= sc.duration)
+            break;
+
+        // Sleeps in the sysmodule code can run the clock past the next scheduled step
+        clock.tick = std::max(clock.tick, armNsToTicks(now));
+        regs.advance(clock.tick);
+
+        // On ties the poll runs first, so that recovery latencies are measured in the worst case
+        if (next_evt < next_transition) {
+            switch (evt->type) {
+                case fz::sim::Scenario::EventType::Handheld:
+                case fz::sim::Scenario::EventType::Docked: {
+                    bool docked = evt->type == fz::sim::Scenario::EventType::Docked;
+                    events.operation_mode = docked ? AppletOperationMode_Console : AppletOperationMode_Handheld;
+                    regs.reset_cmu(docked);
+                    start_recovery(docked);
+                    step([&] { profile.update_operation_mode(); });
+                    break;
+                }
+                case fz::sim::Scenario::EventType::Activity:
+                    events.activity_tick = clock.tick;
+                    step([&] { profile.update_activity(); });
+                    break;
+                case fz::sim::Scenario::EventType::Sleep:
+                    regs.set_display_clocks(false);
+                    regs.reset_cmu(false);
+                    regs.reset_cmu(true);
+                    break;
+                case fz::sim::Scenario::EventType::Wake:
+                    regs.set_display_clocks(true);
+                    start_recovery(events.operation_mode == AppletOperationMode_Console);
+                    break;
+                case fz::sim::Scenario::EventType::SetActive:
+                    step([&] { dispatch(server, FizeauCommandId_SetIsActive, static_cast<bool>(evt->args[0])); });
+                    break;
+                case fz::sim::Scenario::EventType::SetProfileId: {
+                    struct {
+                        bool is_external;
+                        FizeauProfileId id;
+                    } in = { !!evt->args[0], static_cast<FizeauProfileId>(evt->args[1]) };
+                    step([&] { dispatch(server, FizeauCommandId_SetActiveProfileId, in); });
+                    break;
+                }
+                case fz::sim::Scenario::EventType::SetProfile: {
+                    struct {
+                        FizeauProfileId id;
+                        FizeauProfile profile;
+                    } in = { static_cast<FizeauProfileId>(evt->args[0]), context.profiles[evt->args[0]] };
+                    step([&] { dispatch(server, FizeauCommandId_SetProfile, in); });
+                    break;
+                }
+                case fz::sim::Scenario::EventType::StageProfile: {
+                    struct {
+                        FizeauProfileId id;
+                        FizeauProfile profile;
+                    } in = { static_cast<FizeauProfileId>(evt->args[0]), context.profiles[evt->args[0]] };
+                    step([&] { dispatch(server, FizeauCommandId_StageProfile, in); });
+                    break;
+                }
+                case fz::sim::Scenario::EventType::SetState: {
+                    struct {
+                        bool is_active;
+                        FizeauProfileId internal_profile, external_profile;
+                    } in = { !!evt->args[0], static_cast<FizeauProfileId>(evt->args[1]), static_cast<FizeauProfileId>(evt->args[2]) };
+                    step([&] { dispatch(server, FizeauCommandId_SetState, in); });
+                    break;
+                }
+                case fz::sim::Scenario::EventType::Timezone:
+                    clock.utc_offset = static_cast<std::int32_t>(evt->args[0]);
+                    break;
+                case fz::sim::Scenario::EventType::Launch:
+                case fz::sim::Scenario::EventType::Exit:
+                    events.application_id = (static_cast<std::uint64_t>(evt->args[1]) << 32) | evt->args[0];
+                    step([&] { profile.update_application(); });
+                    break;
+                case fz::sim::Scenario::EventType::Light:
+                    end_convergence();
+                    light.lux    = std::bit_cast<float>(evt->args[0]);
+                    light_change = clock.tick;
+                    break;
+                case fz::sim::Scenario::EventType::ForeignCmu: {
+                    bool docked = events.operation_mode == AppletOperationMode_Console;
+                    regs.enable_cmu(docked);
+                    recovery_start = clock.tick;
+                    break;
+                }
+                case fz::sim::Scenario::EventType::CorruptLut: {
+                    bool docked = events.operation_mode == AppletOperationMode_Console;
+                    regs.corrupt_lut(docked, evt->args[0]);
+                    start_recovery(docked);
+                    break;
+                }
+                case fz::sim::Scenario::EventType::CheckDimmed: {
+                    // The fade scales the CSC of the undimmed CMU, its end should match the dimmed luminance in the LUT2
+                    bool docked = events.operation_mode == AppletOperationMode_Console;
+                    auto id = context.get_profile(docked);
+                    if (id >= FizeauProfileId_Total)
+                        break;
+
+                    auto settings = context.timelines[id].evaluate(fz::Clock::get_current_timestamp());
+                    settings.luminance = !docked ? fz::dimmed_luma_internal : fz::dimmed_luma_external;
+
+                    fz::Cmu reference;
+                    fz::calculate_cmu(reference, settings, context.profiles[id].components, context.profiles[id].filter);
+
+                    if (auto deviation = max_deviation(regs.read_cmu(docked), reference); deviation > static_cast<int>(evt->args[0])) {
+                        std::fprintf(stderr, "%s: dimmed %s head deviates by %d from its CMU at %.1fs\n", sc.name.c_str(),
+                            !docked ? "internal" : "external", deviation, evt->time / 1e9);
+                        return std::nullopt;
+                    }
+                    break;
+                }
+            }
+
+            ++evt;
+            continue;
+        }
+
+        report.wakeups++;
+
+        std::uint64_t delay = 0;
+        step([&] { delay = profile.update_transition(); });
+        next_transition += transition_period + delay;
+    }
+
+    end_convergence();
+
+    report.commits          = num_commits();
+    report.infoframe_writes = display.num_infoframe_writes;
+    report.lut_reads        = regs.num_lut_reads;
+    for (auto &latch: regs.latches)
+        report.latch_latencies.push_back(latch.latency / 1e6);
+
+    profile.finalize();
+    disp   .finalize();
+
+    fz::host::backends = {};
+    return report;
+}
+
+double percentile(std::vector<double> &values, double p) {
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<std::size_t>(values.size() * p / 100))];
+}
+
+void print_usage(const char *argv0) {
+    std::fprintf(stderr, "Usage: %s [-c out.csv] scenario...\n", argv0);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const char *csv_path = nullptr;
+
+    std::vector<const char *> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-c") && i + 1 < argc)
+            csv_path = argv[++i];
+        else if (argv[i][0] == '-')
+            return print_usage(argv[0]), 1;
+        else
+            paths.push_back(argv[i]);
+    }
+
+    if (paths.empty())
+        return print_usage(argv[0]), 1;
+
+    std::vector<Report> reports;
+    for (auto *path: paths) {
+        fz::sim::Scenario sc;
+        if (!sc.parse(path))
+            return 1;
+
+        auto report = run(sc);
+        if (!report)
+            return 1;
+
+        reports.push_back(std::move(*report));
+    }
+
+    std::printf("%-20s %9s %8s %8s %8s %10s %10s %10s %12s %12s %10s %12s\n", "scenario", "duration", "wakeups", "applies", "commits",
+        "p50 (us)", "p99 (us)", "max (us)", "recover (ms)", "converge (s)", "latch (ms)", "lut reads/s");
+
+    for (auto &r: reports) {
+        std::printf("%-20s %8.0fs %8lu %8lu %8lu %10.1f %10.1f %10.1f %12.1f %12.1f %10.1f %12.1f\n", r.name.c_str(), r.duration / 1e9,
+            r.wakeups, r.applies, r.commits,
+            percentile(r.apply_latencies, 50), percentile(r.apply_latencies, 99), percentile(r.apply_latencies, 100),
+            percentile(r.recovery_latencies, 100), percentile(r.convergence_times, 100), percentile(r.latch_latencies, 100),
+            r.lut_reads / (r.duration / 1e9));
+    }
+
+    if (csv_path) {
+        auto *fp = std::fopen(csv_path, "w");
+        if (!fp)
+            return 1;
+        FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+        std::fprintf(fp, "scenario,duration_s,wakeups,applies,commits,infoframe_writes,apply_p50_us,apply_p99_us,apply_max_us,recovery_max_ms,convergence_max_s,latch_max_ms,lut_reads_per_s\n");
+        for (auto &r: reports) {
+            std::fprintf(fp, "%s,%.3f,%lu,%lu,%lu,%lu,%.2f,%.2f,%.2f,%.1f,%.1f,%.1f,%.1f\n", r.name.c_str(), r.duration / 1e9,
+                r.wakeups, r.applies, r.commits, r.infoframe_writes,
+                percentile(r.apply_latencies, 50), percentile(r.apply_latencies, 99), percentile(r.apply_latencies, 100),
+                percentile(r.recovery_latencies, 100), percentile(r.convergence_times, 100), percentile(r.latch_latencies, 100),
+                r.lut_reads / (r.duration / 1e9));
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,266 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <string_view>
+#include <utility>
+
+#include <common.hpp>
+
+#include "scenario.hpp"
+
+namespace fz::sim {
+
+namespace {
+
+// Parses durations such as 1h30m, 45s or 250ms, returns false on malformed input
+bool parse_duration(const char *str, std::uint64_t &out) {
+    constexpr std::array units = {
+        std::pair{ std::string_view("ms"), 1'000'000ull },
+        std::pair{ std::string_view("h"),  60ull * 60 * 1'000'000'000 },
+        std::pair{ std::string_view("m"),  60ull * 1'000'000'000 },
+        std::pair{ std::string_view("s"),  1'000'000'000ull },
+    };
+
+    out = 0;
+    if (!*str)
+        return false;
+
+    while (*str) {
+        char *end;
+        auto val = std::strtoull(str, &end, 10);
+        if (end == str)
+            return false;
+
+        auto it = std::find_if(units.begin(), units.end(),
+            [end](auto &unit) { return std::string_view(end).starts_with(unit.first); });
+        if (it == units.end())
+            return false;
+
+        out += val * it->second;
+        str  = end + it->first.size();
+    }
+
+    return true;
+}
+
+bool parse_clock_time(const char *str, std::uint64_t &out) {
+    unsigned int h = 0, m = 0, s = 0;
+    if (std::sscanf(str, "%u:%u:%u", &h, &m, &s) < 2 || h >= 24 || m >= 60 || s >= 60)
+        return false;
+
+    out = 60 * 60 * h + 60 * m + s;
+    return true;
+}
+
+// Days since 1970-01-01 of a yyyy-mm-dd date in the proleptic Gregorian calendar
+bool parse_date(const char *str, std::int64_t &out) {
+    int y = 0;
+    unsigned int m = 0, d = 0;
+    if (std::sscanf(str, "%d-%u-%u", &y, &m, &d) != 3 || m < 1 || m > 12 || d < 1 || d > 31)
+        return false;
+
+    y -= m <= 2;
+    auto era = (y >= 0 ? y : y - 399) / 400;
+    auto yoe = static_cast<unsigned int>(y - era * 400);
+    auto doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    auto doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    out = static_cast<std::int64_t>(era) * 146097 + doe - 719468;
+    return true;
+}
+
+// UTC offsets written as +hh:mm or -hh:mm
+bool parse_utc_offset(const char *str, std::int32_t &out) {
+    unsigned int h = 0, m = 0;
+    if ((str[0] != '+' && str[0] != '-') || std::sscanf(str + 1, "%u:%u", &h, &m) != 2 || h > 14 || m >= 60)
+        return false;
+
+    out = (str[0] == '-' ? -1 : 1) * static_cast<std::int32_t>(60 * 60 * h + 60 * m);
+    return true;
+}
+
+bool parse_event(char *tokens[], std::size_t num_tokens, Scenario::Event &evt) {
+    constexpr std::array events = {
+        std::tuple{ std::string_view("handheld"),       Scenario::EventType::Handheld,     0 },
+        std::tuple{ std::string_view("docked"),         Scenario::EventType::Docked,       0 },
+        std::tuple{ std::string_view("activity"),       Scenario::EventType::Activity,     0 },
+        std::tuple{ std::string_view("sleep"),          Scenario::EventType::Sleep,        0 },
+        std::tuple{ std::string_view("wake"),           Scenario::EventType::Wake,         0 },
+        std::tuple{ std::string_view("set-active"),     Scenario::EventType::SetActive,    1 },
+        std::tuple{ std::string_view("set-profile-id"), Scenario::EventType::SetProfileId, 2 },
+        std::tuple{ std::string_view("set-profile"),    Scenario::EventType::SetProfile,   1 },
+        std::tuple{ std::string_view("stage-profile"),  Scenario::EventType::StageProfile, 1 },
+        std::tuple{ std::string_view("set-state"),      Scenario::EventType::SetState,     3 },
+        std::tuple{ std::string_view("timezone"),       Scenario::EventType::Timezone,     1 },
+        std::tuple{ std::string_view("launch"),         Scenario::EventType::Launch,       1 },
+        std::tuple{ std::string_view("exit"),           Scenario::EventType::Exit,         0 },
+        std::tuple{ std::string_view("light"),          Scenario::EventType::Light,        1 },
+        std::tuple{ std::string_view("foreign-cmu"),    Scenario::EventType::ForeignCmu,   0 },
+        std::tuple{ std::string_view("corrupt-lut"),    Scenario::EventType::CorruptLut,   1 },
+        std::tuple{ std::string_view("check-dimmed"),   Scenario::EventType::CheckDimmed,  1 },
+    };
+
+    if (num_tokens < 3 || !parse_duration(tokens[1], evt.time))
+        return false;
+
+    auto it = std::find_if(events.begin(), events.end(),
+        [&tokens](auto &e) { return std::get<0>(e) == tokens[2]; });
+    if (it == events.end() || num_tokens != 3 + static_cast<std::size_t>(std::get<2>(*it)))
+        return false;
+
+    evt.type = std::get<1>(*it);
+
+    switch (evt.type) {
+        case Scenario::EventType::SetActive:
+            evt.args[0] = std::strtoul(tokens[3], nullptr, 10);
+            break;
+        case Scenario::EventType::SetProfileId:
+            if (std::strcmp(tokens[3], "internal") && std::strcmp(tokens[3], "external"))
+                return false;
+            evt.args[0] = !std::strcmp(tokens[3], "external");
+            evt.args[1] = std::strtoul(tokens[4], nullptr, 10) - 1;
+            return evt.args[1] < FizeauProfileId_Total;
+        case Scenario::EventType::SetProfile:
+        case Scenario::EventType::StageProfile:
+            evt.args[0] = std::strtoul(tokens[3], nullptr, 10) - 1;
+            return evt.args[0] < FizeauProfileId_Total;
+        case Scenario::EventType::SetState:
+            evt.args[0] = std::strtoul(tokens[3], nullptr, 10);
+            evt.args[1] = std::strtoul(tokens[4], nullptr, 10) - 1;
+            evt.args[2] = std::strtoul(tokens[5], nullptr, 10) - 1;
+            return evt.args[1] < FizeauProfileId_Total && evt.args[2] < FizeauProfileId_Total;
+        case Scenario::EventType::Timezone: {
+            std::int32_t offset;
+            if (!parse_utc_offset(tokens[3], offset))
+                return false;
+            evt.args[0] = static_cast<std::uint32_t>(offset);
+            break;
+        }
+        case Scenario::EventType::Launch: {
+            // Program id split in its low and high words
+            auto id = std::strtoull(tokens[3], nullptr, 16);
+            evt.args[0] = static_cast<std::uint32_t>(id), evt.args[1] = static_cast<std::uint32_t>(id >> 32);
+            return id != 0;
+        }
+        case Scenario::EventType::Light: {
+            // Illuminance as float bits
+            char *end;
+            auto lux = std::strtof(tokens[3], &end);
+            evt.args[0] = std::bit_cast<std::uint32_t>(lux);
+            return end != tokens[3] && lux >= 0.0f;
+        }
+        case Scenario::EventType::CorruptLut:
+            evt.args[0] = std::strtoul(tokens[3], nullptr, 10);
+            return evt.args[0] < DisplayController::NumLutBlocks * DisplayController::LutBlockSize;
+        case Scenario::EventType::CheckDimmed:
+            evt.args[0] = std::strtoul(tokens[3], nullptr, 10);
+            break;
+        default:
+            break;
+    }
+
+    return true;
+}
+
+} // namespace
+
+bool Scenario::parse(const char *path) {
+    auto *fp = std::fopen(path, "r");
+    if (!fp) {
+        std::fprintf(stderr, "%s: could not open\n", path);
+        return false;
+    }
+    FZ_SCOPEGUARD([&fp] { std::fclose(fp); });
+
+    auto p = std::string_view(path);
+    auto dir = p.substr(0, p.find_last_of('/') + 1);
+    this->name = p.substr(dir.size(), p.find_last_of('.') - dir.size());
+
+    char line[0x100];
+    for (int lineno = 1; std::fgets(line, sizeof(line), fp); ++lineno) {
+        if (auto *comment = std::strchr(line, '#'); comment)
+            *comment = '\0';
+
+        std::array<char *, 6> tokens;
+        std::size_t num_tokens = 0;
+        char *saveptr;
+        for (auto *tok = strtok_r(line, " \t\r\n", &saveptr); tok && num_tokens < tokens.size();
+                tok = strtok_r(nullptr, " \t\r\n", &saveptr))
+            tokens[num_tokens++] = tok;
+
+        if (!num_tokens)
+            continue;
+
+        auto directive = std::string_view(tokens[0]);
+
+        bool ok = false;
+        if (directive == "config" && num_tokens == 2) {
+            this->config_path = std::string(dir) + tokens[1];
+            ok = true;
+        } else if (directive == "start" && num_tokens == 2) {
+            ok = parse_clock_time(tokens[1], this->start);
+        } else if (directive == "date" && num_tokens == 2) {
+            ok = parse_date(tokens[1], this->date);
+        } else if (directive == "timezone" && num_tokens == 2) {
+            ok = parse_utc_offset(tokens[1], this->utc_offset);
+        } else if (directive == "duration" && num_tokens == 2) {
+            ok = parse_duration(tokens[1], this->duration);
+        } else if (directive == "hardware" && num_tokens == 2) {
+            auto hw = std::string_view(tokens[1]);
+            this->is_lite = hw == "lite";
+            ok = hw == "lite" || hw == "erista" || hw == "mariko";
+        } else if (directive == "light" && (num_tokens == 2 || num_tokens == 3)) {
+            char *end;
+            this->has_light_sensor = true;
+            this->lux         = std::strtof(tokens[1], &end);
+            this->light_noise = (num_tokens == 3) ? std::strtof(tokens[2], nullptr) / 100.0f : 0.0f;
+            ok = end != tokens[1] && this->lux >= 0.0f && this->light_noise >= 0.0f;
+        } else if (directive == "lut-verify" && num_tokens == 2) {
+            char *end;
+            this->lut_verify_blocks = std::strtoul(tokens[1], &end, 10);
+            ok = end != tokens[1] && this->lut_verify_blocks <= DisplayController::NumLutBlocks;
+        } else if (directive == "at") {
+            Event evt = {};
+            if ((ok = parse_event(tokens.data(), num_tokens, evt)))
+                this->events.push_back(evt);
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "%s:%d: invalid line\n", path, lineno);
+            return false;
+        }
+    }
+
+    if (!this->has_light_sensor && std::any_of(this->events.begin(), this->events.end(),
+            [](const Event &e) { return e.type == EventType::Light; })) {
+        std::fprintf(stderr, "%s: light events without a light sensor\n", path);
+        return false;
+    }
+
+    std::stable_sort(this->events.begin(), this->events.end(),
+        [](const Event &lhs, const Event &rhs) { return lhs.time < rhs.time; });
+
+    return true;
+}
+
+} // namespace fz::sim
@@ -0,0 +1,99 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <switch.h>
+
+#include "nvdisp.hpp"
+
+namespace fz::sim {
+
+// Scenario files are line-based, '#' starts a comment:
+//   config   <path>                  INI file loaded at boot, relative to the scenario
+//   start    <hh:mm[:ss]>            Wall clock time at boot
+//   date     <yyyy-mm-dd>            Local date at boot
+//   timezone <+hh:mm|-hh:mm>         UTC offset of the local time
+//   duration <time>                  Length of the simulation
+//   hardware <erista|mariko|lite>
+//   light    <lux> [noise %]         Installs an ambient light sensor reading this, with readings jittering by up to noise
+//   lut-verify <blocks>              LUT blocks the sysmodule reads back per poll, 0 disables verification
+//   at <time> <event> [args]         Timed event, times are offsets from boot written as eg. 1h30m, 45s, 250ms
+// Events:
+//   handheld, docked                 Operation mode change, the newly active head gets reinitialized
+//   activity                         User input
+//   sleep, wake                      Display clocks gated and both heads reinitialized, then ungated
+//   set-active <0|1>                 IPC commands, with the same payloads as the fizeau client
+//   set-profile-id <internal|external> <1-4>
+//   set-profile <1-4>                Resends the current settings of a profile, as the overlay does on edit
+//   stage-profile <1-4>              Same, without committing
+//   set-state <0|1> <1-4> <1-4>      Active state and internal/external profiles, committed at once as the application does on load
+//   timezone <+hh:mm|-hh:mm>         Time zone change, the wall clock jumps accordingly
+//   launch <program id>              Application launch (in hex), replacing the running one
+//   exit                             Application exit
+//   light <lux>                      Ambient light change, needs the light directive
+//   foreign-cmu                      Another process commits an identity CMU to the active head
+//   corrupt-lut <index>              An entry of the LUTs of the active head is overwritten (0-255 in LUT1, then LUT2)
+//   check-dimmed <lsbs>              Fails the scenario if the active head, run through the CMU model, deviates by more than
+//                                    this from the CMU calculated at the dimmed luminance
+struct Scenario {
+    enum class EventType {
+        Handheld,
+        Docked,
+        Activity,
+        Sleep,
+        Wake,
+        SetActive,
+        SetProfileId,
+        SetProfile,
+        StageProfile,
+        SetState,
+        Timezone,
+        Launch,
+        Exit,
+        Light,
+        ForeignCmu,
+        CorruptLut,
+        CheckDimmed,
+    };
+
+    struct Event {
+        std::uint64_t time; // ns since boot
+        EventType type;
+        std::uint32_t args[3];
+    };
+
+    std::string name, config_path;
+    std::uint64_t start      = 12 * 60 * 60;             // s since midnight
+    std::int64_t  date       = 0;                        // Days since 1970-01-01
+    std::int32_t  utc_offset = 0;                        // s
+    std::uint64_t duration   = 60ull * 1'000'000'000ull; // ns
+    bool is_lite = false;
+    bool has_light_sensor = false;
+    float lux = 0.0f, light_noise = 0.0f; // Relative
+    std::uint32_t lut_verify_blocks = DisplayController::DefaultLutVerifyBlocks;
+    std::vector<Event> events;
+
+    // Prints the offending line to stderr on failure
+    bool parse(const char *path);
+};
+
+} // namespace fz::sim
@@ -0,0 +1,119 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <string_view>
+
+#include <common.hpp>
+
+// Checks the solar times used by profiles with a location against published sunrise and sunset tables,
+// and that days without a sunrise or a sunset are reported as such
+
+namespace {
+
+// Maximum error against the tables, which are rounded to the minute
+constexpr int Tolerance = 2; // min
+
+struct Reference {
+    std::string_view place;
+    float latitude, longitude;
+    std::int64_t day;        // Days since 1970-01-01
+    std::int32_t utc_offset; // min
+    int sunrise, sunset;     // min since local midnight, -1 when the sun doesn't rise or set
+};
+
+constexpr int hm(int h, int m) {
+    return 60 * h + m;
+}
+
+// Local sunrise and sunset from published almanac tables, rounded to the minute
+constexpr Reference references[] = {
+    { "London",    51.5074f,   -0.1278f, 19895,  60, hm( 4, 43), hm(21, 21) }, // 2024-06-21
+    { "London",    51.5074f,   -0.1278f, 20078,   0, hm( 8,  4), hm(15, 53) }, // 2024-12-21
+    { "Paris",     48.8566f,    2.3522f, 19895, 120, hm( 5, 47), hm(21, 58) }, // 2024-06-21
+    { "New York",  40.7128f,  -74.0060f, 19894, -240, hm( 5, 25), hm(20, 31) }, // 2024-06-20
+    { "New York",  40.7128f,  -74.0060f, 20078, -300, hm( 7, 17), hm(16, 32) }, // 2024-12-21
+    { "Tokyo",     35.6762f,  139.6503f, 19895, 540, hm( 4, 25), hm(19,  0) }, // 2024-06-21
+    { "Tokyo",     35.6762f,  139.6503f, 20078, 540, hm( 6, 47), hm(16, 32) }, // 2024-12-21
+    { "Sydney",   -33.8688f,  151.2093f, 19895, 600, hm( 7,  0), hm(16, 54) }, // 2024-06-21
+    { "Sydney",   -33.8688f,  151.2093f, 20078, 660, hm( 5, 41), hm(20,  5) }, // 2024-12-21
+    { "Reykjavik", 64.1466f,  -21.9426f, 20078,   0, hm(11, 22), hm(15, 29) }, // 2024-12-21
+    { "Tromso",    69.6492f,   18.9553f, 19895, 120, -1,         -1         }, // 2024-06-21, midnight sun
+    { "Tromso",    69.6492f,   18.9553f, 20078,  60, -1,         -1         }, // 2024-12-21, polar night
+};
+
+int to_minutes(const Time &t) {
+    return to_timestamp(t) / 60;
+}
+
+// Signed difference on a 24h circle
+int difference(int a, int b) {
+    auto d = (a - b + 24 * 60) % (24 * 60);
+    return d > 12 * 60 ? d - 24 * 60 : d;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool verbose = argc > 1 && !std::strcmp(argv[1], "-v");
+
+    int failures = 0, max_error = 0;
+    for (auto &ref: references) {
+        fz::SolarTimes times;
+        bool has_times = fz::compute_solar_times(ref.latitude, ref.longitude, ref.day, ref.utc_offset * 60, times);
+
+        if (ref.sunrise < 0) {
+            if (has_times)
+                std::fprintf(stderr, "%s (day %ld): expected no sunrise\n", ref.place.data(), ref.day), ++failures;
+            else if (verbose)
+                std::printf("%-10s %6ld %8s %8s\n", ref.place.data(), ref.day, "-", "-");
+            continue;
+        }
+
+        if (!has_times) {
+            std::fprintf(stderr, "%s (day %ld): no sunrise computed\n", ref.place.data(), ref.day), ++failures;
+            continue;
+        }
+
+        auto rise_err = difference(to_minutes(times.sunrise), ref.sunrise),
+             set_err  = difference(to_minutes(times.sunset),  ref.sunset);
+
+        // Civil twilight brackets the sunrise and sunset
+        bool ordered = difference(to_minutes(times.sunrise), to_minutes(times.civil_dawn)) > 0 &&
+                       difference(to_minutes(times.civil_dusk), to_minutes(times.sunset)) > 0;
+
+        if (std::abs(rise_err) > Tolerance || std::abs(set_err) > Tolerance || !ordered) {
+            std::fprintf(stderr, "%s (day %ld): sunrise off by %dmin, sunset off by %dmin%s\n", ref.place.data(), ref.day,
+                rise_err, set_err, ordered ? "" : ", twilight out of order");
+            ++failures;
+        }
+
+        max_error = std::max({ max_error, std::abs(rise_err), std::abs(set_err) });
+
+        if (verbose)
+            std::printf("%-10s %6ld    %02u:%02u %+3d    %02u:%02u %+3d    (civil %02u:%02u-%02u:%02u)\n",
+                ref.place.data(), ref.day, times.sunrise.h, times.sunrise.m, rise_err, times.sunset.h, times.sunset.m,
+                set_err, times.civil_dawn.h, times.civil_dawn.m, times.civil_dusk.h, times.civil_dusk.m);
+    }
+
+    std::printf("%zu references, %d failed, max error %dmin\n", std::size(references), failures, max_error);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,118 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdint>
+#include <vector>
+
+#include <common.hpp>
+
+#include "app_table.hpp"
+
+#include "test.hpp"
+
+namespace {
+
+// Program ids of applications only differ in their middle bits, and many land in the same slots
+std::uint64_t program_id(std::size_t i) {
+    return 0x0100000000000000ull | (static_cast<std::uint64_t>(i) << 16);
+}
+
+FizeauProfileId profile_of(std::size_t i) {
+    return static_cast<FizeauProfileId>(i % FizeauProfileId_Total);
+}
+
+} // namespace
+
+FZ_TEST(app_table_insert_find) {
+    fz::AppProfileTable table;
+    FZ_CHECK(table.find(program_id(1)) == FizeauProfileId_Invalid);
+
+    FZ_CHECK(table.insert(program_id(1), FizeauProfileId_Profile3));
+    FZ_CHECK(table.find(program_id(1)) == FizeauProfileId_Profile3);
+    FZ_CHECK(table.size() == 1);
+
+    // Inserting again replaces the profile
+    FZ_CHECK(table.insert(program_id(1), FizeauProfileId_Profile2));
+    FZ_CHECK(table.find(program_id(1)) == FizeauProfileId_Profile2);
+    FZ_CHECK(table.size() == 1);
+
+    // Program id 0 marks empty slots
+    FZ_CHECK(!table.insert(0, FizeauProfileId_Profile1));
+    FZ_CHECK(table.find(0) == FizeauProfileId_Invalid);
+}
+
+FZ_TEST(app_table_capacity) {
+    fz::AppProfileTable table;
+    for (std::size_t i = 0; i < FIZEAU_MAX_APP_RULES; ++i)
+        FZ_CHECK(table.insert(program_id(i + 1), profile_of(i)));
+
+    FZ_CHECK(table.size() == FIZEAU_MAX_APP_RULES);
+    FZ_CHECK(!table.insert(program_id(FIZEAU_MAX_APP_RULES + 1), FizeauProfileId_Profile1));
+
+    // Existing rules can still be updated when full
+    FZ_CHECK(table.insert(program_id(1), FizeauProfileId_Profile4));
+    FZ_CHECK(table.find(program_id(1)) == FizeauProfileId_Profile4);
+
+    for (std::size_t i = 1; i < FIZEAU_MAX_APP_RULES; ++i)
+        FZ_CHECK(table.find(program_id(i + 1)) == profile_of(i));
+}
+
+FZ_TEST(app_table_erase) {
+    // Erasing in every order keeps the remaining entries reachable through the shifted probe sequences
+    for (std::size_t stride: { 1, 3, 7, 13 }) {
+        fz::AppProfileTable table;
+        for (std::size_t i = 0; i < FIZEAU_MAX_APP_RULES; ++i)
+            table.insert(program_id(i + 1), profile_of(i));
+
+        std::vector<bool> erased(FIZEAU_MAX_APP_RULES, false);
+        for (std::size_t n = 0, i = 0; n < FIZEAU_MAX_APP_RULES; ++n, i = (i + stride) % FIZEAU_MAX_APP_RULES) {
+            while (erased[i])
+                i = (i + 1) % FIZEAU_MAX_APP_RULES;
+
+            table.erase(program_id(i + 1));
+            erased[i] = true;
+
+            FZ_CHECK(table.size() == FIZEAU_MAX_APP_RULES - n - 1);
+            for (std::size_t j = 0; j < FIZEAU_MAX_APP_RULES; ++j)
+                FZ_CHECK(table.find(program_id(j + 1)) == (erased[j] ? FizeauProfileId_Invalid : profile_of(j)));
+        }
+    }
+
+    // Erasing a missing id changes nothing
+    fz::AppProfileTable table;
+    table.insert(program_id(1), FizeauProfileId_Profile1);
+    table.erase(program_id(2));
+    table.erase(0);
+    FZ_CHECK(table.size() == 1 && table.find(program_id(1)) == FizeauProfileId_Profile1);
+}
+
+FZ_TEST(app_table_profile_mask) {
+    fz::AppProfileTable table;
+    FZ_CHECK(table.profile_mask() == 0);
+
+    table.insert(program_id(1), FizeauProfileId_Profile2);
+    table.insert(program_id(2), FizeauProfileId_Profile4);
+    table.insert(program_id(3), FizeauProfileId_Profile2);
+    FZ_CHECK(table.profile_mask() == (BIT(FizeauProfileId_Profile2) | BIT(FizeauProfileId_Profile4)));
+
+    table.erase(program_id(2));
+    FZ_CHECK(table.profile_mask() == BIT(FizeauProfileId_Profile2));
+
+    table.clear();
+    FZ_CHECK(table.size() == 0 && table.profile_mask() == 0 && table.find(program_id(1)) == FizeauProfileId_Invalid);
+}
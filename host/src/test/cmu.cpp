@@ -0,0 +1,169 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdint>
+#include <cstdlib>
+#include <array>
+
+#include <common.hpp>
+
+#include "test.hpp"
+
+namespace {
+
+fz::Cmu calculate(const FizeauSettings &settings, Component components = Component_All, Component filter = Component_None) {
+    fz::Cmu cmu;
+    fz::calculate_cmu(cmu, settings, components, filter);
+    return cmu;
+}
+
+// Grey ramp through a CMU, one pixel per level
+std::array<std::uint8_t, 3 * 256> grey_ramp(const fz::Cmu &cmu) {
+    std::array<std::uint8_t, 3 * 256> px;
+    for (std::size_t i = 0; i < 256; ++i)
+        px[3 * i + 0] = px[3 * i + 1] = px[3 * i + 2] = i;
+    fz::cmu::Model(cmu).apply(px.data(), px.data(), 256, 3);
+    return px;
+}
+
+} // namespace
+
+FZ_TEST(cmu_coefficient_and_lut2_index) {
+    FZ_CHECK(fz::cmu::coefficient(fz::QS18(1.0f))  ==  0x100);
+    FZ_CHECK(fz::cmu::coefficient(fz::QS18(-1.0f)) == -0x100);
+    FZ_CHECK(fz::cmu::coefficient(fz::QS18(0.5f))  ==  0x80);
+
+    // Fine steps below 0.125, coarse steps above, the last entry for full scale
+    FZ_CHECK(fz::cmu::lut2_index(0)     == 0);
+    FZ_CHECK(fz::cmu::lut2_index(511)   == 511);
+    FZ_CHECK(fz::cmu::lut2_index(512)   == 512);
+    FZ_CHECK(fz::cmu::lut2_index(519)   == 512);
+    FZ_CHECK(fz::cmu::lut2_index(520)   == 513);
+    FZ_CHECK(fz::cmu::lut2_index(0xfff) == std::tuple_size_v<decltype(fz::Cmu::lut_2)> - 1);
+}
+
+FZ_TEST(cmu_default_is_identity) {
+    auto cmu = calculate(fz::Config::default_settings);
+    FZ_CHECK(fz::cmu::is_identity(cmu));
+
+    auto px = grey_ramp(cmu);
+    for (int i = 0; i < 256; ++i)
+        FZ_CHECK(std::abs(px[3 * i] - i) <= 1 && px[3 * i] == px[3 * i + 1] && px[3 * i] == px[3 * i + 2]);
+}
+
+FZ_TEST(cmu_disabled_passes_through) {
+    fz::Cmu cmu(false, 0.5f, 0.5f, 0.5f);
+    FZ_CHECK(fz::cmu::is_identity(cmu));
+
+    std::array<std::uint8_t, 4 * 7> src, dst;
+    for (std::size_t i = 0; i < src.size(); ++i)
+        src[i] = 37 * i;
+    fz::cmu::Model(cmu).apply(src.data(), dst.data(), src.size() / 4, 4);
+    FZ_CHECK(src == dst);
+}
+
+FZ_TEST(cmu_keeps_alpha) {
+    auto settings = fz::Config::default_settings;
+    settings.temperature = 3000;
+    auto cmu = calculate(settings);
+
+    std::array<std::uint8_t, 4 * 9> px;
+    for (std::size_t i = 0; i < px.size(); ++i)
+        px[i] = 29 * i;
+    auto src = px;
+    fz::cmu::Model(cmu).apply(px.data(), px.data(), px.size() / 4, 4);
+    for (std::size_t i = 3; i < px.size(); i += 4)
+        FZ_CHECK(px[i] == src[i]);
+}
+
+FZ_TEST(cmu_csc_saturates) {
+    // Outputs of the matrix are clamped to the 12-bit range before the LUT2, in both directions
+    auto cmu = calculate(fz::Config::default_settings);
+    cmu.krr = 1.99f, cmu.kgg = 1.0f, cmu.kbb = -1.0f;
+
+    std::array<std::uint8_t, 3> px = { 200, 200, 200 };
+    fz::cmu::Model(cmu).apply(px.data(), px.data(), 1, 3);
+    FZ_CHECK(px[0] == 255);
+    FZ_CHECK(std::abs(px[1] - 200) <= 1);
+    FZ_CHECK(px[2] == 0);
+}
+
+FZ_TEST(cmu_components_and_filter) {
+    auto settings = fz::Config::default_settings;
+    settings.temperature = 3000;
+
+    // Disabled components are left uncorrected
+    std::array<std::uint8_t, 3> all = { 255, 255, 255 }, red = all;
+    fz::cmu::Model(calculate(settings)).apply(all.data(), all.data(), 1, 3);
+    fz::cmu::Model(calculate(settings, Component_Red)).apply(red.data(), red.data(), 1, 3);
+    FZ_CHECK(red[0] == all[0] && all[2] < 250);
+    FZ_CHECK(std::abs(red[1] - 255) <= 1 && std::abs(red[2] - 255) <= 1);
+
+    // A filter renders the luma of the input on its component only
+    auto cmu = calculate(fz::Config::default_settings, Component_All, Component_Green);
+    std::array<std::uint8_t, 6> px = { 255, 255, 255, 0, 0, 255 };
+    fz::cmu::Model(cmu).apply(px.data(), px.data(), 2, 3);
+    FZ_CHECK(px[0] == 0 && std::abs(px[1] - 255) <= 1 && px[2] == 0);
+    FZ_CHECK(px[3] == 0 && px[4] > 0 && px[4] < 128 && px[5] == 0);
+}
+
+FZ_TEST(cmu_range_and_luminance) {
+    auto settings = fz::Config::default_settings;
+    settings.range = DEFAULT_LIMITED_RANGE;
+    auto px = grey_ramp(calculate(settings));
+    FZ_CHECK(std::abs(px[0] - 16) <= 1 && std::abs(px[3 * 255] - 235) <= 1);
+
+    // Darker and brighter luminances scale the ramp, it stays monotonic
+    for (auto luminance: { -0.5f, 0.5f }) {
+        settings = fz::Config::default_settings;
+        settings.luminance = luminance;
+        auto ramp = grey_ramp(calculate(settings)), reference = grey_ramp(calculate(fz::Config::default_settings));
+        for (int i = 1; i < 256; ++i) {
+            FZ_CHECK(ramp[3 * i] >= ramp[3 * (i - 1)]);
+            FZ_CHECK(luminance < 0 ? ramp[3 * i] <= reference[3 * i] : ramp[3 * i] >= reference[3 * i]);
+        }
+    }
+}
+
+FZ_TEST(cmu_model_golden) {
+    // Outputs of the model recorded for a few settings, any change to calculate_cmu or to the model shows here.
+    // The preview shader mirrors the model, and is expected to produce the same values
+    auto night = fz::Config::default_settings;
+    night.temperature = 2700, night.luminance = -0.2f, night.range = DEFAULT_LIMITED_RANGE;
+    auto vivid = fz::Config::default_settings;
+    vivid.saturation = 1.5f, vivid.hue = 0.15f, vivid.contrast = 1.3f, vivid.gamma = 2.0f;
+    auto filtered = fz::Config::default_settings;
+    filtered.temperature = 5000;
+
+    constexpr std::array<std::uint8_t, 18> src = { 0, 0, 0, 255, 255, 255, 128, 128, 128, 255, 0, 0, 20, 200, 90, 250, 120, 5 };
+
+    struct {
+        fz::Cmu cmu;
+        std::array<std::uint8_t, src.size()> expected;
+    } goldens[] = {
+        { calculate(night),                                  { 13, 13, 13, 163, 111, 64,  88,  61,  36, 163,  13, 13, 25,  89,  28, 160,  58, 13 } },
+        { calculate(vivid),                                  {  0,  0,  0, 251, 251, 251, 107, 107, 107, 251, 116, 0,  0, 191, 106, 251, 162,  0 } },
+        { calculate(filtered, Component_All, Component_Red), {  0,  0,  0, 232,   0,   0, 116,   0,   0, 126,   0, 0, 154,   0,   0, 150,   0,  0 } },
+    };
+
+    for (auto &g: goldens) {
+        auto out = src;
+        fz::cmu::Model(g.cmu).apply(out.data(), out.data(), out.size() / 3, 3);
+        FZ_CHECK(out == g.expected);
+    }
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <common.hpp>
+
+#include "test.hpp"
+
+// Concurrent edits, with the in-process service client (src/fizeau.cpp) standing in for the sysmodule
+
+namespace {
+
+// Write made by another client (the overlay) between the reads and writes of the config
+template <typename F>
+void write_elsewhere(FizeauProfileId id, F &&edit) {
+    FizeauProfile profile;
+    fizeauGetProfile(id, &profile);
+    edit(profile);
+    fizeauSetProfile(id, &profile);
+}
+
+FizeauProfile stored(FizeauProfileId id) {
+    FizeauProfile profile;
+    fizeauGetProfile(id, &profile);
+    return profile;
+}
+
+} // namespace
+
+FZ_TEST(config_apply_merges_conflict) {
+    fz::Config config;
+    FZ_CHECK(R_SUCCEEDED(config.open_profile(FizeauProfileId_Profile3)));
+
+    config.profile.day_settings.temperature = 4000;
+    config.profile.night_settings.luminance = -0.2f;
+
+    write_elsewhere(FizeauProfileId_Profile3, [](FizeauProfile &p) {
+        p.night_settings.gamma     = 2.6f;
+        p.night_settings.luminance = 0.3f;
+        p.dusk_begin               = { 19, 30, 0 };
+    });
+
+    FZ_CHECK(R_SUCCEEDED(config.apply()));
+
+    // Fields edited on one side only are kept, ours win those edited on both
+    auto profile = stored(FizeauProfileId_Profile3);
+    FZ_CHECK(profile.day_settings.temperature == 4000);
+    FZ_CHECK(profile.night_settings.gamma == 2.6f);
+    FZ_CHECK(profile.night_settings.luminance == -0.2f);
+    FZ_CHECK(to_timestamp(profile.dusk_begin) == to_timestamp({ 19, 30, 0 }));
+
+    // The config shows what was written, and the next write does not conflict
+    FZ_CHECK(config.profile.night_settings.gamma == 2.6f);
+    config.profile.day_settings.hue = 0.5f;
+    FZ_CHECK(R_SUCCEEDED(config.apply()));
+    FZ_CHECK(stored(FizeauProfileId_Profile3).day_settings.hue == 0.5f);
+}
+
+FZ_TEST(config_apply_keeps_other_keyframes) {
+    fz::Config config;
+    FZ_CHECK(R_SUCCEEDED(config.open_profile(FizeauProfileId_Profile2)));
+    config.profile.day_settings.saturation = 1.5f;
+
+    FizeauKeyframe keyframe = { .time = { 6, 0, 0 }, .easing = Easing_Smoothstep, .settings = fz::Config::default_settings };
+    for (std::uint32_t i = 0; i < 2; ++i, keyframe.time.h += 12)
+        fizeauStageKeyframe(FizeauProfileId_Profile2, i, &keyframe);
+    write_elsewhere(FizeauProfileId_Profile2, [](FizeauProfile &p) { p.num_keyframes = 2; });
+
+    FZ_CHECK(R_SUCCEEDED(config.apply()));
+
+    auto profile = stored(FizeauProfileId_Profile2);
+    FZ_CHECK(profile.num_keyframes == 2);
+    FZ_CHECK(profile.day_settings.saturation == 1.5f);
+    FZ_CHECK(config.keyframes[1].time.h == 18);
+}
+
+FZ_TEST(config_reset_reapplies_on_conflict) {
+    fz::Config config;
+    FZ_CHECK(R_SUCCEEDED(config.open_profile(FizeauProfileId_Profile4)));
+
+    write_elsewhere(FizeauProfileId_Profile4, [](FizeauProfile &p) {
+        p.day_settings.gamma = 1.8f;
+        p.filter             = Component_Red;
+        p.dimming_timeout    = { 0, 5, 0 };
+    });
+
+    FZ_CHECK(R_SUCCEEDED(config.reset()));
+
+    // The reset settings are written over those of the other client, the rest of its edits is kept
+    auto profile = stored(FizeauProfileId_Profile4);
+    FZ_CHECK(profile.day_settings.gamma == DEFAULT_GAMMA);
+    FZ_CHECK(profile.filter == Component_None);
+    FZ_CHECK(to_timestamp(profile.dimming_timeout) == to_timestamp({ 0, 5, 0 }));
+}
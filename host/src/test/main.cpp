@@ -0,0 +1,80 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <vector>
+
+#include "test.hpp"
+
+// Unit tests of the sysmodule and application logic that builds on the host: timeline evaluation,
+// the application profile table, the CMU model, the frame scheduler and the merge of concurrent config edits.
+// Arguments filter the cases by name
+
+namespace fz::test {
+
+namespace {
+
+std::vector<Case> &cases() {
+    static std::vector<Case> cases;
+    return cases;
+}
+
+int failed_checks = 0;
+
+} // namespace
+
+Registrar::Registrar(const char *name, void (*func)()) {
+    cases().push_back({ name, func });
+}
+
+void fail(const char *file, int line, const char *expr) {
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expr);
+    ++failed_checks;
+}
+
+} // namespace fz::test
+
+int main(int argc, char **argv) {
+    bool verbose = false;
+    std::vector<const char *> filters;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "-v"))
+            verbose = true;
+        else
+            filters.push_back(argv[i]);
+    }
+
+    int num_run = 0, num_failed = 0;
+    for (auto &c: fz::test::cases()) {
+        if (!filters.empty() && std::none_of(filters.begin(), filters.end(), [&c](auto *f) { return std::strstr(c.name, f); }))
+            continue;
+
+        auto prev_failed = fz::test::failed_checks;
+        c.func();
+        bool ok = fz::test::failed_checks == prev_failed;
+
+        ++num_run, num_failed += !ok;
+        if (verbose || !ok)
+            std::printf("%-40s %s\n", c.name, ok ? "ok" : "FAILED");
+    }
+
+    std::printf("%d tests, %d failed\n", num_run, num_failed);
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdint>
+
+#include "scheduler.hpp"
+
+#include "test.hpp"
+
+namespace {
+
+// Frames drawn over a number of idle polls
+std::uint32_t idle_frames(fz::FrameScheduler &scheduler, std::uint32_t polls) {
+    std::uint32_t frames = 0;
+    for (std::uint32_t i = 0; i < polls; ++i)
+        frames += scheduler.update({ .input = false, .changed = false });
+    return frames;
+}
+
+} // namespace
+
+FZ_TEST(scheduler_draws_startup_then_idles) {
+    fz::FrameScheduler scheduler;
+    FZ_CHECK(idle_frames(scheduler, 100) == fz::FrameScheduler::SettleFrames);
+    FZ_CHECK(idle_frames(scheduler, 100) == 0);
+}
+
+FZ_TEST(scheduler_settles_after_input) {
+    fz::FrameScheduler scheduler;
+    idle_frames(scheduler, 100);
+
+    FZ_CHECK(scheduler.update({ .input = true, .changed = false }));
+    FZ_CHECK(idle_frames(scheduler, 100) == fz::FrameScheduler::SettleFrames - 1);
+}
+
+FZ_TEST(scheduler_change_draws_once) {
+    fz::FrameScheduler scheduler;
+    idle_frames(scheduler, 100);
+
+    FZ_CHECK(scheduler.update({ .input = false, .changed = true }));
+    FZ_CHECK(idle_frames(scheduler, 100) == 0);
+
+    // A change during the settling frames does not extend them
+    scheduler.update({ .input = true, .changed = false });
+    FZ_CHECK(scheduler.update({ .input = false, .changed = true }));
+    FZ_CHECK(idle_frames(scheduler, 100) == fz::FrameScheduler::SettleFrames - 2);
+}
+
+FZ_TEST(scheduler_invalidate_and_always_on) {
+    fz::FrameScheduler scheduler;
+    idle_frames(scheduler, 100);
+
+    scheduler.invalidate(3);
+    FZ_CHECK(idle_frames(scheduler, 100) == 3);
+
+    scheduler.on_demand = false;
+    FZ_CHECK(idle_frames(scheduler, 100) == 100);
+}
@@ -0,0 +1,44 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#pragma once
+
+// Minimal unit test registry: cases register themselves at static initialization, the runner in main.cpp
+// calls them in turn. Failed checks are reported with their location and do not stop the case
+
+namespace fz::test {
+
+struct Case {
+    const char *name;
+    void (*func)();
+};
+
+struct Registrar {
+    Registrar(const char *name, void (*func)());
+};
+
+void fail(const char *file, int line, const char *expr);
+
+} // namespace fz::test
+
+#define FZ_TEST(name)                                                         \
+    static void test_##name();                                                \
+    static fz::test::Registrar registrar_##name(#name, test_##name);          \
+    static void test_##name()
+
+#define FZ_CHECK(expr) ((expr) ? (void)0 : fz::test::fail(__FILE__, __LINE__, #expr))
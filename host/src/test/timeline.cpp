@@ -0,0 +1,190 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <array>
+#include <utility>
+
+#include <common.hpp>
+
+#include "test.hpp"
+
+namespace {
+
+constexpr Timestamp hms(int h, int m, int s = 0) {
+    return 60 * 60 * h + 60 * m + s;
+}
+
+bool near(const FizeauSettings &a, const FizeauSettings &b) {
+    auto close = [](float x, float y) { return std::abs(x - y) <= 1e-3f * std::max(1.0f, std::abs(y)); };
+    return std::abs(static_cast<int>(a.temperature) - static_cast<int>(b.temperature)) <= 1 &&
+        close(a.saturation, b.saturation) && close(a.hue, b.hue) && close(a.contrast, b.contrast) &&
+        close(a.gamma, b.gamma) && close(a.luminance, b.luminance) &&
+        close(a.range.lo, b.range.lo) && close(a.range.hi, b.range.hi);
+}
+
+FizeauProfile day_night_profile() {
+    FizeauProfile p = {
+        .day_settings   = fz::Config::default_settings,
+        .night_settings = fz::Config::default_settings,
+        .components     = Component_All,
+        .filter         = Component_None,
+        .dusk_begin     = { 20, 0, 0 },
+        .dusk_end       = { 21, 0, 0 },
+        .dawn_begin     = {  6, 0, 0 },
+        .dawn_end       = {  7, 0, 0 },
+    };
+    p.night_settings.temperature = 3000;
+    p.night_settings.luminance   = -0.2f;
+    p.night_settings.range       = DEFAULT_LIMITED_RANGE;
+    return p;
+}
+
+FizeauKeyframe keyframe(Time time, Temperature temperature, Easing easing = Easing_Linear) {
+    FizeauKeyframe k = { .time = time, .easing = easing, .settings = fz::Config::default_settings };
+    k.settings.temperature = temperature;
+    return k;
+}
+
+} // namespace
+
+FZ_TEST(timeline_matches_evaluate_profile) {
+    auto profile = day_night_profile();
+    fz::Timeline timeline;
+    timeline.compile(profile, {});
+
+    for (Timestamp ts = 0; ts < hms(24, 0); ts += 30) {
+        bool is_night;
+        auto expected = fz::evaluate_profile(profile, ts, is_night);
+        auto segment  = timeline.find(ts);
+        FZ_CHECK(near(timeline.evaluate(ts, segment), expected));
+        FZ_CHECK(timeline.is_night(segment) == is_night);
+    }
+}
+
+FZ_TEST(timeline_holds_day_and_night) {
+    auto profile = day_night_profile();
+    fz::Timeline timeline;
+    timeline.compile(profile, {});
+
+    FZ_CHECK(!timeline.is_transition(timeline.find(hms(12, 0))));
+    FZ_CHECK(!timeline.is_transition(timeline.find(hms( 0, 0))));
+    FZ_CHECK( timeline.is_transition(timeline.find(hms(20, 30))));
+    FZ_CHECK( timeline.is_transition(timeline.find(hms( 6, 30))));
+
+    FZ_CHECK(timeline.evaluate(hms(12, 0)).temperature == profile.day_settings.temperature);
+    FZ_CHECK(timeline.evaluate(hms( 3, 0)).temperature == profile.night_settings.temperature);
+    FZ_CHECK(near(timeline.evaluate(hms(20, 30)), fz::interpolate_profile(profile, 0.5f, false)));
+}
+
+FZ_TEST(timeline_dusk_across_midnight) {
+    // Unlike evaluate_profile, which holds the night settings past midnight, the timeline wraps the period
+    auto profile = day_night_profile();
+    profile.dusk_begin = { 23, 30, 0 }, profile.dusk_end = { 0, 30, 0 };
+    fz::Timeline timeline;
+    timeline.compile(profile, {});
+
+    for (auto [ts, factor]: { std::pair{ hms(23, 30), 1.0f }, { hms(23, 45), 0.75f }, { hms(0, 0), 0.5f }, { hms(0, 15), 0.25f } }) {
+        FZ_CHECK(near(timeline.evaluate(ts), fz::interpolate_profile(profile, factor, false)));
+        FZ_CHECK(timeline.is_transition(timeline.find(ts)) && timeline.is_night(timeline.find(ts)));
+    }
+
+    FZ_CHECK(near(timeline.evaluate(hms(23, 29)), profile.day_settings));
+    FZ_CHECK(near(timeline.evaluate(hms( 0, 30)), profile.night_settings));
+}
+
+FZ_TEST(timeline_keyframes) {
+    auto profile = day_night_profile();
+    std::array keyframes = { keyframe({ 20, 0, 0 }, 3000), keyframe({ 8, 0, 0 }, 6500) };
+    profile.num_keyframes = keyframes.size();
+
+    fz::Timeline timeline;
+    timeline.compile(profile, keyframes);
+
+    // Keyframes are sorted, and the last one interpolates to the first across midnight
+    FZ_CHECK(timeline.evaluate(hms( 8, 0)).temperature == 6500);
+    FZ_CHECK(timeline.evaluate(hms(14, 0)).temperature == 4750);
+    FZ_CHECK(timeline.evaluate(hms(20, 0)).temperature == 3000);
+    FZ_CHECK(timeline.evaluate(hms( 2, 0)).temperature == 4750);
+    FZ_CHECK(timeline.is_transition(timeline.find(hms(2, 0))));
+    FZ_CHECK(!timeline.is_night(timeline.find(hms(2, 0))));
+}
+
+FZ_TEST(timeline_keyframe_easings) {
+    auto profile = day_night_profile();
+    for (auto easing: { Easing_Linear, Easing_Smoothstep, Easing_Exponential }) {
+        std::array keyframes = { keyframe({ 10, 0, 0 }, 6000, easing), keyframe({ 11, 0, 0 }, 3000) };
+        profile.num_keyframes = keyframes.size();
+
+        fz::Timeline timeline;
+        timeline.compile(profile, keyframes);
+
+        // Every easing starts and ends on the keyframes, and is monotonic in between
+        FZ_CHECK(timeline.evaluate(hms(10, 0)).temperature == 6000);
+        FZ_CHECK(timeline.evaluate(hms(11, 0)).temperature == 3000);
+
+        auto prev = timeline.evaluate(hms(10, 0)).temperature;
+        for (auto ts = hms(10, 0); ts <= hms(11, 0); ts += 60) {
+            auto temperature = timeline.evaluate(ts).temperature;
+            FZ_CHECK(temperature <= prev);
+            prev = temperature;
+        }
+
+        auto mid = timeline.evaluate(hms(10, 30)).temperature;
+        if (easing == Easing_Smoothstep)
+            FZ_CHECK(mid == 4500);
+        else if (easing == Easing_Exponential)
+            FZ_CHECK(mid > 4500); // Slow start
+    }
+}
+
+FZ_TEST(timeline_keyframe_steps) {
+    auto profile = day_night_profile();
+
+    // Keyframes at the same time step from the first to the second
+    std::array keyframes = { keyframe({ 12, 0, 0 }, 6500), keyframe({ 18, 0, 0 }, 6500), keyframe({ 18, 0, 0 }, 3000) };
+    profile.num_keyframes = keyframes.size();
+
+    fz::Timeline timeline;
+    timeline.compile(profile, keyframes);
+    FZ_CHECK(timeline.evaluate(hms(17, 59, 59)).temperature == 6500);
+    FZ_CHECK(timeline.evaluate(hms(18,  0,  0)).temperature == 3000);
+
+    // A single keyframe is held all day
+    profile.num_keyframes = 1;
+    timeline.compile(profile, std::span(keyframes).first(1));
+    for (auto ts: { hms(0, 0), hms(12, 0), hms(23, 59) }) {
+        FZ_CHECK(timeline.evaluate(ts).temperature == 6500);
+        FZ_CHECK(!timeline.is_transition(timeline.find(ts)));
+    }
+}
+
+FZ_TEST(timeline_empty_periods) {
+    // Every period empty is treated as night, like evaluate_profile
+    auto profile = day_night_profile();
+    profile.dusk_begin = profile.dusk_end = profile.dawn_begin = profile.dawn_end = { 0, 0, 0 };
+
+    fz::Timeline timeline;
+    timeline.compile(profile, {});
+    for (auto ts: { hms(0, 0), hms(12, 0) }) {
+        bool is_night;
+        auto expected = fz::evaluate_profile(profile, ts, is_night);
+        FZ_CHECK(near(timeline.evaluate(ts), expected));
+        FZ_CHECK(timeline.is_night(timeline.find(ts)) == is_night);
+    }
+}
@@ -33,6 +33,13 @@ namespace ImGui::nx {
 
 bool init();
 void exit();
-std::uint64_t newFrame();
+
+// Reads touch and gamepad state without feeding it to ImGui, returns the buttons pressed since the last poll
+std::uint64_t poll();
+// Whether the last poll saw any touch, button or stick input, or a display mode change
+bool hadInput();
+
+// Feeds the state of the last poll to ImGui, before ImGui::NewFrame. Only called for frames that are drawn
+void newFrame();
 
 } // namespace ImGui::nx
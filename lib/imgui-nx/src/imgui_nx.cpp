@@ -28,6 +28,7 @@
 #include "imgui_nx.h"
 #include <imgui.h>
 
+#include <cstdlib>
 #include <cstring>
 #include <algorithm>
 #include <array>
@@ -52,10 +53,17 @@ AppletHookCookie s_appletHookCookie;
 
 PadState s_pad;
 
+bool s_hadInput = false, s_modeChanged = false, s_touchDown = false;
+
+constexpr auto thumb_dead_zone = 10000;
+
 void handleAppletHook(AppletHookType type, void *param) {
     if (type != AppletHookType_OnOperationMode)
         return;
 
+    // display size and scale change, the ui needs to be redrawn
+    s_modeChanged = true;
+
     switch (appletGetOperationMode()) {
         default:
         case AppletOperationMode_Handheld:
@@ -74,18 +82,21 @@ void handleAppletHook(AppletHookType type, void *param) {
     }
 }
 
-void updateTouch(ImGuiIO &io_) {
+void pollTouch() {
     // read touch positions
     HidTouchScreenState state = {0};
     auto count = hidGetTouchScreenStates(&state, 1);
-    if (count < 1 || state.count < 1) {
-        io_.MouseDown[0] = false;
+    s_touchDown = count >= 1 && state.count >= 1;
+    if (!s_touchDown)
         return;
-    }
 
     // set mouse position to touch point
     s_mousePos = ImVec2(state.touches[0].x, state.touches[0].y);
-    io_.MouseDown[0] = true;
+    s_hadInput = true;
+}
+
+void updateTouch(ImGuiIO &io_) {
+    io_.MouseDown[0] = s_touchDown;
 }
 
 /// \brief Update gamepad inputs
@@ -112,8 +123,6 @@ void updateGamepads (ImGuiIO &io_)
         std::make_pair (HidNpadButton_Minus, ImGuiKey_GamepadBack),
     };
 
-    padUpdate (&s_pad);
-
     // read buttons from primary controller
     auto const keys = padGetButtons (&s_pad);
     for (auto const &[in, out] : buttonMapping)
@@ -121,7 +130,6 @@ void updateGamepads (ImGuiIO &io_)
 
     // update joystick
     auto const jsLeft = padGetStickPos (&s_pad, 0), jsRight = padGetStickPos (&s_pad, 1);
-    constexpr static auto thumb_dead_zone = 10000;
     const std::array analogMapping = {
         std::make_tuple (std::ref (jsLeft.x),  ImGuiKey_GamepadLStickLeft,  -thumb_dead_zone, JOYSTICK_MIN),
         std::make_tuple (std::ref (jsLeft.x),  ImGuiKey_GamepadLStickRight, +thumb_dead_zone, JOYSTICK_MAX),
@@ -141,6 +149,16 @@ void updateGamepads (ImGuiIO &io_)
     }
 }
 
+void pollGamepads() {
+    padUpdate(&s_pad);
+
+    // any button held, or a stick past the point where updateGamepads reports it as pressed
+    constexpr auto threshold = thumb_dead_zone + (JOYSTICK_MAX - thumb_dead_zone) / 10;
+    auto const jsLeft = padGetStickPos(&s_pad, 0), jsRight = padGetStickPos(&s_pad, 1);
+    s_hadInput |= padGetButtons(&s_pad) != 0 ||
+        std::max({ std::abs(jsLeft.x), std::abs(jsLeft.y), std::abs(jsRight.x), std::abs(jsRight.y) }) > threshold;
+}
+
 } // namespace
 
 bool ImGui::nx::init() {
@@ -199,7 +217,15 @@ bool ImGui::nx::init() {
     return true;
 }
 
-std::uint64_t ImGui::nx::newFrame() {
+std::uint64_t ImGui::nx::poll() {
+    s_hadInput = std::exchange(s_modeChanged, false);
+    pollTouch();
+    pollGamepads();
+
+    return padGetButtonsDown(&s_pad);
+}
+
+void ImGui::nx::newFrame() {
     auto &io = ImGui::GetIO();
 
     // setup display metrics
@@ -214,7 +240,7 @@ std::uint64_t ImGui::nx::newFrame() {
     io.DeltaTime = std::chrono::duration<float> (now - prev).count();
     prev         = now;
 
-    // update inputs
+    // update inputs, from the last poll
     updateTouch(io);
     updateGamepads(io);
 
@@ -222,8 +248,10 @@ std::uint64_t ImGui::nx::newFrame() {
     s_mousePos.x = std::clamp(s_mousePos.x, 0.0f, s_width);
     s_mousePos.y = std::clamp(s_mousePos.y, 0.0f, s_height);
     io.MousePos  = s_mousePos;
+}
 
-    return padGetButtonsDown(&s_pad);
+bool ImGui::nx::hadInput() {
+    return s_hadInput;
 }
 
 void ImGui::nx::exit() {
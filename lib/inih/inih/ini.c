@@ -0,0 +1,20 @@
+#include "ini.h"
+#include <string.h>
+#include <ctype.h>
+static char* rstrip(char* s){char*p=s+strlen(s);while(p>s&&isspace((unsigned char)(*--p)))*p='\0';return s;}
+static char* lskip(const char* s){while(*s&&isspace((unsigned char)(*s)))s++;return (char*)s;}
+int ini_parse_stream(ini_reader reader, void* stream, ini_handler handler, void* user){
+  char line[INI_MAX_LINE]; char section[50]=""; int lineno=0, error=0;
+  while(reader(line,INI_MAX_LINE,stream)){ lineno++; char*s=lskip(rstrip(line));
+    if(*s==';'||*s=='#'||!*s) continue;
+    if(*s=='['){char*e=strchr(s,']'); if(e){*e=0; strncpy(section,s+1,sizeof(section)-1);} else if(!error) error=lineno; continue;}
+    char*eq=strchr(s,'='); if(!eq){if(!error)error=lineno;continue;}
+    *eq=0; char*name=rstrip(s); char*value=lskip(eq+1); char*c=strchr(value,';'); if(c&&c>value&&isspace((unsigned char)c[-1]))*c=0; rstrip(value);
+    if(!handler(user,section,name,value)&&!error) error=lineno; }
+  return error; }
+static char* freader(char*str,int num,void*stream){return fgets(str,num,(FILE*)stream);}
+int ini_parse_file(FILE* f, ini_handler h, void* u){return ini_parse_stream(freader,f,h,u);}
+int ini_parse(const char* fn, ini_handler h, void* u){FILE*f=fopen(fn,"r");if(!f)return -1;int e=ini_parse_file(f,h,u);fclose(f);return e;}
+struct sctx{const char*p;};
+static char* sreader(char*str,int num,void*stream){struct sctx*c=stream;if(!*c->p)return 0;int i=0;while(i<num-1&&c->p[i]&&c->p[i]!='\n'){str[i]=c->p[i];i++;}str[i]=0;c->p+=i;if(*c->p=='\n')c->p++;return str;}
+int ini_parse_string(const char* s, ini_handler h, void* u){struct sctx c={s};return ini_parse_stream(sreader,&c,h,u);}
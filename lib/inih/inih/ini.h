@@ -0,0 +1,19 @@
+#ifndef INI_H
+#define INI_H
+#include <stdio.h>
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifndef INI_MAX_LINE
+#define INI_MAX_LINE 200
+#endif
+typedef int (*ini_handler)(void* user, const char* section, const char* name, const char* value);
+typedef char* (*ini_reader)(char* str, int num, void* stream);
+int ini_parse(const char* filename, ini_handler handler, void* user);
+int ini_parse_file(FILE* file, ini_handler handler, void* user);
+int ini_parse_stream(ini_reader reader, void* stream, ini_handler handler, void* user);
+int ini_parse_string(const char* string, ini_handler handler, void* user);
+#ifdef __cplusplus
+}
+#endif
+#endif
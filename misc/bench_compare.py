@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+
+import sys, json, argparse
+
+
+def load(path):
+    with open(path) as fp:
+        data = json.load(fp)
+    return data, { r["name"]: r for r in data["results"] }
+
+
+def main(argc, argv):
+    parser = argparse.ArgumentParser(description="Compare two fizeau-bench JSON reports (make host bench-report)")
+    parser.add_argument("base", help="reference report")
+    parser.add_argument("new",  help="report to compare against the reference")
+    parser.add_argument("-m", "--metric", default="median_ns", choices=["min_ns", "median_ns", "mean_ns"])
+    parser.add_argument("-t", "--threshold", type=float, default=5.0, help="relative change (%%) flagged as a regression")
+    args = parser.parse_args(argv[1:])
+
+    base_info, base = load(args.base)
+    new_info,  new  = load(args.new)
+    print(f"{args.base} ({base_info['opt']}, gcc {base_info['compiler']}) -> {args.new} ({new_info['opt']}, gcc {new_info['compiler']})")
+
+    regressions = 0
+    print(f"{'benchmark':<32} {'base (ns)':>12} {'new (ns)':>12} {'change':>9}")
+    for name, b in base.items():
+        if name not in new:
+            continue
+        old_val, new_val = b[args.metric], new[name][args.metric]
+        change = (new_val - old_val) / old_val * 100 if old_val else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag, regressions = " !", regressions + 1
+        print(f"{name:<32} {old_val:>12.1f} {new_val:>12.1f} {change:>+8.1f}%{flag}")
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(len(sys.argv), sys.argv))
@@ -0,0 +1,201 @@
+#!/usr/bin/env python3
+
+import sys, re, json, glob, argparse, subprocess
+
+
+# Reads the call graphs emitted by gcc -fcallgraph-info=su (one .ci file per object)
+def read_callgraph(paths):
+    node_re  = re.compile(r'node: \{ title: "([^"]+)" label: "([^"]*)"')
+    edge_re  = re.compile(r'edge: \{ sourcename: "([^"]+)" targetname: "([^"]+)"')
+    frame_re = re.compile(r'(\d+) bytes \(([a-z,]+)\)')
+
+    nodes, edges = {}, {}
+    for path in paths:
+        with open(path) as fp:
+            for line in fp:
+                if m := node_re.match(line):
+                    title, label = m.group(1), m.group(2).split("\\n")
+                    frame = frame_re.match(label[-1])
+                    # Functions are also listed as external nodes by the objects calling them, keep their definition
+                    if frame or title not in nodes:
+                        nodes[title] = {
+                            "name":    label[0],
+                            "frame":   int(frame.group(1)) if frame else None,
+                            "dynamic": bool(frame) and frame.group(2) == "dynamic",
+                        }
+                elif m := edge_re.match(line):
+                    edges.setdefault(m.group(1), set()).add(m.group(2))
+    return nodes, edges
+
+
+# Qualified name of a demangled signature, without return type nor parameters.
+# Lambdas are named after their enclosing function, whose parameters are nested in the name
+def function_name(sig):
+    name, depth = "", 0
+    for c in sig:
+        depth += (c == "(") - (c == ")")
+        if not depth and c != ")":
+            name += c
+    name = re.sub(r" \[with .*\]$", "", name)
+    return re.sub(r" (const|noexcept)$", "", name).split(" ")[-1].lstrip("*&")
+
+
+class StackAnalysis:
+    def __init__(self, nodes, edges):
+        self.nodes, self.edges = nodes, edges
+        self.by_name = {}
+        for title, node in nodes.items():
+            self.by_name.setdefault(function_name(node["name"]), []).append(title)
+        self.memo = {}
+
+    def find(self, name):
+        if titles := self.by_name.get(name):
+            return titles
+        raise KeyError(f"function {name} not found in the call graph")
+
+    def add_edge(self, caller, callee):
+        for c in self.find(caller):
+            self.edges.setdefault(c, set()).update(self.find(callee))
+
+    # Returns the deepest use below a function as (bytes, call chain, unaccounted callees).
+    # Recursion is cut where it is first entered
+    def worst(self, title, path=()):
+        if title in self.memo:
+            return self.memo[title]
+
+        # Local functions only referenced by their callers were inlined
+        node = self.nodes.get(title, { "name": title, "frame": 0 if ":" in title else None, "dynamic": False })
+        if title in path:
+            return 0, [], { f"{function_name(node['name'])} (recursive)" }
+        if node["frame"] is None:
+            return 0, [], { "indirect calls" if title == "__indirect_call" else function_name(node["name"]) }
+
+        depth, chain, unknown = 0, [], { f"{function_name(node['name'])} (dynamic frame)" } if node["dynamic"] else set()
+        for callee in sorted(self.edges.get(title, ())):
+            d, c, u = self.worst(callee, path + (title,))
+            unknown |= u
+            if d > depth:
+                depth, chain = d, c
+
+        self.memo[title] = res = node["frame"] + depth, [title] + chain, unknown
+        return res
+
+
+# nm -CSn output, one "address size type name" line per sized symbol
+def read_symbols(path):
+    symbol_re = re.compile(r"[0-9a-f]+ ([0-9a-f]+) (\w) (.+)")
+    symbols = []
+    with open(path) as fp:
+        for line in fp:
+            if m := symbol_re.match(line):
+                symbols.append((int(m.group(1), 16), m.group(2), m.group(3)))
+    return symbols
+
+
+# Sizes of the structures defined in the DWARF info of a binary, by qualified name
+def read_types(readelf, elf, names):
+    entry_re = re.compile(r"\s*<(\d+)><[0-9a-f]+>: Abbrev Number: \d+ \(DW_TAG_(\w+)\)")
+    attr_re  = re.compile(r"\s*<[0-9a-f]+>\s+DW_AT_(\w+)\s*: (?:\(indirect string, offset: 0x[0-9a-f]+\): )?(.*)")
+
+    out = subprocess.run([readelf, "--debug-dump=info", elf], capture_output=True, text=True, check=True).stdout
+    scopes, sizes, tag = [], {}, None
+    for line in out.splitlines():
+        if m := entry_re.match(line):
+            depth, tag = int(m.group(1)), m.group(2)
+            del scopes[depth:]
+            scopes += [None] * (depth + 1 - len(scopes))
+        elif (m := attr_re.match(line)) and tag in ("namespace", "structure_type", "class_type"):
+            if m.group(1) == "name":
+                scopes[-1] = m.group(2).strip()
+            elif m.group(1) == "byte_size":
+                name = "::".join(s for s in scopes if s)
+                if name in names:
+                    sizes[name] = int(m.group(2))
+    return sizes
+
+
+def resolve_size(token, symbols, npdm):
+    if re.fullmatch(r"0x[0-9a-fA-F]+|\d+", token):
+        return int(token, 0)
+    if token in npdm:
+        return int(npdm[token], 0)
+    for size, _, name in symbols:
+        if name.split("::")[-1] == token:
+            return size
+    raise KeyError(f"size {token} is neither a number, an npdm field nor a symbol")
+
+
+def print_sections(size_tool, elf):
+    out = subprocess.run([size_tool, "-A", elf], capture_output=True, text=True, check=True).stdout
+    sections = { f[0]: int(f[1]) for f in (l.split() for l in out.splitlines()) if len(f) == 3 and f[0].startswith(".") }
+    print(f"{'section':<22} {'size':>8}")
+    for name in (".text", ".rodata", ".data", ".bss"):
+        if name in sections:
+            print(f"{name:<22} {sections[name]:>8}")
+    print(f"{'total':<22} {sum(sections.get(n, 0) for n in ('.text', '.rodata', '.data', '.bss')):>8}")
+
+
+def print_symbols(symbols, count):
+    print(f"{'largest data':<50} {'size':>8}")
+    for size, _, name in sorted((s for s in symbols if s[1] in "bBdD"), reverse=True)[:count]:
+        print(f"{name[:50]:<50} {size:>8}")
+
+
+def print_types(names, sizes):
+    print(f"{'type':<50} {'size':>8}")
+    for name in names:
+        print(f"{name[:50]:<50} {sizes.get(name, 0):>8}")
+
+
+def main(argc, argv):
+    parser = argparse.ArgumentParser(description="Print the memory footprint of the sysmodule: section sizes, largest " +
+        "static objects and stack peaks from the call graph")
+    parser.add_argument("build", nargs="+", help="build directories holding the .ci files")
+    parser.add_argument("-s", "--stack", action="append", default=[], metavar="NAME=FUNCTION:SIZE",
+        help="thread stack, entered through FUNCTION. SIZE is a number, the name of the stack array or an npdm field")
+    parser.add_argument("-e", "--edge", action="append", default=[], metavar="CALLER=CALLEE",
+        help="indirect call to account for")
+    parser.add_argument("-l", "--lst", help="symbol list (nm -CSn)")
+    parser.add_argument("-n", "--npdm", help="npdm json, for the main thread stack size")
+    parser.add_argument("--elf", help="binary to print the section sizes of")
+    parser.add_argument("--size-tool", default="size", help="binutils size of the target")
+    parser.add_argument("-t", "--type", action="append", default=[], metavar="NAME",
+        help="structure to print the size of, from the debug info of the binary")
+    parser.add_argument("--readelf", default="readelf", help="binutils readelf of the target")
+    parser.add_argument("-v", "--verbose", action="store_true", help="print the deepest call chain of each stack")
+    args = parser.parse_args(argv[1:])
+
+    symbols = read_symbols(args.lst) if args.lst else []
+    npdm = json.load(open(args.npdm)) if args.npdm else {}
+
+    if args.elf:
+        print_sections(args.size_tool, args.elf)
+    if symbols:
+        print_symbols(symbols, 8)
+    if args.elf and args.type:
+        print_types(args.type, read_types(args.readelf, args.elf, set(args.type)))
+
+    analysis = StackAnalysis(*read_callgraph(p for b in args.build for p in glob.glob(f"{b}/**/*.ci", recursive=True)))
+    for edge in args.edge:
+        analysis.add_edge(*edge.split("="))
+
+    # Frames of unlisted callees (libnx, libc) and indirect calls are not counted, hence the margin
+    print(f"{'stack':<22} {'size':>8} {'peak':>8} {'free':>8}  not counted")
+    for stack in args.stack:
+        name, rest = stack.split("=")
+        function, size = rest.rsplit(":", 1)
+        size = resolve_size(size, symbols, npdm)
+
+        peak, chain, unknown = max((analysis.worst(t) for t in analysis.find(function)), key=lambda r: r[0])
+        flagged = sorted(u for u in unknown if u.endswith(")") or u == "indirect calls")
+        print(f"{name:<22} {size:>#8x} {peak:>8} {size - peak:>8}  " +
+            ", ".join([f"{len(unknown) - len(flagged)} external functions"] + flagged))
+        if args.verbose:
+            for title in chain:
+                print(f"{'':<24}{analysis.nodes[title]['frame']:>6}  {function_name(analysis.nodes[title]['name'])}")
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(len(sys.argv), sys.argv))
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+
+import sys, json, argparse
+from ctypes import Structure as struct, c_uint16 as uint16_t, c_uint32 as uint32_t, c_uint64 as uint64_t
+
+
+# Keep in sync with fz::trace::Event in sysmodule/src/trace.hpp
+EVENTS = [
+    "None",
+    "Apply",
+    "CalculateCmu",
+    "IoctlSetCmu",
+    "IoctlGetAviInfoframe",
+    "IoctlSetAviInfoframe",
+    "MmioScan",
+    "TransitionWakeup",
+    "OperationModeChange",
+    "Activity",
+    "IpcDispatch",
+    "ApplicationChange",
+    "AmbientChange",
+    "CscStage",
+    "LutMismatch",
+    "ServiceReady",
+    "FirstCommit",
+]
+
+# Keep in sync with fz::trace::Stack
+STACKS = [
+    "main",
+    "boot",
+    "transition",
+    "event monitor",
+]
+
+MAGIC   = 0x52545a46
+VERSION = 2
+
+
+class StackUsage(struct):
+    _fields_ = [
+        ("size", uint32_t),
+        ("peak", uint32_t),
+    ]
+
+
+class DumpHeader(struct):
+    _fields_ = [
+        ("magic",       uint32_t),
+        ("version",     uint16_t),
+        ("entry_size",  uint16_t),
+        ("tick_freq",   uint64_t),
+        ("num_entries", uint32_t),
+        ("head",        uint32_t),
+        ("stacks",      StackUsage * len(STACKS)),
+    ]
+
+
+class Entry(struct):
+    _fields_ = [
+        ("tick",     uint64_t),
+        ("duration", uint32_t),
+        ("id",       uint16_t),
+        ("arg",      uint16_t),
+    ]
+
+
+def event_name(id):
+    return EVENTS[id] if id < len(EVENTS) else f"Unknown{id}"
+
+
+def read_dump(path):
+    with open(path, "rb") as fp:
+        hdr = DumpHeader()
+        fp.readinto(hdr)
+        if hdr.magic != MAGIC or hdr.version != VERSION:
+            raise ValueError(f"{path}: invalid trace dump (magic {hdr.magic:#x}, version {hdr.version})")
+
+        entries = (Entry * hdr.num_entries)()
+        fp.readinto(entries)
+
+    # Unroll the ring, oldest entry first
+    count = min(hdr.head, hdr.num_entries)
+    start = hdr.head - count
+    res = [entries[i % hdr.num_entries] for i in range(start, hdr.head)]
+    return hdr, [e for e in res if e.id != 0]
+
+
+def percentile(values, p):
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def print_timeline(hdr, entries):
+    to_us = lambda t: t * 1e6 / hdr.tick_freq
+    base = min((e.tick for e in entries), default=0)
+    for e in sorted(entries, key=lambda e: e.tick):
+        print(f"{to_us(e.tick - base) / 1000:12.3f}ms  {event_name(e.id):<22} arg={e.arg:<5}" +
+            (f" {to_us(e.duration):10.1f}us" if e.duration else ""))
+
+
+def print_stats(hdr, entries):
+    to_us = lambda t: t * 1e6 / hdr.tick_freq
+    by_event = {}
+    for e in entries:
+        by_event.setdefault(e.id, []).append(to_us(e.duration))
+
+    print(f"{'event':<22} {'count':>6} {'mean':>10} {'p50':>10} {'p99':>10} {'max':>10}  (us)")
+    for id, durations in sorted(by_event.items()):
+        durations.sort()
+        print(f"{event_name(id):<22} {len(durations):>6} {sum(durations) / len(durations):>10.1f} " +
+            f"{percentile(durations, 50):>10.1f} {percentile(durations, 99):>10.1f} {durations[-1]:>10.1f}")
+
+
+def print_stacks(hdr):
+    print(f"{'stack':<22} {'size':>8} {'peak':>8} {'used':>6}")
+    for name, s in zip(STACKS, hdr.stacks):
+        if s.size:
+            print(f"{name:<22} {s.size:>#8x} {s.peak:>8} {s.peak * 100 / s.size:>5.0f}%")
+
+
+def write_chrome_trace(hdr, entries, path):
+    # Viewable in chrome://tracing or https://ui.perfetto.dev
+    to_us = lambda t: t * 1e6 / hdr.tick_freq
+    events = [{
+        "name": event_name(e.id),
+        "ph":   "X" if e.duration else "i",
+        "ts":   to_us(e.tick),
+        "dur":  to_us(e.duration),
+        "pid":  0,
+        "tid":  0,
+        "args": { "arg": e.arg },
+    } for e in entries]
+
+    with open(path, "w") as fp:
+        json.dump({ "traceEvents": events, "displayTimeUnit": "ms" }, fp)
+
+
+def main(argc, argv):
+    parser = argparse.ArgumentParser(description="Decode a Fizeau sysmodule trace dump")
+    parser.add_argument("dump", help="trace.bin file, found at /config/Fizeau/trace.bin after calling fizeauDumpTrace")
+    parser.add_argument("-t", "--timeline", action="store_true", help="print every event in chronological order")
+    parser.add_argument("-c", "--chrome", metavar="OUT", help="write a chrome trace event file")
+    args = parser.parse_args(argv[1:])
+
+    hdr, entries = read_dump(args.dump)
+    print(f"{len(entries)} events, tick frequency {hdr.tick_freq}Hz")
+
+    if args.timeline:
+        print_timeline(hdr, entries)
+
+    print_stats(hdr, entries)
+    print_stacks(hdr)
+
+    if args.chrome:
+        write_chrome_trace(hdr, entries, args.chrome)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(len(sys.argv), sys.argv))
@@ -32,6 +32,9 @@ bool is_full(const ColorRange &range) {
     return (range.lo == MIN_RANGE) && (range.hi == MAX_RANGE);
 }
 
+// Kept across openings of the overlay
+bool is_live = false;
+
 } // namespace
 
 tsl::elm::Element *ErrorGui::createUI() {
@@ -40,6 +43,11 @@ tsl::elm::Element *ErrorGui::createUI() {
     auto *drawer = new tsl::elm::CustomDrawer([this](tsl::gfx::Renderer *renderer, s32 x, s32 y, s32 w, s32 h) {
         renderer->drawString(format("%#x (%04d-%04d)", this->rc, R_MODULE(this->rc) + 2000, R_DESCRIPTION(this->rc)).c_str(),
                                                                      false, x, y +  50, 20, renderer->a(0xffff));
+        if (this->rc == FIZEAU_MAKERESULT(BUSY)) {
+            renderer->drawString("The sysmodule is starting",        false, x, y +  80, 20, renderer->a(0xffff));
+            renderer->drawString("Try again in a few seconds.",      false, x, y + 110, 20, renderer->a(0xffff));
+            return;
+        }
         renderer->drawString("An error occurred",                    false, x, y +  80, 20, renderer->a(0xffff));
         renderer->drawString("Please make sure you are using the",   false, x, y + 110, 20, renderer->a(0xffff));
         renderer->drawString("latest release.",                      false, x, y + 130, 20, renderer->a(0xffff));
@@ -51,37 +59,47 @@ tsl::elm::Element *ErrorGui::createUI() {
     return frame;
 }
 
-FizeauOverlayGui::FizeauOverlayGui() {
+FizeauOverlayGui::FizeauOverlayGui(): open_tick(armGetSystemTick()) {
     tsl::hlp::doWithSmSession([this] {
         this->rc = fizeauInitialize();
     });
     if (R_FAILED(rc))
         return;
 
-    tsl::hlp::doWithSDCardHandle([this] { this->config.read(); });
-
     ApmPerformanceMode perf_mode;
     if (this->rc = apmGetPerformanceMode(&perf_mode); R_FAILED(this->rc))
         return;
 
-    if (this->rc = this->config.open_profile(perf_mode == ApmPerformanceMode_Normal ?
-                                 config.internal_profile : config.external_profile); R_FAILED(this->rc))
+    // The sysmodule holds the live state, the config file is only touched when saving changes
+    if (this->rc = this->config.update(perf_mode != ApmPerformanceMode_Normal); R_FAILED(this->rc))
         return;
 
     this->is_day = Clock::is_in_interval(this->config.profile.dawn_begin, this->config.profile.dusk_begin);
 }
 
 FizeauOverlayGui::~FizeauOverlayGui() {
-    tsl::hlp::doWithSDCardHandle([this] { this->config.write(); });
+    auto tick = armGetSystemTick();
+
+    // Trailing update, if the overlay is closed before the limiter let the last change through
+    if (this->limiter.flush())
+        this->apply();
+
+    if (this->is_dirty) {
+        tsl::hlp::doWithSDCardHandle([this] {
+            this->config.read_active_override();
+            this->config.write();
+        });
+    }
     fizeauExit();
+
+    LOG("Closed in %luus (%s)\n", armTicksToNs(armGetSystemTick() - tick) / 1000, this->is_dirty ? "saved" : "unchanged");
 }
 
 tsl::elm::Element *FizeauOverlayGui::createUI() {
+    this->profile_text = format("Editing profile: %u", static_cast<std::uint32_t>(this->config.cur_profile_id) + 1);
     this->info_header = new tsl::elm::CustomDrawer([this](tsl::gfx::Renderer *renderer, s32 x, s32 y, s32 w, s32 h) {
-        renderer->drawString(format("Editing profile: %u", static_cast<std::uint32_t>(this->config.cur_profile_id) + 1).c_str(),
-            false, x, y + 20, 20, renderer->a(0xffff));
-        renderer->drawString(format("In period: %s", this->is_day ? "day" : "night").c_str(),
-            false, x, y + 45, 20, renderer->a(0xffff));
+        renderer->drawString(this->profile_text.c_str(),                             false, x, y + 20, 20, renderer->a(0xffff));
+        renderer->drawString(this->is_day ? "In period: day" : "In period: night", false, x, y + 45, 20, renderer->a(0xffff));
     });
 
     this->active_button = new tsl::elm::ListItem("Correction active");
@@ -89,6 +107,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_A) {
             this->config.active ^= 1;
             this->rc = fizeauSetIsActive(this->config.active);
+            this->is_dirty = true;
             this->active_button->setValue(this->config.active ? "Active": "Inactive");
             return true;
         }
@@ -99,12 +118,24 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->apply_button = new tsl::elm::ListItem("Apply settings");
     this->apply_button->setClickListener([this](std::uint64_t keys) {
         if (keys & HidNpadButton_A) {
-            this->rc = this->config.apply();
+            this->limiter.flush();
+            this->apply();
             return true;
         }
         return false;
     });
 
+    this->live_button = new tsl::elm::ListItem("Live preview");
+    this->live_button->setClickListener([this](std::uint64_t keys) {
+        if (keys & HidNpadButton_A) {
+            is_live ^= 1;
+            this->live_button->setValue(is_live ? "On" : "Off");
+            return true;
+        }
+        return false;
+    });
+    this->live_button->setValue(is_live ? "On" : "Off");
+
     static bool enable_extra_hot_temps = false;
     if ((this->is_day ? this->config.profile.day_settings.temperature : this->config.profile.night_settings.temperature) > D65_TEMP)
         enable_extra_hot_temps = true;
@@ -116,6 +147,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->temp_slider->setProgress((DEFAULT_TEMP - MIN_TEMP) * 100 / ((enable_extra_hot_temps ? MAX_TEMP : D65_TEMP) - MIN_TEMP));
             (this->is_day ? this->config.profile.day_settings.temperature : this->config.profile.night_settings.temperature) = DEFAULT_TEMP;
+            this->edited();
             return true;
         }
         return false;
@@ -123,6 +155,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->temp_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.temperature : this->config.profile.night_settings.temperature) =
             val * ((enable_extra_hot_temps ? MAX_TEMP : D65_TEMP) - MIN_TEMP) / 100 + MIN_TEMP;
+        this->edited();
     });
 
     this->sat_slider = new tsl::elm::TrackBar("");
@@ -132,6 +165,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->sat_slider->setProgress((DEFAULT_SAT - MIN_SAT) * 100 / (MAX_SAT - MIN_SAT));
             (this->is_day ? this->config.profile.day_settings.saturation : this->config.profile.night_settings.saturation) = DEFAULT_SAT;
+            this->edited();
             return true;
         }
         return false;
@@ -139,6 +173,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->sat_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.saturation : this->config.profile.night_settings.saturation) =
             val * (MAX_SAT - MIN_SAT) / 100 + MIN_SAT;
+        this->edited();
     });
 
     this->hue_slider = new tsl::elm::TrackBar("");
@@ -148,6 +183,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->hue_slider->setProgress((DEFAULT_HUE - MIN_HUE) * 100 / (MAX_HUE - MIN_HUE));
             (this->is_day ? this->config.profile.day_settings.hue : this->config.profile.night_settings.hue) = DEFAULT_HUE;
+            this->edited();
             return true;
         }
         return false;
@@ -155,6 +191,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->hue_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.hue : this->config.profile.night_settings.hue) =
             val * (MAX_HUE - MIN_HUE) / 100 + MIN_HUE;
+        this->edited();
     });
 
     this->components_bar = new tsl::elm::NamedStepTrackBar("", { "None", "R", "G", "RG", "B", "RB", "GB", "All" });
@@ -163,12 +200,14 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->components_bar->setProgress(Component_All);
             this->config.profile.components = Component_All;
+            this->edited();
             return true;
         }
         return false;
     });
     this->components_bar->setValueChangedListener([this](u8 val) {
         this->config.profile.components = static_cast<Component>(val);
+        this->edited();
     });
 
     this->filter_bar = new tsl::elm::NamedStepTrackBar("", { "None", "Red", "Green", "Blue" });
@@ -177,12 +216,14 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->filter_bar->setProgress(Component_None);
             this->config.profile.filter = Component_None;
+            this->edited();
             return true;
         }
         return false;
     });
     this->filter_bar->setValueChangedListener([this](u8 val) {
         this->config.profile.filter = static_cast<Component>(static_cast<Component>(val ? BIT(val - 1) : val));
+        this->edited();
     });
 
     this->contrast_slider = new tsl::elm::TrackBar("");
@@ -192,6 +233,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->contrast_slider->setProgress((DEFAULT_CONTRAST - MIN_CONTRAST) * 100 / (MAX_CONTRAST - MIN_CONTRAST));
             (this->is_day ? this->config.profile.day_settings.contrast : this->config.profile.night_settings.contrast) = DEFAULT_CONTRAST;
+            this->edited();
             return true;
         }
         return false;
@@ -199,6 +241,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->contrast_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.contrast : this->config.profile.night_settings.contrast) =
             val * (MAX_CONTRAST - MIN_CONTRAST) / 100 + MIN_CONTRAST;
+        this->edited();
     });
 
     this->gamma_slider = new tsl::elm::TrackBar("");
@@ -208,6 +251,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->gamma_slider->setProgress((DEFAULT_GAMMA - MIN_GAMMA) * 100 / (MAX_GAMMA - MIN_GAMMA));
             (this->is_day ? this->config.profile.day_settings.gamma : this->config.profile.night_settings.gamma) = DEFAULT_GAMMA;
+            this->edited();
             return true;
         }
         return false;
@@ -215,6 +259,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->gamma_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.gamma : this->config.profile.night_settings.gamma) =
             val * (MAX_GAMMA - MIN_GAMMA) / 100 + MIN_GAMMA;
+        this->edited();
     });
 
     this->luma_slider = new tsl::elm::TrackBar("");
@@ -224,6 +269,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
         if (keys & HidNpadButton_Y) {
             this->luma_slider->setProgress((DEFAULT_LUMA - MIN_LUMA) * 100 / (MAX_LUMA - MIN_LUMA));
             (this->is_day ? this->config.profile.day_settings.luminance : this->config.profile.night_settings.luminance) = DEFAULT_LUMA;
+            this->edited();
             return true;
         }
         return false;
@@ -231,6 +277,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     this->luma_slider->setValueChangedListener([this](std::uint8_t val) {
         (this->is_day ? this->config.profile.day_settings.luminance : this->config.profile.night_settings.luminance) =
             val * (MAX_LUMA - MIN_LUMA) / 100 + MIN_LUMA;
+        this->edited();
     });
 
     this->range_button = new tsl::elm::ListItem("Color range");
@@ -242,6 +289,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
             else
                 range = DEFAULT_RANGE;
             this->range_button->setValue(is_full(range) ? "Full" : "Limited");
+            this->edited();
             return true;
         }
         return false;
@@ -263,6 +311,7 @@ tsl::elm::Element *FizeauOverlayGui::createUI() {
     list->addItem(this->info_header, 60);
     list->addItem(this->active_button);
     list->addItem(this->apply_button);
+    list->addItem(this->live_button);
     list->addItem(this->temp_header);
     list->addItem(this->temp_slider);
     list->addItem(this->sat_header);
@@ -289,20 +338,40 @@ void FizeauOverlayGui::update() {
     if (R_FAILED(this->rc))
         tsl::changeTo<ErrorGui>(this->rc);
 
+    if (this->open_tick) {
+        LOG("Opened in %luus\n", armTicksToNs(armGetSystemTick() - this->open_tick) / 1000);
+        this->open_tick = 0;
+    }
+
     this->is_day = Clock::is_in_interval(this->config.profile.dawn_begin, this->config.profile.dusk_begin);
 
-    this->temp_header->setText(format("Temperature: %u°K",
-        this->is_day ? this->config.profile.day_settings.temperature : this->config.profile.night_settings.temperature));
-    this->sat_header->setText(format("Saturation: %.2f",
-        this->is_day ? this->config.profile.day_settings.saturation  : this->config.profile.night_settings.saturation));
-    this->hue_header->setText(format("Hue: %.2f",
-        this->is_day ? this->config.profile.day_settings.hue         : this->config.profile.night_settings.hue));
-    this->contrast_header->setText(format("Contrast: %.2f",
-        this->is_day ? this->config.profile.day_settings.contrast    : this->config.profile.night_settings.contrast));
-    this->gamma_header->setText(format("Gamma: %.2f",
-        this->is_day ? this->config.profile.day_settings.gamma       : this->config.profile.night_settings.gamma));
-    this->luma_header->setText(format("Luminance: %.2f",
-        this->is_day ? this->config.profile.day_settings.luminance   : this->config.profile.night_settings.luminance));
+    if (this->limiter.poll(armGetSystemTick()))
+        this->apply();
+
+    // Only reformat the headers whose value changed
+    auto &settings = this->is_day ? this->config.profile.day_settings : this->config.profile.night_settings;
+    auto set_header = [](tsl::elm::CategoryHeader *header, float &cached, const char *fmt, auto val) {
+        if (std::exchange(cached, val) != val)
+            header->setText(format(fmt, val));
+    };
+
+    auto &v = this->header_values;
+    set_header(this->temp_header,     v.temperature, "Temperature: %u°K", settings.temperature);
+    set_header(this->sat_header,      v.saturation,  "Saturation: %.2f",  settings.saturation);
+    set_header(this->hue_header,      v.hue,         "Hue: %.2f",         settings.hue);
+    set_header(this->contrast_header, v.contrast,    "Contrast: %.2f",    settings.contrast);
+    set_header(this->gamma_header,    v.gamma,       "Gamma: %.2f",       settings.gamma);
+    set_header(this->luma_header,     v.luminance,   "Luminance: %.2f",   settings.luminance);
+}
+
+void FizeauOverlayGui::edited() {
+    if (is_live)
+        this->limiter.request();
+}
+
+void FizeauOverlayGui::apply() {
+    this->rc = this->config.apply();
+    this->is_dirty = true;
 }
 
 } // namespace fz
@@ -18,6 +18,7 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <utility>
 #include <tesla.hpp>
 #include <common.hpp>
@@ -38,6 +39,36 @@ class ErrorGui: public tsl::Gui {
         Result rc;
 };
 
+// Spaces out applies of the edited settings. Changes only mark the profile as pending, and the latest values
+// are sent once the period since the last apply has elapsed, so the final change is never dropped
+class ApplyLimiter {
+    public:
+        constexpr static std::uint64_t PeriodNs = 50'000'000;
+
+    public:
+        constexpr void request() {
+            this->pending = true;
+        }
+
+        // Returns whether an apply should be issued now
+        bool poll(std::uint64_t tick) {
+            if (!this->pending || tick - this->last_tick < armNsToTicks(ApplyLimiter::PeriodNs))
+                return false;
+
+            this->pending = false, this->last_tick = tick;
+            return true;
+        }
+
+        // Drops the pending apply, returns whether there was one
+        constexpr bool flush() {
+            return std::exchange(this->pending, false);
+        }
+
+    private:
+        bool pending = false;
+        std::uint64_t last_tick = 0;
+};
+
 class FizeauOverlayGui: public tsl::Gui {
     public:
         FizeauOverlayGui();
@@ -47,6 +78,10 @@ class FizeauOverlayGui: public tsl::Gui {
 
         virtual void update() final override;
 
+        // Called when a setting was modified
+        void edited();
+        void apply();
+
         Config &get_config() {
             return this->config;
         }
@@ -56,9 +91,26 @@ class FizeauOverlayGui: public tsl::Gui {
         bool is_day;
         Config config = {};
 
+        // Set when the state of the sysmodule was modified, and needs to be saved on close
+        bool is_dirty = false;
+        // Time at construction, for the open-to-first-frame latency. Cleared once reported
+        std::uint64_t open_tick;
+
+        // Live preview applies, issued from update() on the gui thread so at most one is in flight
+        ApplyLimiter limiter;
+
+        // Values currently displayed by the headers, which are only reformatted on change
+        struct {
+            float temperature, saturation, hue, contrast, gamma, luminance;
+        } header_values = {
+            __builtin_nanf(""), __builtin_nanf(""), __builtin_nanf(""), __builtin_nanf(""), __builtin_nanf(""), __builtin_nanf(""),
+        };
+        std::string profile_text;
+
         tsl::elm::CustomDrawer      *info_header;
         tsl::elm::ListItem          *active_button;
         tsl::elm::ListItem          *apply_button;
+        tsl::elm::ListItem          *live_button;
         tsl::elm::TrackBar          *temp_slider;
         tsl::elm::TrackBar          *sat_slider;
         tsl::elm::TrackBar          *hue_slider;
@@ -0,0 +1,107 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#include <common.hpp>
+
+namespace fz {
+
+// Ambient light level between 0 (dark) and 1 (bright), following the sensor with hysteresis.
+// Samples outside of a band around the current level have to persist before the level moves to their mean,
+// and the level moves at most once per interval, so that a steady environment costs no commits
+class AmbientLightFilter {
+    public:
+        // Light levels are perceived logarithmically, the level is linear in log(lux) between these
+        constexpr static float DarkLux = 5.0f, BrightLux = 500.0f;
+
+        constexpr static float Hysteresis = 0.1f; // Fifth of a decade
+        constexpr static std::size_t NumSettleSamples = 4;
+        constexpr static std::uint64_t SamplePeriod = std::chrono::nanoseconds(std::chrono::milliseconds(500)).count(),
+            MinChangeInterval = std::chrono::nanoseconds(std::chrono::seconds(10)).count();
+
+    public:
+        static float to_level(float lux) {
+            if (!(lux > DarkLux))
+                return 0.0f;
+            return std::min(std::log10(lux / DarkLux) / std::log10(BrightLux / DarkLux), 1.0f);
+        }
+
+        // Feeds a sample taken at ts (ns), returns whether the level changed
+        bool update(float lux, std::uint64_t ts) {
+            auto sample = AmbientLightFilter::to_level(lux);
+
+            // The first sample is taken as is, to start from the actual environment
+            if (!this->has_level) {
+                this->has_level = true, this->level = sample, this->change_ts = ts;
+                return true;
+            }
+
+            auto delta = sample - this->level;
+            if (std::abs(delta) <= Hysteresis || (this->num_samples && std::signbit(delta) != this->is_darker)) {
+                this->num_samples = 0;
+                if (std::abs(delta) <= Hysteresis)
+                    return false;
+            }
+
+            this->is_darker = std::signbit(delta);
+            this->samples[this->num_samples++ % NumSettleSamples] = sample;
+
+            if (this->num_samples < NumSettleSamples || ts - this->change_ts < MinChangeInterval)
+                return false;
+
+            float sum = 0.0f;
+            for (auto s: this->samples)
+                sum += s;
+
+            this->level = sum / NumSettleSamples, this->change_ts = ts, this->num_samples = 0;
+            return true;
+        }
+
+        float get_level() const {
+            return this->has_level ? this->level : 1.0f;
+        }
+
+    private:
+        bool has_level = false, is_darker = false;
+        float level = 1.0f;
+        std::uint64_t change_ts = 0;
+        std::array<float, NumSettleSamples> samples = {};
+        std::size_t num_samples = 0;
+};
+
+constexpr bool has_ambient_offsets(const FizeauProfile &profile) {
+    return profile.ambient_temperature || profile.ambient_luminance;
+}
+
+// The offsets of a profile are fully applied in the dark, and fade out towards bright light
+inline void apply_ambient_offsets(FizeauSettings &settings, const FizeauProfile &profile, float level) {
+    auto weight = 1.0f - level;
+
+    auto temperature = static_cast<float>(settings.temperature) + weight * profile.ambient_temperature;
+    settings.temperature = static_cast<Temperature>(std::clamp(std::round(temperature),
+        static_cast<float>(MIN_TEMP), static_cast<float>(MAX_TEMP)));
+    settings.luminance = std::clamp(settings.luminance + weight * profile.ambient_luminance, MIN_LUMA, MAX_LUMA);
+}
+
+} // namespace fz
@@ -0,0 +1,132 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <bit>
+
+#include <common.hpp>
+
+namespace fz {
+
+// Profiles of applications, by program id. Open addressing with linear probing in a fixed array,
+// sized to twice the maximum number of rules so that probe sequences stay a few entries long.
+// Program id 0 is never an application, and marks empty slots.
+// Not thread-safe: erasing moves entries a concurrent lookup may be probing, the context mutex guards it
+class AppProfileTable {
+    public:
+        constexpr static std::size_t Capacity = 2 * FIZEAU_MAX_APP_RULES;
+        static_assert(std::has_single_bit(Capacity), "Table capacity must be a power of two");
+
+    public:
+        FizeauProfileId find(std::uint64_t program_id) const {
+            if (!program_id)
+                return FizeauProfileId_Invalid;
+
+            for (auto i = AppProfileTable::hash(program_id); ; i = (i + 1) & (Capacity - 1)) {
+                auto &e = this->entries[i];
+                if (e.program_id == program_id)
+                    return e.profile;
+                if (!e.program_id)
+                    return FizeauProfileId_Invalid;
+            }
+        }
+
+        // Returns false if the table is full
+        bool insert(std::uint64_t program_id, FizeauProfileId profile) {
+            if (!program_id)
+                return false;
+
+            for (auto i = AppProfileTable::hash(program_id); ; i = (i + 1) & (Capacity - 1)) {
+                auto &e = this->entries[i];
+                if (e.program_id == program_id) {
+                    e.profile = profile;
+                    return true;
+                }
+
+                if (!e.program_id) {
+                    if (this->count >= FIZEAU_MAX_APP_RULES)
+                        return false;
+
+                    e = { program_id, profile };
+                    ++this->count;
+                    return true;
+                }
+            }
+        }
+
+        // Backward shift deletion, so that lookups never need tombstones
+        void erase(std::uint64_t program_id) {
+            if (!program_id)
+                return;
+
+            auto i = AppProfileTable::hash(program_id);
+            while (this->entries[i].program_id != program_id) {
+                if (!this->entries[i].program_id)
+                    return;
+                i = (i + 1) & (Capacity - 1);
+            }
+
+            for (auto j = (i + 1) & (Capacity - 1); this->entries[j].program_id; j = (j + 1) & (Capacity - 1)) {
+                // Move the entry back into the hole unless its home slot lies cyclically in (i, j]
+                auto home = AppProfileTable::hash(this->entries[j].program_id);
+                if (((j - home) & (Capacity - 1)) >= ((j - i) & (Capacity - 1)))
+                    this->entries[i] = this->entries[j], i = j;
+            }
+
+            this->entries[i] = {};
+            --this->count;
+        }
+
+        void clear() {
+            this->entries = {};
+            this->count   = 0;
+        }
+
+        std::size_t size() const {
+            return this->count;
+        }
+
+        // Bit mask of the profiles set for any application
+        std::uint32_t profile_mask() const {
+            std::uint32_t mask = 0;
+            for (auto &e: this->entries) {
+                if (e.program_id && e.profile < FizeauProfileId_Total)
+                    mask |= BIT(e.profile);
+            }
+            return mask;
+        }
+
+    private:
+        // Program ids differ in their middle bits, a multiplicative hash spreads them over the top bits
+        static std::size_t hash(std::uint64_t program_id) {
+            return (program_id * 0x9e3779b97f4a7c15ull) >> (64 - std::countr_zero(Capacity));
+        }
+
+    private:
+        struct Entry {
+            std::uint64_t program_id;
+            FizeauProfileId profile;
+        };
+
+        std::array<Entry, Capacity> entries = {};
+        std::size_t count = 0;
+};
+
+} // namespace fz
@@ -17,22 +17,29 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 
 #include <common.hpp>
 
+#include "app_table.hpp"
 #include "nvdisp.hpp"
 
 namespace fz {
 
-enum FizeauProfileState: std::uint32_t {
-    Day,
-    Night,
-};
-
 struct Context {
+    // Held by the IPC server through each command, and by the threads of the profile manager through each of their
+    // updates. Everything below is only read and written under it, and it is taken before the commit mutex
+    Mutex mutex = {};
+
     bool is_lite = false, is_active = false;
 
+    // Set while the boot worker loads the config and applies it. The service already answers queries meanwhile,
+    // from the default state until the loaded one is published under the mutex, and rejects writes as busy
+    std::atomic_bool is_booting = false;
+
+    // Unset until a config sets them, nothing is applied meanwhile
     FizeauProfileId internal_profile = FizeauProfileId_Invalid,
         external_profile = FizeauProfileId_Invalid;
 
@@ -55,9 +62,74 @@ struct Context {
         },
     };
 
-    std::array<FizeauProfileState, FizeauProfileId_Total> profile_states = {};
+    // Incremented on every write of the profile, for clients to detect concurrent edits
+    std::array<std::uint32_t, FizeauProfileId_Total> profile_versions = {};
+
+    std::array<KeyframeArray, FizeauProfileId_Total> keyframes = {};
+
+    // Compiled from the profiles and their keyframes whenever they are written, which resets their segments
+    std::array<Timeline, FizeauProfileId_Total> timelines = {};
+    std::array<std::uint32_t, FizeauProfileId_Total> timeline_generations = {}; // Incremented on each compilation
+
+    // Timeline segment of each profile when it was last applied
+    std::array<std::uint32_t, FizeauProfileId_Total> profile_segments = {};
+
+    // Local date (days since 1970-01-01) and UTC offset (s) the solar times of the timelines were computed for
+    std::int64_t solar_day = 0;
+    std::int32_t solar_utc_offset = 0;
+
+    // Profile set for the running application, replacing the internal and external profiles
+    FizeauProfileId app_profile = FizeauProfileId_Invalid;
+    AppProfileTable app_profiles = {};
+    std::uint32_t app_profile_mask = 0; // Profiles set for any application
 
     DisplayController::CmuShadow cmu_shadow_internal = {}, cmu_shadow_external = {};
+
+    // LUT blocks verified per transition poll, which trades MMIO accesses for the latency of detecting corruption
+    std::uint32_t lut_verify_blocks = DisplayController::DefaultLutVerifyBlocks;
+
+    // CMU of the held settings of each profile, last committed or calculated ahead for the profiles of applications
+    std::array<DisplayController::PreparedCmu, FizeauProfileId_Total> prepared_cmus = {};
+
+    FizeauProfileId get_profile(bool external) const {
+        if (this->app_profile < FizeauProfileId_Total)
+            return this->app_profile;
+        return !external ? this->internal_profile : this->external_profile;
+    }
+
+    bool is_displayed(FizeauProfileId id) const {
+        return id == this->get_profile(false) || id == this->get_profile(true);
+    }
+
+    void compile_timeline(FizeauProfileId id) {
+        ++this->timeline_generations[id];
+
+        if (!this->profiles[id].has_location)
+            return this->timelines[id].compile(this->profiles[id], this->keyframes[id]);
+
+        auto profile = this->profiles[id];
+        apply_solar_times(profile, this->solar_day, this->solar_utc_offset);
+        this->timelines[id].compile(profile, this->keyframes[id]);
+    }
+
+    // Recompiles the timelines following the sun on a new date or time zone, returns whether any was
+    bool update_solar_day(std::int64_t day, std::int32_t utc_offset) {
+        if (day == this->solar_day && utc_offset == this->solar_utc_offset)
+            return false;
+
+        this->solar_day = day, this->solar_utc_offset = utc_offset;
+
+        bool updated = false;
+        for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id) {
+            if (this->profiles[id].has_location)
+                this->compile_timeline(static_cast<FizeauProfileId>(id)), updated = true;
+        }
+        return updated;
+    }
+
+    bool has_location() const {
+        return std::any_of(this->profiles.begin(), this->profiles.end(), [](auto &p) { return p.has_location; });
+    }
 };
 
 } // namespace fz
@@ -13,7 +13,7 @@
 
 Result ipcServerInit(IpcServer* server, const char* name, u32 max_sessions)
 {
-    if(max_sessions < 1 || max_sessions > (MAX_WAIT_OBJECTS - 1))
+    if(max_sessions < 1 || max_sessions > IPC_SERVER_MAX_SESSIONS)
     {
         return MAKERESULT(Module_Libnx, LibnxError_BadInput);
     }
@@ -21,6 +21,8 @@ Result ipcServerInit(IpcServer* server, const char* name, u32 max_sessions)
     server->srvName = smEncodeName(name);
     server->max = max_sessions + 1;
     server->count = 0;
+    server->next = 0;
+    server->nextId = 1;
 
     Result rc = smRegisterService(&server->handles[0], server->srvName, false, max_sessions);
     if(R_SUCCEEDED(rc))
@@ -48,6 +50,7 @@ static Result _ipcServerAddSession(IpcServer* server, Handle session)
     }
 
     server->handles[server->count] = session;
+    server->sessions[server->count] = (IpcServerSession){ .id = server->nextId++ };
     server->count++;
     return 0;
 }
@@ -61,11 +64,9 @@ static Result _ipcServerDeleteSession(IpcServer* server, u32 index)
 
     svcCloseHandle(server->handles[index]);
 
-    for(u32 j = index; j < (server->count - 1); j++)
-    {
-        server->handles[j] = server->handles[j + 1];
-    }
     server->count--;
+    server->handles[index] = server->handles[server->count];
+    server->sessions[index] = server->sessions[server->count];
     return 0;
 }
 
@@ -140,6 +141,8 @@ static Result _ipcServerProcessSession(IpcServer* server, IpcServerRequestHandle
     if(R_SUCCEEDED(rc))
     {
         rc = _ipcServerParseRequest(&r);
+        r.session = &server->sessions[handleIndex];
+        r.session->numRequests++;
     }
 
     if(R_SUCCEEDED(rc))
@@ -147,12 +150,12 @@ static Result _ipcServerProcessSession(IpcServer* server, IpcServerRequestHandle
         switch(r.hipc.meta.type)
         {
             case CmifCommandType_Request:
-                _ipcServerPrepareResponse(
-                    handler(userdata, &r, data, &dataSize),
-                    data,
-                    dataSize
-                );
+            {
+                // The handler sets dataSize, it must run before the argument is read
+                Result handlerRc = handler(userdata, &r, data, &dataSize);
+                _ipcServerPrepareResponse(handlerRc, data, dataSize);
                 break;
+            }
             case CmifCommandType_Close:
                 _ipcServerPrepareResponse(0, NULL, 0);
                 close = true;
@@ -187,10 +190,22 @@ Result ipcServerProcess(IpcServer* server, IpcServerRequestHandler handler, void
         rc = MAKERESULT(Module_Libnx, LibnxError_NotFound);
     }
 
+    // The kernel reports the first signaled handle, look for a ready one after the cursor so that busy clients
+    // at low indices can't starve the others
+    if(R_SUCCEEDED(rc) && (u32)handleIndex < server->next && server->next < server->count)
+    {
+        s32 laterIndex = -1;
+        if(R_SUCCEEDED(svcWaitSynchronization(&laterIndex, &server->handles[server->next], server->count - server->next, 0)))
+        {
+            handleIndex = server->next + laterIndex;
+        }
+    }
+
     if(R_SUCCEEDED(rc))
     {
         if(handleIndex)
         {
+            server->next = handleIndex + 1;
             rc = _ipcServerProcessSession(server, handler, userdata, handleIndex);
         }
         else
@@ -201,4 +216,3 @@ Result ipcServerProcess(IpcServer* server, IpcServerRequestHandler handler, void
 
     return rc;
 }
-
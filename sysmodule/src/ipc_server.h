@@ -29,12 +29,26 @@ typedef struct
     };
 } IpcServerRawHeader;
 
+#define IPC_SERVER_MAX_SESSIONS (MAX_WAIT_OBJECTS - 1)
+
+// State kept for each connected client, index 0 is the service port
+typedef struct
+{
+    u32 id;
+    u32 numRequests;
+} IpcServerSession;
+
+// Session handles are kept contiguous for svcWaitSynchronization, closed sessions are replaced by the last one.
+// Ready sessions are serviced in round-robin order, starting after the last serviced index
 typedef struct
 {
     SmServiceName srvName;
     Handle handles[MAX_WAIT_OBJECTS];
+    IpcServerSession sessions[MAX_WAIT_OBJECTS];
     u32 max;
     u32 count;
+    u32 next;
+    u32 nextId;
 } IpcServer;
 
 typedef struct
@@ -48,6 +62,7 @@ typedef struct
 {
     HipcParsedRequest hipc;
     IpcServerRequestData data;
+    IpcServerSession* session;
 } IpcServerRequest;
 
 typedef Result (*IpcServerRequestHandler)(void* userdata, const IpcServerRequest* r, u8* out_data, size_t* out_dataSize);
@@ -16,6 +16,7 @@
 // along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstring>
+#include <array>
 #include <ini.h>
 #include <switch.h>
 
@@ -89,6 +90,18 @@ void __appInit(void) {
     if (auto rc = insrInitialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
 
+    if (auto rc = pmdmntInitialize(); R_FAILED(rc))
+        diagAbortWithResult(rc);
+
+    if (auto rc = pminfoInitialize(); R_FAILED(rc))
+        diagAbortWithResult(rc);
+
+    // Needs 10.0.0, applications keep the handheld/docked profiles without it
+    pglInitialize();
+
+    // Ambient light is not followed without it
+    lblInitialize();
+
 #if defined(DEBUG) && defined(TWILI)
     if (auto rc = twiliInitialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
@@ -99,9 +112,14 @@ void __appInit(void) {
 }
 
 void __appExit(void) {
+    timeExit();
     nvExit();
     ommExit();
     insrExit();
+    lblExit();
+    pglExit();
+    pminfoExit();
+    pmdmntExit();
 
 #if defined(DEBUG) && defined(TWILI)
     twiliClosePipe(&g_twlPipe);
@@ -119,6 +137,16 @@ static constinit fz::DisplayController disp    = {};
 static constinit fz::ProfileManager    profile(context, disp);
 static constinit fz::Server            server (context, profile);
 
+// Loading and applying the config runs on a worker, so that the service is registered as early as possible
+static constinit Thread boot_thread = {};
+alignas(0x1000) static constinit std::uint8_t boot_thread_stack[0x2000] = {};
+
+// Config parsed by the boot worker, published to the context at once
+struct LoadedConfig: fz::Config {
+    std::array<FizeauProfile, FizeauProfileId_Total> profiles = {};
+    std::array<fz::KeyframeArray, FizeauProfileId_Total> keyframes = {};
+};
+
 FsFile find_config_file(FsFileSystem fs) {
     FsFile fp = {};
     char buf[FS_MAX_PATH];
@@ -130,7 +158,7 @@ FsFile find_config_file(FsFileSystem fs) {
     return fp;
 }
 
-bool parse_config() {
+bool parse_config(LoadedConfig &config) {
     auto rc = fsInitialize();
     FZ_SCOPEGUARD([] { fsExit(); });
 
@@ -152,11 +180,12 @@ bool parse_config() {
         std::uint64_t off = 0;
     } read_ctx = { fp };
 
-    fz::Config config;
     config.parse_profile_switch_action = +[](fz::Config *self, FizeauProfileId profile_id) {
         if (self->cur_profile_id == FizeauProfileId_Invalid)
             return;
-        context.profiles[self->cur_profile_id] = self->profile;
+        auto *config = static_cast<LoadedConfig *>(self);
+        config->profiles [self->cur_profile_id] = self->profile;
+        config->keyframes[self->cur_profile_id] = self->keyframes;
         self->profile = {};
     };
 
@@ -181,41 +210,116 @@ bool parse_config() {
         return str;
     };
 
-    if (auto res = ini_parse_stream(reader, &read_ctx, fz::Config::ini_handler, &config); !res) {
-        context.is_active        = config.active;
-        context.internal_profile = config.internal_profile;
-        context.external_profile = config.external_profile;
-    }
+    // An invalid entry only loses its own setting, the rest of the config still applies
+    ini_handler handler = +[](void *user, const char *section, const char *name, const char *value) -> int {
+        if (!fz::Config::ini_handler(user, section, name, value))
+            LOG("Skipping invalid config entry [%s] %s = %s\n", section, name, value);
+        return 1;
+    };
+
+    if (auto res = ini_parse_stream(reader, &read_ctx, handler, &config); res < 0)
+        return false;
+    else if (res > 0)
+        LOG("Config syntax error on line %d\n", res);
 
+    // Flush the last section
+    config.parse_profile_switch_action(&config, FizeauProfileId_Invalid);
     return true;
 }
 
-int main(int argc, char **argv) {
-    LOG("Initializing\n");
+// Kept out of the worker body, so that the parsed config does not stay on the stack through the first commit
+[[gnu::noinline]] bool load_config() {
+    LoadedConfig config;
+    if (!parse_config(config))
+        return false;
 
-    u64 hw_type;
-    if (auto rc = splGetConfig(SplConfigItem_HardwareType, reinterpret_cast<u64 *>(&hw_type)); R_FAILED(rc))
+    // The worker threads of the profile manager already run, and take the same mutex
+    mutexLock(&context.mutex);
+    FZ_SCOPEGUARD([] { mutexUnlock(&context.mutex); });
+
+    context.profiles  = config.profiles;
+    context.keyframes = config.keyframes;
+
+    // Clients that read the default profiles get a version mismatch on their conditional writes
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id) {
+        context.compile_timeline(static_cast<FizeauProfileId>(id));
+        ++context.profile_versions[id];
+    }
+
+    for (std::size_t i = 0; i < config.num_app_rules; ++i)
+        context.app_profiles.insert(config.app_rules[i].program_id, config.app_rules[i].profile);
+    context.app_profile_mask = context.app_profiles.profile_mask();
+
+    context.is_active        = config.active;
+    context.internal_profile = config.internal_profile;
+    context.external_profile = config.external_profile;
+    return true;
+}
+
+void boot_thread_func(void *args) {
+    // Kept open for the resynchronizations of the clock by the transition thread
+    if (auto rc = timeInitialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
-    context.is_lite = hw_type == 2; // Hoag
 
     if (auto rc = fz::Clock::initialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
 
-    if (auto rc = disp.initialize(); R_FAILED(rc))
+    if (auto rc = disp.initialize(context.is_lite); R_FAILED(rc))
         diagAbortWithResult(rc);
 
     if (auto rc = profile.initialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
 
-    if (parse_config())
+    if (load_config()) {
+        mutexLock(&context.mutex);
         profile.apply();
+        mutexUnlock(&context.mutex);
+        FZ_TRACE_EVENT(Event_FirstCommit);
+        LOG("First commit at %lums\n", armTicksToNs(armGetSystemTick()) / 1'000'000);
+    }
+
+    context.is_booting = false;
+}
+
+int main(int argc, char **argv) {
+    LOG("Initializing\n");
+
+#ifdef FZ_TRACE
+    // The main thread runs on the stack region mapped by the loader
+    MemoryInfo stack_info;
+    u32 page_info;
+    if (R_SUCCEEDED(svcQueryMemory(&stack_info, &page_info, reinterpret_cast<std::uintptr_t>(&stack_info))))
+        FZ_TRACE_STACK(Stack_Main, reinterpret_cast<const void *>(stack_info.addr), stack_info.size);
+#endif
+
+    u64 hw_type;
+    if (auto rc = splGetConfig(SplConfigItem_HardwareType, reinterpret_cast<u64 *>(&hw_type)); R_FAILED(rc))
+        diagAbortWithResult(rc);
+    context.is_lite = hw_type == 2; // Hoag
+
+    context.is_booting = true;
 
     LOG("Starting server\n");
     if (auto rc = server.initialize(); R_FAILED(rc))
         diagAbortWithResult(rc);
 
+    // System ticks count from the console boot
+    FZ_TRACE_EVENT(Event_ServiceReady);
+    LOG("Service ready at %lums\n", armTicksToNs(armGetSystemTick()) / 1'000'000);
+
+    FZ_TRACE_STACK(Stack_Boot, boot_thread_stack, sizeof(boot_thread_stack));
+    if (auto rc = threadCreate(&boot_thread, &boot_thread_func, nullptr,
+            boot_thread_stack, sizeof(boot_thread_stack), 0x31, -2); R_FAILED(rc))
+        diagAbortWithResult(rc);
+
+    if (auto rc = threadStart(&boot_thread); R_FAILED(rc))
+        diagAbortWithResult(rc);
+
     server.loop();
 
+    threadWaitForExit(&boot_thread);
+    threadClose(&boot_thread);
+
     server .finalize();
     profile.finalize();
     disp   .finalize();
@@ -17,6 +17,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <type_traits>
 #include <common.hpp>
 
 #include "color.hpp"
@@ -27,104 +28,243 @@ namespace fz {
 
 namespace {
 
-Cmu calculate_cmu(FizeauSettings &settings, Component components, Component filter) {
-    Cmu cmu;
-
-    // Calculate initial coefficients
-    auto coeffs = filter_matrix(filter);
+// FNV-1a, over entries as they read back from the registers
+constexpr std::uint32_t hash_entry(std::uint32_t hash, std::uint32_t val) {
+    hash = (hash ^ (val & 0xff)) * 0x01000193;
+    return (hash ^ (val >> 8))   * 0x01000193;
+}
 
-    // Apply temperature color correction
-    ColorMatrix m = {};
-    std::tie(m[0], m[4], m[8]) = whitepoint(settings.temperature);
-    m[0] = degamma(m[0], 2.4f), m[4] = degamma(m[4], 2.4f), m[8] = degamma(m[8], 2.4f);
-    coeffs = dot(coeffs, m);
+constexpr std::uint32_t lut_hash_seed = 0x811c9dc5;
 
-    // Apply contrast multiplier
-    auto c = contrast_slant(settings.contrast);
-    m[0] = m[4] = m[8] = c;
-    coeffs = dot(coeffs, m);
+} // namespace
 
-    // Apply saturation
-    coeffs = dot(coeffs, saturation_matrix(settings.saturation));
+Result DisplayController::initialize(bool is_lite) {
+    this->is_lite = is_lite;
 
-    // Apply hue rotation
-    coeffs = dot(coeffs, hue_matrix(settings.hue));
+    std::uint64_t size;
+    if (auto rc = svcQueryMemoryMapping(&this->clock_va_base, &size, CLOCK_IO_BASE, CLOCK_IO_SIZE); R_FAILED(rc))
+        return rc;
 
-    // Copy calculated coefficients to the cmu matrix if they are enabled
-    if (components & Component_Red)
-        std::copy_n(coeffs.begin() + 0, 3, &cmu.krr);
-    if (components & Component_Green)
-        std::copy_n(coeffs.begin() + 3, 3, &cmu.krg);
-    if (components & Component_Blue)
-        std::copy_n(coeffs.begin() + 6, 3, &cmu.krb);
+    if (auto rc = svcQueryMemoryMapping(&this->disp_va_base, &size, DISP_IO_BASE, DISP_IO_SIZE); R_FAILED(rc))
+        return rc;
 
-    // Calculate gamma ramps, with contrast offset
-    float off = (1.0f - c) / 2.0f;
-    degamma_ramp(cmu.lut_1.data(), cmu.lut_1.size(), DEFAULT_GAMMA, 12);                                // Set the LUT1 with a fixed gamma corresponding to the incoming data
-    regamma_ramp(cmu.lut_2.data(), 512, settings.gamma, 8, 0.0f, 0.125f, off);                          // Set the first part of LUT2 (more precision in darker components)
-    regamma_ramp(cmu.lut_2.data() + 512, cmu.lut_2.size() - 512, settings.gamma, 8, 0.125f, 1.0f, off); // Set the second part of LUT2 (less precision in brighter components)
+    if (auto rc = nvOpen(&this->disp0_fd, "/dev/nvdisp-disp0"); R_FAILED(rc))
+        return rc;
 
-    // Apply luminance
-    apply_luma(cmu.lut_2.data(), cmu.lut_2.size(), 8, settings.luminance);
+    std::uint32_t fd;
+    return !is_lite ? this->get_fd(true, fd) : 0;
+}
 
-    // Apply color range
-    apply_range(cmu.lut_2.data(), cmu.lut_2.size(), 8,
-        settings.range.lo, std::min(settings.range.hi, cmu.lut_2.back() / 255.0f)); // Adjust max for luma
+Result DisplayController::get_fd(bool external, std::uint32_t &fd) const {
+    if (external && !this->has_disp1) {
+        if (auto rc = nvOpen(&this->disp1_fd, "/dev/nvdisp-disp1"); R_FAILED(rc))
+            return rc;
+        this->has_disp1 = true;
+    }
 
-    return cmu;
+    fd = !external ? this->disp0_fd : this->disp1_fd;
+    return 0;
 }
 
-} // namespace
-
 Result DisplayController::disable(bool external) const {
-    Cmu cmu(false);
+    std::uint32_t fd;
+    if (auto rc = this->get_fd(external, fd); R_FAILED(rc))
+        return rc;
 
-    if (auto rc = nvioctlNvDisp_SetCmu(!external ? this->disp0_fd : this->disp1_fd, &cmu))
+    this->cmu_buffer.reset(false);
+    if (auto rc = nvioctlNvDisp_SetCmu(fd, &this->cmu_buffer))
         return rc;
 
-    if (external)
+    // No video output on the Lite
+    if (external || this->is_lite)
         return 0;
 
+    if (auto rc = this->get_fd(true, fd); R_FAILED(rc))
+        return rc;
+
     AviInfoframe infoframe;
-    if (auto rc = nvioctlNvDisp_GetAviInfoframe(this->disp1_fd, &infoframe); R_FAILED(rc))
+    if (auto rc = nvioctlNvDisp_GetAviInfoframe(fd, &infoframe); R_FAILED(rc))
         return rc;
 
     infoframe.rgb_quant = RgbQuantRange::Default;
-    if (auto rc = nvioctlNvDisp_SetAviInfoframe(this->disp1_fd, &infoframe); R_FAILED(rc))
+    if (auto rc = nvioctlNvDisp_SetAviInfoframe(fd, &infoframe); R_FAILED(rc))
         return rc;
 
     return 0;
 }
 
-Result DisplayController::apply_color_profile(bool external, FizeauSettings &settings,
-        Component components, Component filter, CmuShadow &shadow) const {
-    Cmu cmu = calculate_cmu(settings, components, filter);
+template <typename Lut2Array>
+void DisplayController::hash_luts(const Lut1 &lut_1, const Lut2Array &lut_2, LutHashes &hashes) {
+    for (std::size_t i = 0; i < NumLutBlocks; ++i) {
+        auto hash = lut_hash_seed;
+        for (std::size_t j = i * LutBlockSize; j < (i + 1) * LutBlockSize; ++j)
+            hash = hash_entry(hash, (j < lut_1.size()) ? (lut_1[j] & 0xfff) : (lut_2[j - lut_1.size()] & 0xff));
+        hashes[i] = hash;
+    }
+}
+
+void DisplayController::prepare_cmu(const FizeauSettings &settings, Component components, Component filter,
+        PreparedCmu &prepared) const {
+    FZ_TRACE_SCOPE(Event_CalculateCmu);
+    auto &cmu = this->cmu_buffer;
+    calculate_cmu(cmu, settings, components, filter);
+
+    std::copy_n(&cmu.krr, prepared.cmu.csc.size(), prepared.cmu.csc.begin());
+    prepared.cmu.lut_1 = cmu.lut_1;
+    std::transform(cmu.lut_2.begin(), cmu.lut_2.end(), prepared.cmu.lut_2.begin(),
+        [](std::uint16_t v) { return static_cast<Lut2::value_type>(v); });
+
+    prepared.is_identity = cmu::is_identity(cmu);
+    prepared.valid       = true;
+}
+
+Result DisplayController::apply_color_profile(bool external, const PreparedCmu &prepared, float csc_scale,
+        CmuShadow &shadow) const {
+    return this->commit(external, prepared.cmu.csc.data(), prepared.cmu.lut_1, prepared.cmu.lut_2,
+        prepared.is_identity, csc_scale, shadow);
+}
+
+Result DisplayController::apply_color_profile(bool external, const FizeauSettings &settings, Component components,
+        Component filter, float csc_scale, CmuShadow &shadow) const {
+    auto &cmu = this->cmu_buffer;
+    {
+        FZ_TRACE_SCOPE(Event_CalculateCmu);
+        calculate_cmu(cmu, settings, components, filter);
+    }
+
+    return this->commit(external, &cmu.krr, cmu.lut_1, cmu.lut_2, cmu::is_identity(cmu), csc_scale, shadow);
+}
 
-    if (auto rc = nvioctlNvDisp_SetCmu(!external ? this->disp0_fd : this->disp1_fd, &cmu); R_FAILED(rc))
+template <typename Lut2Array>
+Result DisplayController::commit(bool external, const QS18 *coeffs, const Lut1 &lut_1, const Lut2Array &lut_2,
+        bool is_identity, float csc_scale, CmuShadow &shadow) const {
+    std::uint32_t fd;
+    if (auto rc = this->get_fd(external, fd); R_FAILED(rc))
         return rc;
 
+    // Spare the display pipe a pass that does nothing
+    if (is_identity && csc_scale == 1.0f) {
+        this->cmu_buffer.reset(false);
+        if (auto rc = nvioctlNvDisp_SetCmu(fd, &this->cmu_buffer); R_FAILED(rc))
+            return rc;
+
+        shadow.is_bypassed = true, shadow.has_luts = false;
+        return 0;
+    }
+
+    // Register values of the coefficients, scaled so that the prepared CMU stays unscaled
+    Csc csc;
+    std::transform(coeffs, coeffs + csc.size(), csc.begin(), [csc_scale](QS18 c) {
+        auto k = (csc_scale != 1.0f) ? std::lround(cmu::coefficient(c) * csc_scale) : cmu::coefficient(c);
+        return static_cast<Csc::value_type>(k & QS18::BitMask);
+    });
+
+    // The LUTs are compared by content, settings that round to the same entries don't need a commit
+    LutHashes hashes;
+    DisplayController::hash_luts(lut_1, lut_2, hashes);
+
+    // nvdrv programs the LUTs right away, mid-frame
+    if (!shadow.has_luts || hashes != shadow.lut_hashes || !this->stage_csc(external, csc)) {
+        // A calculated CMU is already in the buffer, a prepared one is expanded into it
+        auto &cmu = this->cmu_buffer;
+        if constexpr (!std::is_same_v<Lut2Array, decltype(Cmu::lut_2)>) {
+            cmu.reset();
+            cmu.lut_1 = lut_1;
+            std::copy(lut_2.begin(), lut_2.end(), cmu.lut_2.begin());
+        }
+        std::transform(csc.begin(), csc.end(), &cmu.krr, [](Csc::value_type c) { return QS18(cmu::coefficient(c)); });
+
+        if (auto rc = nvioctlNvDisp_SetCmu(fd, &cmu); R_FAILED(rc))
+            return rc;
+
+        shadow.has_luts = true, shadow.lut_hashes = hashes;
+    }
+
     // Save cmu shadow, to be used for change detection
-    std::transform(&cmu.krr, &cmu.krr + 9, shadow.csc.begin(),
-        [](QS18 c) -> std::uint16_t { return static_cast<Csc::value_type>(c) & QS18::BitMask; });
+    shadow.is_bypassed = false;
+    shadow.csc = csc;
 
     return 0;
 }
 
+bool DisplayController::stage_csc(bool external, const Csc &csc) const {
+    // Registers are unreachable while the display is clock gated, and reset with the CMU disabled
+    if (!(READ(this->clock_va_base + CLK_RST_CONTROLLER_CLK_OUT_ENB_L) & (!external ? CLK_ENB_DISP1 : CLK_ENB_DISP2)))
+        return false;
+
+    auto base = this->disp_va_base + (!external ? 0 : 0x40000);
+    if ((READ(base + DC_CMD_DISPLAY_COMMAND) & DISP_CTRL_MODE_MASK) == DISP_CTRL_MODE_STOP ||
+            !(READ(base + DC_DISP_DISP_COLOR_CONTROL) & CMU_ENABLE))
+        return false;
+
+    for (std::size_t i = 0; i < csc.size(); ++i)
+        WRITE(base + DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t), csc[i]);
+
+    // Not waited for: an nvdrv commit landing before the latch carries newer coefficients anyway, and a request
+    // that never latches leaves the active CSC different from the shadow, which the next poll reapplies
+    FZ_TRACE_EVENT(Event_CscStage, external);
+    WRITE(base + DC_CMD_STATE_CONTROL, GENERAL_UPDATE);
+    WRITE(base + DC_CMD_STATE_CONTROL, GENERAL_ACT_REQ);
+
+    return true;
+}
+
+bool DisplayController::verify_luts(bool external, CmuShadow &shadow, std::uint32_t num_blocks) const {
+    if (shadow.is_bypassed || !shadow.has_luts)
+        return true;
+
+    auto base = this->disp_va_base + (!external ? 0 : 0x40000);
+    FZ_SCOPEGUARD([base] {
+        WRITE(base + DC_COM_CMU_LUT1_READ, 0);
+        WRITE(base + DC_COM_CMU_LUT2_READ, 0);
+    });
+
+    for (std::uint32_t n = 0; n < num_blocks; ++n) {
+        auto block = shadow.lut_cursor;
+        shadow.lut_cursor = (shadow.lut_cursor + 1) % NumLutBlocks;
+
+        auto hash = lut_hash_seed;
+        for (std::size_t j = block * LutBlockSize; j < (block + 1) * LutBlockSize; ++j) {
+            std::uint32_t val;
+            if (j < std::tuple_size_v<Lut1>) {
+                WRITE(base + DC_COM_CMU_LUT1_READ, LUT1_READ_ADDR(j) | LUT1_READ_EN);
+                val = LUT1_READ_DATA(READ(base + DC_COM_CMU_LUT1));
+            } else {
+                WRITE(base + DC_COM_CMU_LUT2_READ, LUT2_READ_ADDR(j - std::tuple_size_v<Lut1>) | LUT2_READ_EN);
+                val = LUT2_READ_DATA(READ(base + DC_COM_CMU_LUT2));
+            }
+            hash = hash_entry(hash, val);
+        }
+
+        if (hash != shadow.lut_hashes[block]) {
+            FZ_TRACE_EVENT(Event_LutMismatch, block);
+            shadow.has_luts = false;
+            return false;
+        }
+    }
+
+    return true;
+}
+
 Result DisplayController::set_hdmi_color_range(bool external, ColorRange range) const {
-    if (external)
+    if (external || this->is_lite)
         return 0;
 
     auto is_limited = [](const ColorRange &range) {
         return (range.lo >= MIN_LIMITED_RANGE) && (range.hi <= MAX_LIMITED_RANGE);
     };
 
+    std::uint32_t fd;
+    if (auto rc = this->get_fd(true, fd); R_FAILED(rc))
+        return rc;
+
     AviInfoframe infoframe;
-    if (auto rc = nvioctlNvDisp_GetAviInfoframe(this->disp1_fd, &infoframe); R_FAILED(rc))
+    if (auto rc = nvioctlNvDisp_GetAviInfoframe(fd, &infoframe); R_FAILED(rc))
         return rc;
 
     infoframe.rgb_quant = is_limited(range) ? RgbQuantRange::Limited : RgbQuantRange::Full;
 
-    if (auto rc = nvioctlNvDisp_SetAviInfoframe(this->disp1_fd, &infoframe); R_FAILED(rc))
+    if (auto rc = nvioctlNvDisp_SetAviInfoframe(fd, &infoframe); R_FAILED(rc))
         return rc;
 
     return 0;
@@ -21,85 +21,18 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
-#include <bit>
-#include <concepts>
 
 #include <switch.h>
 
 #include <common.hpp>
 
-namespace fz {
-
-// Represents a fixed-point fractional number
-template <bool Signed, std::size_t M, std::size_t N, typename Rep>
-struct Q {
-    constexpr static std::size_t Sign          = Signed;
-    constexpr static std::size_t Integer       = M;
-    constexpr static std::size_t Fractional    = N;
-
-    constexpr static std::size_t NbIntegerBits = Integer + Fractional;
-    constexpr static std::size_t NbBits        = Sign + NbIntegerBits;
-
-    constexpr static std::size_t BitMask       = (1 << NbBits) - 1;
-
-    using Underlying = Rep;
-
-    constexpr Q() = default;
-
-    template <typename T>
-    constexpr Q(T n) requires std::integral<T>:
-        rep(static_cast<Underlying>(n)) { }
-
-    template <typename T>
-    constexpr Q(T n) requires std::floating_point<T>:
-        rep(static_cast<Underlying>(n * static_cast<T>(1 << Fractional))) { }
-
-    template <typename T>
-    constexpr operator T() const requires std::integral<T> {
-        return this->rep;
-    }
-
-    template <typename T>
-    constexpr operator T() const requires std::floating_point<T> {
-        return (this->rep & (1 << NbIntegerBits) ? -1.0f : 1.0f) *
-            static_cast<T>(this->rep & ((1 << NbIntegerBits) - 1)) / static_cast<T>(1 << Fractional);
-    }
-
-    private:
-        Underlying rep = 0;
-};
-
-using QS18 = Q<true, 1, 8, std::int16_t>;
-static_assert(static_cast<float>(QS18(0x100))          == 1.0f);
-static_assert(static_cast<float>(QS18(-1.0f))          == -1.0f);
-static_assert(std::bit_cast<std::uint16_t>(QS18(1.0))  == 0x100);
-static_assert(std::bit_cast<std::uint16_t>(QS18(-1.0)) == 0xff00);
-
-struct Cmu {
-    __nv_in std::uint16_t enable;
-
-    __nv_in QS18 krr, kgr, kbr,
-                 krg, kgg, kbg,
-                 krb, kgb, kbb;
-
-    __nv_in std::array<std::uint16_t, 256> lut_1;
-    __nv_in std::array<std::uint16_t, 960> lut_2;
-
-    __nv_out std::uint16_t csc_modified;
-    __nv_out std::uint16_t lut1_modified;
-    __nv_out std::uint16_t lut2_modified;
+#include "t210_regs.hpp"
+#include "trace.hpp"
 
-    constexpr Cmu(bool enable = true, QS18 krr = 1.0, QS18 kgg = 1.0, QS18 kbb = 1.0):
-        enable(enable), krr(krr), kgg(kgg), kbb(kbb) { }
-
-    template <typename ...Args>
-    inline void reset(Args &&...args) {
-        new (this) Cmu(std::forward<Args>(args)...);
-    }
-};
-ASSERT_SIZE(Cmu, 2458);
+namespace fz {
 
 static inline Result nvioctlNvDisp_SetCmu(u32 fd, Cmu *cmu) {
+    FZ_TRACE_SCOPE(Event_IoctlSetCmu, fd);
     return nvIoctl(fd, _NV_IOWR(2, 14, Cmu), cmu);
 }
 
@@ -136,10 +69,12 @@ struct AviInfoframe {
 ASSERT_SIZE(AviInfoframe, 96);
 
 static inline Result nvioctlNvDisp_GetAviInfoframe(u32 fd, AviInfoframe *infoframe) {
+    FZ_TRACE_SCOPE(Event_IoctlGetAviInfoframe, fd);
     return nvIoctl(fd, _NV_IOR(2, 16, AviInfoframe), infoframe);
 }
 
 static inline Result nvioctlNvDisp_SetAviInfoframe(u32 fd, AviInfoframe *infoframe) {
+    FZ_TRACE_SCOPE(Event_IoctlSetAviInfoframe, fd);
     return nvIoctl(fd, _NV_IOW(2, 17, AviInfoframe), infoframe);
 }
 
@@ -149,27 +84,96 @@ class DisplayController {
         using Lut1 = std::array<std::uint16_t, 256>;
         using Lut2 = std::array<std::uint8_t,  960>;
 
-        // Lut1 and Lut2 ignored since they cannot be read back directly from registers
+        // The LUTs are read back through an indexed register, one entry per access. They are verified against hashes
+        // of blocks of entries (LUT1 then LUT2), a few blocks at a time
+        constexpr static std::size_t LutBlockSize = 16,
+            NumLutBlocks = (std::tuple_size_v<Lut1> + std::tuple_size_v<Lut2>) / LutBlockSize;
+        constexpr static std::uint32_t DefaultLutVerifyBlocks = 2;
+
+        using LutHashes = std::array<std::uint32_t, NumLutBlocks>;
+
+        // The hashes of the LUTs last committed through nvdrv are kept, to only commit CSC changes.
+        // A bypassed CMU is expected to stay disabled, and its other fields are meaningless
         struct CmuShadow {
             Csc csc;
+            bool is_bypassed;
+            bool has_luts;
+            LutHashes lut_hashes;
+            std::uint32_t lut_cursor; // Next block to verify
+        };
+
+        // CMU kept between commits, with the LUT2 at the 8-bit width of its registers (nvdrv pads it to 16 bits)
+        struct CompactCmu {
+            std::array<QS18, 9> csc;
+            Lut1 lut_1;
+            Lut2 lut_2;
+        };
+
+        // CMU calculated for the held settings of a profile. Those only change with a new compilation of its timeline
+        // or another segment of it, which identify the CMU without comparing settings
+        struct PreparedCmu {
+            bool valid;
+            std::uint32_t generation, segment;
+            bool is_identity;
+            CompactCmu cmu;
+
+            bool holds(std::uint32_t generation, std::uint32_t segment) const {
+                return this->valid && this->generation == generation && this->segment == segment;
+            }
         };
 
     public:
-        Result initialize() {
-            return nvOpen(&this->disp0_fd, "/dev/nvdisp-disp0") || nvOpen(&this->disp1_fd, "/dev/nvdisp-disp1");
-        }
+        // DISPLAY_B is only opened on use on the Lite, which has no video output
+        Result initialize(bool is_lite);
 
         Result finalize() const {
-            return nvClose(this->disp0_fd) || nvClose(this->disp1_fd);
+            return nvClose(this->disp0_fd) || (this->has_disp1 ? nvClose(this->disp1_fd) : 0);
         }
 
+        // Commits go through a single nvdrv buffer, callers serialize them (see ProfileManager::commit_mutex)
         Result disable(bool external) const;
-        Result apply_color_profile(bool external, FizeauSettings &settings,
-            Component components, Component filter, CmuShadow &shadow) const;
+        // Calculates the CMU into prepared, which the caller then keys
+        void prepare_cmu(const FizeauSettings &settings, Component components, Component filter,
+            PreparedCmu &prepared) const;
+
+        // The CSC of the committed CMU is scaled by csc_scale, which dims linear light without recalculating the LUTs.
+        // When the LUTs on the display are already those of the CMU, only the CSC is staged and released on vblank.
+        // Otherwise nvdrv programs the LUTs right away, mid-frame: the LUTs have no latched copy to stage them in.
+        // An identity CMU is not committed, the display CMU is disabled instead
+        Result apply_color_profile(bool external, const PreparedCmu &prepared, float csc_scale, CmuShadow &shadow) const;
+        // Same, for settings that are not kept (transitions, ambient offsets), calculated for this commit only
+        Result apply_color_profile(bool external, const FizeauSettings &settings, Component components, Component filter,
+            float csc_scale, CmuShadow &shadow) const;
         Result set_hdmi_color_range(bool external, ColorRange range) const;
 
+        // Reads back the next num_blocks blocks of the LUTs of a running head with the CMU enabled.
+        // Returns false on a mismatch, after which the LUTs are committed again on the next apply
+        bool verify_luts(bool external, CmuShadow &shadow, std::uint32_t num_blocks) const;
+
+    private:
+        // Commits the CSC coefficients and LUTs of a CMU, from either layout
+        template <typename Lut2Array>
+        Result commit(bool external, const QS18 *coeffs, const Lut1 &lut_1, const Lut2Array &lut_2, bool is_identity,
+            float csc_scale, CmuShadow &shadow) const;
+
+        // Writes the CSC to the registers of a running display and requests its activation, which the display
+        // controller latches at the start of the next frame, without waiting for it. Returns false if the display
+        // is not running
+        bool stage_csc(bool external, const Csc &csc) const;
+
+        template <typename Lut2Array>
+        static void hash_luts(const Lut1 &lut_1, const Lut2Array &lut_2, LutHashes &hashes);
+
+        Result get_fd(bool external, std::uint32_t &fd) const;
+
     private:
-        std::uint32_t disp0_fd, disp1_fd;
+        bool is_lite = false;
+        std::uint32_t disp0_fd = 0;
+        mutable std::uint32_t disp1_fd = 0;
+        mutable bool has_disp1 = false;
+        std::uint64_t clock_va_base = 0, disp_va_base = 0;
+
+        mutable Cmu cmu_buffer; // nvdrv layout, for the ioctl and the calculation
 };
 
 } // namespace fz
@@ -16,6 +16,7 @@
 // along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cmath>
+#include <algorithm>
 #include <chrono>
 #include <switch.h>
 
@@ -24,6 +25,7 @@
 
 #include "t210_regs.hpp"
 #include "nvdisp.hpp"
+#include "trace.hpp"
 
 #include "profile.hpp"
 
@@ -35,153 +37,275 @@ namespace {
 
 constexpr std::uint32_t ins_evt_id = 0;
 
-FizeauSettings interpolate_profile(FizeauProfile &in, float factor, bool from_day) {
-    FizeauSettings out,
-        &from =  from_day ? in.day_settings : in.night_settings,
-        &to   = !from_day ? in.day_settings : in.night_settings;
-
-    out = {
-        .temperature     = static_cast<Temperature>(std::lerp(from.temperature, to.temperature, factor)),
-        .saturation      = std::lerp(from.saturation, to.saturation, factor),
-        .hue             = std::lerp(from.hue,        to.hue,        factor),
-        .contrast        = std::lerp(from.contrast,   to.contrast,   factor),
-        .gamma           = std::lerp(from.gamma,      to.gamma,      factor),
-        .luminance       = std::lerp(from.luminance,  to.luminance,  factor),
-        .range           = {
-                           std::lerp(from.range.lo,   to.range.lo,   factor),
-                           std::lerp(from.range.hi,   to.range.hi,   factor),
-        },
-    };
+// Resynchronization period of the clock while a profile follows the sun, to pick up time zone changes
+constexpr std::uint64_t clock_sync_period = std::chrono::nanoseconds(1min).count();
+
+// Kept out of ProfileManager, whose members would otherwise be padded to the page alignment of the stacks
+// The transition thread calculates whole CMUs, at the end of fades and along transitions
+alignas(0x1000) constinit std::uint8_t transition_thread_stack[0x2000] = {}, event_monitor_thread_stack[0x1000] = {};
 
-    return out;
+// Linear light gain of the output at a luminance. calculate_cmu scales the LUT2 by the luminance,
+// then once more as it fits the color range below the scaled maximum
+float luma_gain(const FizeauSettings &settings, float luminance) {
+    auto gain = std::clamp(1.0f + luminance, 0.0f, 2.0f);
+    auto hi = std::min({ settings.range.hi, gain, 1.0f }), lo = std::clamp(settings.range.lo, 0.0f, hi);
+    return gain * (hi - lo);
 }
 
 } // namespace
 
-void ProfileManager::transition_thread_func(void *args) {
-    auto *self = static_cast<ProfileManager *>(args);
+std::uint64_t ProfileManager::update_transition() {
+    FZ_TRACE_EVENT(Event_TransitionWakeup);
 
-    UTimer timer;
-    utimerCreate(&timer, std::chrono::nanoseconds(100ms).count(), TimerType_Repeating);
-    utimerStart(&timer);
+    mutexLock(&this->context.mutex);
+    FZ_SCOPEGUARD([this] { mutexUnlock(&this->context.mutex); });
 
-    while (true) {
-        int idx;
-        auto rc = waitMulti(&idx, UINT64_MAX,
-            waiterForUTimer(&timer),
-            waiterForUEvent(&self->thread_exit_event));
-        if (R_FAILED(rc))
-            return;
+    if (!this->context.is_active)
+        return 0;
 
-        switch (idx) {
-            case 0:
-                break;
-            case 1:
-            default:
-                return;
-        }
+    bool need_apply = false, is_handheld = this->operation_mode == AppletOperationMode_Handheld;
+    std::uint64_t delay = 0;
 
-        if (!self->context.is_active)
-            continue;
+    // Solar times, recomputed on a new date or time zone
+    if (auto tick = armGetSystemTick(); tick >= this->clock_sync_tick) {
+        this->clock_sync_tick = tick + armNsToTicks(clock_sync_period);
+        if (this->context.has_location())
+            Clock::initialize();
+    }
 
-        bool need_apply = false, is_handheld = self->operation_mode == AppletOperationMode_Handheld;
+    need_apply = this->context.update_solar_day(Clock::get_current_day(), Clock::get_utc_offset());
 
-        // CMU resets
-        if (!need_apply) {
-            if (!(READ(self->clock_va_base + CLK_RST_CONTROLLER_CLK_OUT_ENB_L) & (CLK_ENB_DISP1 | CLK_ENB_DISP2)) ||
-                    !mutexTryLock(&self->commit_mutex))
-                goto cmu_end;
+    // CMU resets
+    if (!need_apply) {
+        FZ_TRACE_SCOPE(Event_MmioScan, is_handheld);
+
+        if (!(READ(this->clock_va_base + CLK_RST_CONTROLLER_CLK_OUT_ENB_L) & (CLK_ENB_DISP1 | CLK_ENB_DISP2)) ||
+                !mutexTryLock(&this->commit_mutex))
+            goto cmu_end;
 
-            FZ_SCOPEGUARD([self] { mutexUnlock(&self->commit_mutex); });
+        FZ_SCOPEGUARD([this] { mutexUnlock(&this->commit_mutex); });
 
-            // Poll DISPLAY_A in handheld mode, DISPLAY_B in docked mode
-            std::uint64_t iobase = self->disp_va_base + (is_handheld ? 0 : 0x40000);
+        // Poll DISPLAY_A in handheld mode, DISPLAY_B in docked mode
+        std::uint64_t iobase = this->disp_va_base + (is_handheld ? 0 : 0x40000);
 
-            auto &shadow = is_handheld ? self->context.cmu_shadow_internal : self->context.cmu_shadow_external;
-            auto &csc    = shadow.csc;
+        auto &shadow = is_handheld ? this->context.cmu_shadow_internal : this->context.cmu_shadow_external;
+        auto &csc    = shadow.csc;
+
+        // Resets leave a bypassed CMU disabled, only something else enabling it needs to be undone
+        if (shadow.is_bypassed) {
+            need_apply = READ(iobase + DC_DISP_DISP_COLOR_CONTROL) & CMU_ENABLE;
+            goto cmu_end;
+        }
 
-            // There is a race when waking from reset, where the configuration
-            // sometimes gets applied before nvdrv internally disables the CMU
-            if (!(READ(iobase + DC_DISP_DISP_COLOR_CONTROL) & CMU_ENABLE)) {
+        // There is a race when waking from reset, where the configuration
+        // sometimes gets applied before nvdrv internally disables the CMU
+        if (!(READ(iobase + DC_DISP_DISP_COLOR_CONTROL) & CMU_ENABLE)) {
+            need_apply = true;
+            goto cmu_end;
+        }
+
+        for (std::size_t i = 0; i < csc.size(); ++i) {
+            if (csc[i] != READ(iobase + DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t))) {
                 need_apply = true;
                 goto cmu_end;
             }
-
-            for (std::size_t i = 0; i < csc.size(); ++i) {
-                if (csc[i] != READ(iobase + DC_COM_CMU_CSC_KRR + i * sizeof(std::uint32_t))) {
-                    need_apply = true;
-                    goto cmu_end;
-                }
-            }
         }
 
-cmu_end:
-        auto profile_id = is_handheld ? self->context.internal_profile : self->context.external_profile;
-        if (profile_id >= FizeauProfileId_Total)
-            continue;
-
-        auto &profile = self->context.profiles      [profile_id];
-        auto &state   = self->context.profile_states[profile_id];
+        // Partial resets and foreign writes to the LUTs, caught within a full rotation
+        need_apply = !this->disp.verify_luts(!is_handheld, shadow, this->context.lut_verify_blocks);
+    }
 
-        // Period transitions
-        if (!need_apply) {
-            auto dub = to_timestamp(profile.dusk_begin), due = to_timestamp(profile.dusk_end),
-                 dab = to_timestamp(profile.dawn_begin), dae = to_timestamp(profile.dawn_end);
+cmu_end:
+    // Keep the CMUs of application profiles ready, so that switching to them only takes a commit
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id) {
+        if (this->context.app_profile_mask & BIT(id))
+            this->prepare(static_cast<FizeauProfileId>(id));
+    }
 
-            auto ts = Clock::get_current_timestamp();
-            if (ts >= due)
-                need_apply = state == FizeauProfileState::Day;
-            else if (ts >= dub)
-                need_apply = true;
-            else if (ts >= dae)
-                need_apply = state == FizeauProfileState::Night;
-            else if (ts >= dab)
-                need_apply = true;
+    auto profile_id = this->context.get_profile(!is_handheld);
+    if (profile_id >= FizeauProfileId_Total)
+        return 0;
 
-            // Increase next timeout to avoid calculating/applying the coefficients too frequently
-            if (need_apply)
-                timer.next_tick += armNsToTicks(std::chrono::nanoseconds(1s).count());
-        }
+    auto &profile  = this->context.profiles        [profile_id];
+    auto &timeline = this->context.timelines       [profile_id];
+    auto &segment  = this->context.profile_segments[profile_id];
 
-        // Dimming
-        if (!need_apply) {
-            std::uint64_t timeout = to_timestamp(profile.dimming_timeout),
-                delta = armTicksToNs(armGetSystemTick() - self->activity_tick) / std::chrono::nanoseconds(1s).count();
+    // Ambient light, which only concerns the internal panel
+    if (this->has_light_sensor && is_handheld && has_ambient_offsets(profile)) {
+        if (auto tick = armGetSystemTick(); tick >= this->ambient_sample_tick) {
+            this->ambient_sample_tick = tick + armNsToTicks(AmbientLightFilter::SamplePeriod);
 
-            if (
-                (!self->is_dimming && delta >  timeout) ||
-                ( self->is_dimming && delta <= timeout)
-            )
+            bool over_limit;
+            float lux;
+            if (R_SUCCEEDED(lblGetAmbientLightSensorValue(&over_limit, &lux)) &&
+                    this->ambient.update(over_limit ? AmbientLightFilter::BrightLux : lux, armTicksToNs(tick))) {
+                FZ_TRACE_EVENT(Event_AmbientChange, static_cast<std::uint16_t>(this->ambient.get_level() * 100));
                 need_apply = true;
+            }
         }
+    }
+
+    // Transitions, and the first poll into a segment to land on its exact settings
+    if (!need_apply) {
+        auto cur = timeline.find(Clock::get_current_timestamp());
+        need_apply = timeline.is_transition(cur) || cur != segment;
 
+        // Increase next timeout to avoid calculating/applying the coefficients too frequently
         if (need_apply)
-            self->apply();
+            delay = std::chrono::nanoseconds(1s).count();
+    }
+
+    // Dimming, and the steps of its fade
+    if (!need_apply) {
+        std::uint64_t timeout = to_timestamp(profile.dimming_timeout),
+            delta = armTicksToNs(armGetSystemTick() - this->activity_tick) / std::chrono::nanoseconds(1s).count();
+
+        // Same condition as should_dim in apply(), a null timeout disables dimming
+        if (timeout && (
+            (!this->is_dimming && delta >= timeout) ||
+            ( this->is_dimming && delta <  timeout)
+        ))
+            need_apply = true;
+        else if (this->is_dimming && this->dim_level < 1.0f)
+            need_apply = true;
     }
+
+    if (need_apply)
+        this->apply();
+
+    return delay;
 }
 
-void ProfileManager::event_monitor_thread_func(void *args) {
+void ProfileManager::update_operation_mode() {
+    mutexLock(&this->context.mutex);
+    FZ_SCOPEGUARD([this] { mutexUnlock(&this->context.mutex); });
+
+    ommGetOperationMode(&this->operation_mode);
+    FZ_TRACE_EVENT(Event_OperationModeChange, this->operation_mode);
+}
+
+void ProfileManager::update_activity() {
+    mutexLock(&this->context.mutex);
+    FZ_SCOPEGUARD([this] { mutexUnlock(&this->context.mutex); });
+
+    insrGetLastTick(ins_evt_id, &this->activity_tick);
+    FZ_TRACE_EVENT(Event_Activity);
+
+    // Undim right away, cancelling any fade, rather than on the next poll
+    if (this->is_dimming)
+        this->apply();
+}
+
+void ProfileManager::update_application() {
+    // Events only signal a change, drain them and look up the application currently running
+    PmProcessEventInfo info;
+    for (int i = 0; i < 0x10; ++i) {
+        if (R_FAILED(pglEventObserverGetProcessEventInfo(&this->process_observer, &info)) || info.event == PmProcessEvent_None)
+            break;
+    }
+
+    std::uint64_t pid, program_id = 0;
+    if (R_SUCCEEDED(pmdmntGetApplicationProcessId(&pid)))
+        pminfoGetProgramId(&program_id, pid);
+
+    // Erasing shifts the entries of the table back, which a lookup must not run through
+    mutexLock(&this->context.mutex);
+    FZ_SCOPEGUARD([this] { mutexUnlock(&this->context.mutex); });
+
+    auto id = this->context.app_profiles.find(program_id);
+    FZ_TRACE_EVENT(Event_ApplicationChange, id);
+
+    if (std::exchange(this->context.app_profile, id) != id)
+        this->apply();
+}
+
+void ProfileManager::prepare(FizeauProfileId id) {
+    if (this->context.is_displayed(id))
+        return;
+
+    auto ts = Clock::get_current_timestamp();
+    auto &timeline = this->context.timelines[id];
+    auto segment = timeline.find(ts);
+
+    // Settings change continuously through transitions, these are calculated on the switch
+    if (timeline.is_transition(segment) ||
+            this->context.prepared_cmus[id].holds(this->context.timeline_generations[id], segment))
+        return;
+
+    mutexLock(&this->commit_mutex);
+    FZ_SCOPEGUARD([this] { mutexUnlock(&this->commit_mutex); });
+
+    this->prepare_cmu(id, segment, timeline.evaluate(ts, segment));
+}
+
+const DisplayController::PreparedCmu &ProfileManager::prepare_cmu(FizeauProfileId id, std::uint32_t segment,
+        const FizeauSettings &settings) {
+    auto &prepared = this->context.prepared_cmus[id];
+    auto generation = this->context.timeline_generations[id];
+    if (prepared.holds(generation, segment))
+        return prepared;
+
+    auto &profile = this->context.profiles[id];
+    this->disp.prepare_cmu(settings, profile.components, profile.filter, prepared);
+    prepared.generation = generation, prepared.segment = segment;
+    return prepared;
+}
+
+void ProfileManager::transition_thread_func(void *args) {
     auto *self = static_cast<ProfileManager *>(args);
 
+    UTimer timer;
+    utimerCreate(&timer, std::chrono::nanoseconds(100ms).count(), TimerType_Repeating);
+    utimerStart(&timer);
+
     while (true) {
         int idx;
         auto rc = waitMulti(&idx, UINT64_MAX,
-            waiterForEvent(&self->operation_mode_event),
-            waiterForEvent(&self->activity_event),
+            waiterForUTimer(&timer),
             waiterForUEvent(&self->thread_exit_event));
         if (R_FAILED(rc))
             return;
 
         switch (idx) {
-            case 0: {
-                ommGetOperationMode(&self->operation_mode);
+            case 0:
                 break;
-            }
-            case 1: {
-                insrGetLastTick(ins_evt_id, &self->activity_tick);
+            case 1:
+            default:
+                return;
+        }
+
+        if (auto delay = self->update_transition(); delay)
+            timer.next_tick += armNsToTicks(delay);
+    }
+}
+
+void ProfileManager::event_monitor_thread_func(void *args) {
+    auto *self = static_cast<ProfileManager *>(args);
+
+    Waiter waiters[] = {
+        waiterForUEvent(&self->thread_exit_event),
+        waiterForEvent(&self->operation_mode_event),
+        waiterForEvent(&self->activity_event),
+        waiterForEvent(&self->process_event),
+    };
+
+    while (true) {
+        int idx;
+        auto rc = waitObjects(&idx, waiters, std::size(waiters) - !self->has_process_observer, UINT64_MAX);
+        if (R_FAILED(rc))
+            return;
+
+        switch (idx) {
+            case 1:
+                self->update_operation_mode();
                 break;
-            }
             case 2:
+                self->update_activity();
+                break;
+            case 3:
+                self->update_application();
+                break;
+            case 0:
             default:
                 return;
         }
@@ -189,6 +313,13 @@ void ProfileManager::event_monitor_thread_func(void *args) {
 }
 
 Result ProfileManager::initialize() {
+    this->context.solar_day        = Clock::get_current_day();
+    this->context.solar_utc_offset = Clock::get_utc_offset();
+    this->clock_sync_tick          = armGetSystemTick() + armNsToTicks(clock_sync_period);
+
+    for (int id = FizeauProfileId_Profile1; id < FizeauProfileId_Total; ++id)
+        this->context.compile_timeline(static_cast<FizeauProfileId>(id));
+
     std::uint64_t size;
     if (auto rc = svcQueryMemoryMapping(&this->clock_va_base, &size, CLOCK_IO_BASE, CLOCK_IO_SIZE); R_FAILED(rc))
         diagAbortWithResult(rc);
@@ -208,18 +339,37 @@ Result ProfileManager::initialize() {
     if (auto rc = insrGetLastTick(ins_evt_id, &this->activity_tick); R_FAILED(rc))
         diagAbortWithResult(rc);
 
+    // Applications keep the handheld/docked profiles when process events are unavailable
+    if (R_SUCCEEDED(pglGetEventObserver(&this->process_observer))) {
+        this->has_process_observer = R_SUCCEEDED(pglEventObserverGetProcessEvent(&this->process_observer, &this->process_event));
+        if (!this->has_process_observer)
+            pglEventObserverClose(&this->process_observer);
+    }
+
+    // Ambient light is not followed without a sensor, otherwise start from the current level
+    if (R_FAILED(lblIsAmbientLightSensorAvailable(&this->has_light_sensor)))
+        this->has_light_sensor = false;
+
+    bool over_limit;
+    float lux;
+    if (this->has_light_sensor && R_SUCCEEDED(lblGetAmbientLightSensorValue(&over_limit, &lux)))
+        this->ambient.update(over_limit ? AmbientLightFilter::BrightLux : lux, armTicksToNs(armGetSystemTick()));
+
     ueventCreate(&this->thread_exit_event, false);
 
+    FZ_TRACE_STACK(Stack_EventMonitor, event_monitor_thread_stack, sizeof(event_monitor_thread_stack));
+    FZ_TRACE_STACK(Stack_Transition,   transition_thread_stack,    sizeof(transition_thread_stack));
+
     // The event monitor thread should have a higher priority than the transition thread to ensure it wins on mutex races
     if (auto rc = threadCreate(&this->event_monitor_thread, &ProfileManager::event_monitor_thread_func, this,
-            this->event_monitor_thread_stack, sizeof(this->event_monitor_thread_stack), 0x3d, -2); R_FAILED(rc))
+            event_monitor_thread_stack, sizeof(event_monitor_thread_stack), 0x3d, -2); R_FAILED(rc))
         diagAbortWithResult(rc);
 
     if (auto rc = threadStart(&this->event_monitor_thread); R_FAILED(rc))
         diagAbortWithResult(rc);
 
     if (auto rc = threadCreate(&this->transition_thread, &ProfileManager::transition_thread_func, this,
-            this->transition_thread_stack, sizeof(this->transition_thread_stack), 0x3e, -2); R_FAILED(rc))
+            transition_thread_stack, sizeof(transition_thread_stack), 0x3e, -2); R_FAILED(rc))
         diagAbortWithResult(rc);
 
     if (auto rc = threadStart(&this->transition_thread); R_FAILED(rc))
@@ -238,6 +388,11 @@ Result ProfileManager::finalize() {
 
     eventClose(&this->operation_mode_event);
 
+    if (this->has_process_observer) {
+        eventClose(&this->process_event);
+        pglEventObserverClose(&this->process_observer);
+    }
+
     return 0;
 }
 
@@ -245,37 +400,45 @@ Result ProfileManager::apply() {
     if (!this->context.is_active)
         return 0;
 
-    auto apply_profile = [this](FizeauProfileId profile_id, bool dim, bool external) -> Result {
-        auto &profile = this->context.profiles      [profile_id];
-        auto &state   = this->context.profile_states[profile_id];
+    FZ_TRACE_SCOPE(Event_Apply);
 
-        FizeauSettings settings;
-
-        auto dub = to_timestamp(profile.dusk_begin), due = to_timestamp(profile.dusk_end),
-             dab = to_timestamp(profile.dawn_begin), dae = to_timestamp(profile.dawn_end);
+    auto apply_profile = [this](FizeauProfileId profile_id, bool dim, bool external) -> Result {
+        auto &profile = this->context.profiles[profile_id];
 
         auto ts = Clock::get_current_timestamp();
-        if (Clock::is_in_interval(ts, dub, due)) {
-            float factor = static_cast<float>(due - ts) / static_cast<float>(due - dub);
-            settings = interpolate_profile(profile, factor, false);
-            state    = FizeauProfileState::Night;
-        } else if (Clock::is_in_interval(ts, dab, dae)) {
-            float factor = static_cast<float>(dae - ts) / static_cast<float>(dae - dab);
-            settings = interpolate_profile(profile, factor, true);
-            state    = FizeauProfileState::Day;
-        } else if (Clock::is_in_interval(ts, dae, dub)) {
-            settings = profile.day_settings;
-            state    = FizeauProfileState::Day;
-        } else {
-            settings = profile.night_settings;
-            state    = FizeauProfileState::Night;
+        auto &timeline = this->context.timelines[profile_id];
+        auto &segment  = this->context.profile_segments[profile_id];
+        segment = timeline.find(ts);
+        auto settings = timeline.evaluate(ts, segment);
+
+        // Held settings are committed from the prepared CMU of the profile, others are calculated for the commit
+        bool is_held = !timeline.is_transition(segment);
+        if (!external && has_ambient_offsets(profile)) {
+            apply_ambient_offsets(settings, profile, this->ambient.get_level());
+            is_held = false;
         }
 
-        if (dim)
-            settings.luminance = !external ? dimmed_luma_internal : dimmed_luma_external;
+        // Dimming lowers the luminance, which scales the output of the LUT2. The steps of the fade approach the same
+        // gain by scaling linear light in the CSC by its power of gamma, so that they reuse the prepared LUTs.
+        // This only holds while the range leaves no offset, so the end of the fade commits the dimmed CMU itself.
+        // Scaling up would clip in the CSC, profiles darker than the dimmed level are raised to it in one step
+        float csc_scale = 1.0f;
+        if (dim) {
+            auto dimmed = !external ? dimmed_luma_internal : dimmed_luma_external;
+            auto ratio  = luma_gain(settings, dimmed) / std::max(luma_gain(settings, settings.luminance), 1e-3f);
+            if (this->dim_level < 1.0f && ratio < 1.0f) {
+                csc_scale = std::pow(1.0f + (ratio - 1.0f) * this->dim_level, std::max(settings.gamma, 1.0f));
+            } else {
+                settings.luminance = dimmed;
+                is_held = false;
+            }
+        }
 
         auto &shadow = !external ? this->context.cmu_shadow_internal : this->context.cmu_shadow_external;
-        if (auto rc = this->disp.apply_color_profile(external, settings, profile.components, profile.filter, shadow); R_FAILED(rc))
+        if (auto rc = is_held ?
+                this->disp.apply_color_profile(external, this->prepare_cmu(profile_id, segment, settings), csc_scale, shadow) :
+                this->disp.apply_color_profile(external, settings, profile.components, profile.filter, csc_scale, shadow);
+                R_FAILED(rc))
             return rc;
 
         if (auto rc = this->disp.set_hdmi_color_range(external, settings.range); R_FAILED(rc))
@@ -293,22 +456,31 @@ Result ProfileManager::apply() {
     };
 
     auto timeout = armTicksToNs(armGetSystemTick() - this->activity_tick) / 1'000'000'000;
-    bool should_dim_internal = should_dim(this->context.internal_profile, timeout);
-    bool should_dim_external = should_dim(this->context.external_profile, timeout);
+    auto internal_profile = this->context.get_profile(false), external_profile = this->context.get_profile(true);
+    bool should_dim_internal = should_dim(internal_profile, timeout);
+    bool should_dim_external = should_dim(external_profile, timeout);
 
     auto is_handheld = this->operation_mode == AppletOperationMode_Handheld;
     this->is_dimming = is_handheld ? should_dim_internal : should_dim_external;
 
+    this->dim_level = 0.0f;
+    if (this->is_dimming) {
+        auto &profile = this->context.profiles[is_handheld ? internal_profile : external_profile];
+        auto due = this->activity_tick + armNsToTicks(to_timestamp(profile.dimming_timeout) * 1'000'000'000ull);
+        auto elapsed = armTicksToNs(armGetSystemTick() - std::min(due, armGetSystemTick())) / 1e6f; // ms
+        this->dim_level = profile.dimming_fade ? std::min(elapsed / profile.dimming_fade, 1.0f) : 1.0f;
+    }
+
     mutexLock(&this->commit_mutex);
     FZ_SCOPEGUARD([this] { mutexUnlock(&this->commit_mutex); });
 
-    if (this->context.internal_profile < FizeauProfileId_Total) {
-        if (auto rc = apply_profile(this->context.internal_profile, should_dim_internal, false); R_FAILED(rc))
+    if (internal_profile < FizeauProfileId_Total) {
+        if (auto rc = apply_profile(internal_profile, should_dim_internal, false); R_FAILED(rc))
             return rc;
     }
 
-    if (this->context.external_profile < FizeauProfileId_Total && !this->context.is_lite) {
-        if (auto rc = apply_profile(this->context.external_profile, should_dim_external, true); R_FAILED(rc))
+    if (external_profile < FizeauProfileId_Total && !this->context.is_lite) {
+        if (auto rc = apply_profile(external_profile, should_dim_external, true); R_FAILED(rc))
             return rc;
     }
 
@@ -319,6 +491,9 @@ Result ProfileManager::update_active() {
     if (this->context.is_active) {
         return this->apply();
     } else {
+        mutexLock(&this->commit_mutex);
+        FZ_SCOPEGUARD([this] { mutexUnlock(&this->commit_mutex); });
+
         if (auto rc = this->disp.disable(false); R_FAILED(rc))
             return rc;
 
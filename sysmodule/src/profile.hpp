@@ -22,6 +22,7 @@
 
 #include <common.hpp>
 
+#include "ambient.hpp"
 #include "context.hpp"
 #include "nvdisp.hpp"
 
@@ -36,10 +37,25 @@ class ProfileManager {
         Result initialize();
         Result finalize();
 
+        // Called with the context mutex held
         Result apply();
         Result update_active();
 
+        // Calculates ahead the CMU of a profile set for applications, if its settings are currently held
+        void prepare(FizeauProfileId id);
+
+        // Bodies of the worker threads, also driven directly by the host simulator. These take the context mutex
+        // update_transition returns a delay to add before the next poll, in ns
+        std::uint64_t update_transition();
+        void update_operation_mode();
+        void update_activity();
+        void update_application();
+
     private:
+        // CMU of the held settings of a profile in a segment, calculated unless it already is. Needs the commit mutex
+        const DisplayController::PreparedCmu &prepare_cmu(FizeauProfileId id, std::uint32_t segment,
+            const FizeauSettings &settings);
+
         static void transition_thread_func(void *args);
         static void event_monitor_thread_func(void *args);
 
@@ -51,15 +67,28 @@ class ProfileManager {
 
         UEvent thread_exit_event = {};
         Thread transition_thread = {}, event_monitor_thread = {};
-        std::uint8_t transition_thread_stack[0x2000] alignas(0x1000) = {},
-            event_monitor_thread_stack[0x1000] alignas(0x1000) = {};
 
         Event operation_mode_event = {};
         AppletOperationMode operation_mode = {};
 
         Event activity_event = {};
         std::uint64_t activity_tick = {};
+
+        // Dimming fades in from the moment it is due, and is lifted at once
         bool is_dimming = false;
+        float dim_level = 0.0f; // From 0 (undimmed) to 1 (fully dimmed)
+
+        // Process launches and exits, unavailable before 10.0.0
+        PglEventObserver process_observer = {};
+        Event process_event = {};
+        bool has_process_observer = false;
+
+        // Sampled while a profile with ambient offsets is shown on the internal panel
+        AmbientLightFilter ambient = {};
+        std::uint64_t ambient_sample_tick = 0;
+        bool has_light_sensor = false;
+
+        std::uint64_t clock_sync_tick = 0;
 
         Mutex commit_mutex = {};
 };
@@ -22,6 +22,7 @@
 #include <common.hpp>
 
 #include "server.hpp"
+#include "trace.hpp"
 
 namespace fz {
 
@@ -30,9 +31,39 @@ namespace fz {
     *out_datasize = sizeof(v);                          \
 })
 
+namespace {
+
+// Commands that only read the context, answered while the sysmodule boots
+constexpr bool is_query(std::uint32_t cmd_id) {
+    switch (cmd_id) {
+        case FizeauCommandId_GetIsActive:
+        case FizeauCommandId_GetProfile:
+        case FizeauCommandId_GetActiveProfileId:
+        case FizeauCommandId_GetState:
+        case FizeauCommandId_GetVersionedProfile:
+        case FizeauCommandId_GetKeyframe:
+        case FizeauCommandId_GetAppProfile:
+        case FizeauCommandId_DumpTrace:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace
+
 Result Server::command_handler(void *userdata, const IpcServerRequest *r, u8 *out_data, size_t *out_datasize) {
     auto *self = static_cast<Server *>(userdata);
 
+    FZ_TRACE_SCOPE(Event_IpcDispatch, r->data.cmdId);
+
+    // Writes would be overwritten by the config once loaded, the dispatcher is shared by all sessions and doesn't wait
+    if (self->context.is_booting && !is_query(r->data.cmdId))
+        return FIZEAU_MAKERESULT(BUSY);
+
+    mutexLock(&self->context.mutex);
+    FZ_SCOPEGUARD([self] { mutexUnlock(&self->context.mutex); });
+
     switch (r->data.cmdId) {
         case FizeauCommandId_GetIsActive: {
             SET_OUTDATA(self->context.is_active);
@@ -60,8 +91,10 @@ Result Server::command_handler(void *userdata, const IpcServerRequest *r, u8 *ou
                 return FIZEAU_MAKERESULT(INVALID_PROFILEID);
 
             self->context.profiles[id] = *(FizeauProfile *)((std::uint8_t *)r->data.ptr + std::max(alignof(FizeauProfileId), alignof(FizeauProfile)));
+            ++self->context.profile_versions[id];
+            self->context.compile_timeline(id);
 
-            if (id == self->context.internal_profile || id == self->context.external_profile) {
+            if (self->context.is_displayed(id)) {
                 if (auto rc = self->profile.apply(); R_FAILED(rc))
                     return rc;
             }
@@ -86,6 +119,164 @@ Result Server::command_handler(void *userdata, const IpcServerRequest *r, u8 *ou
 
             break;
         }
+        case FizeauCommandId_GetState: {
+            static_assert(sizeof(FizeauState) <= IPC_SERVER_EXT_RESPONSE_MAX_DATA_SIZE);
+
+            auto external = *(bool *)r->data.ptr;
+            auto id = !external ? self->context.internal_profile : self->context.external_profile;
+            FizeauState state = {
+                .is_active        = self->context.is_active,
+                .internal_profile = self->context.internal_profile,
+                .external_profile = self->context.external_profile,
+            };
+
+            // No profile is set before one is configured, the state then holds none
+            if (id >= FizeauProfileId_Profile1 && id <= FizeauProfileId_Profile4)
+                state.profile = self->context.profiles[id], state.profile_version = self->context.profile_versions[id];
+
+            SET_OUTDATA(state);
+            break;
+        }
+        case FizeauCommandId_StageProfile: {
+            auto id = *(FizeauProfileId *)r->data.ptr;
+            if (id < FizeauProfileId_Profile1 || id > FizeauProfileId_Profile4)
+                return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+            self->context.profiles[id] = *(FizeauProfile *)((std::uint8_t *)r->data.ptr + std::max(alignof(FizeauProfileId), alignof(FizeauProfile)));
+            ++self->context.profile_versions[id];
+            self->context.compile_timeline(id);
+            break;
+        }
+        case FizeauCommandId_SetState: {
+            auto is_active = *(bool *)r->data.ptr;
+            auto *ids = (FizeauProfileId *)((std::uint8_t *)r->data.ptr + std::max(alignof(bool), alignof(FizeauProfileId)));
+            for (int i = 0; i < 2; ++i) {
+                if (ids[i] < FizeauProfileId_Profile1 || ids[i] > FizeauProfileId_Profile4)
+                    return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+            }
+
+            auto prev_active = std::exchange(self->context.is_active, is_active);
+            self->context.internal_profile = ids[0];
+            self->context.external_profile = ids[1];
+
+            // Single commit for everything changed since the last one, disabling is only needed on a transition
+            if (is_active || prev_active) {
+                if (auto rc = self->profile.update_active(); R_FAILED(rc))
+                    return rc;
+            }
+
+            break;
+        }
+        case FizeauCommandId_GetVersionedProfile: {
+            auto id = *(FizeauProfileId *)r->data.ptr;
+            if (id < FizeauProfileId_Profile1 || id > FizeauProfileId_Profile4)
+                return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+            struct {
+                std::uint32_t version;
+                FizeauProfile profile;
+            } out = { self->context.profile_versions[id], self->context.profiles[id] };
+            SET_OUTDATA(out);
+            break;
+        }
+        case FizeauCommandId_SetProfileIfVersion: {
+            struct In {
+                FizeauProfileId id;
+                std::uint32_t version;
+                FizeauProfile profile;
+            };
+            auto *in = (In *)r->data.ptr;
+            if (in->id < FizeauProfileId_Profile1 || in->id > FizeauProfileId_Profile4)
+                return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+
+            // A mismatch is reported in the output data rather than the result, so that the client gets the current version
+            auto &version = self->context.profile_versions[in->id];
+            struct {
+                bool written;
+                std::uint32_t version;
+            } out = { in->version == version, version };
+
+            if (out.written) {
+                self->context.profiles[in->id] = in->profile;
+                out.version = ++version;
+                self->context.compile_timeline(in->id);
+
+                if (self->context.is_displayed(in->id)) {
+                    if (auto rc = self->profile.apply(); R_FAILED(rc))
+                        return rc;
+                }
+            }
+
+            SET_OUTDATA(out);
+            break;
+        }
+        case FizeauCommandId_GetKeyframe: {
+            struct In {
+                FizeauProfileId id;
+                std::uint32_t index;
+            };
+            auto *in = (In *)r->data.ptr;
+            if (in->id < FizeauProfileId_Profile1 || in->id > FizeauProfileId_Profile4)
+                return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+            if (in->index >= FIZEAU_MAX_KEYFRAMES)
+                return FIZEAU_MAKERESULT(INVALID_KEYFRAME);
+
+            SET_OUTDATA(self->context.keyframes[in->id][in->index]);
+            break;
+        }
+        case FizeauCommandId_StageKeyframe: {
+            struct In {
+                FizeauProfileId id;
+                std::uint32_t index;
+                FizeauKeyframe keyframe;
+            };
+            auto *in = (In *)r->data.ptr;
+            if (in->id < FizeauProfileId_Profile1 || in->id > FizeauProfileId_Profile4)
+                return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+            if (in->index >= FIZEAU_MAX_KEYFRAMES)
+                return FIZEAU_MAKERESULT(INVALID_KEYFRAME);
+
+            // Compiled on the next write of the profile
+            self->context.keyframes[in->id][in->index] = in->keyframe;
+            break;
+        }
+        case FizeauCommandId_GetAppProfile: {
+            SET_OUTDATA(self->context.app_profiles.find(*(std::uint64_t *)r->data.ptr));
+            break;
+        }
+        case FizeauCommandId_SetAppProfile: {
+            struct In {
+                std::uint64_t program_id;
+                FizeauProfileId id;
+            };
+            auto *in = (In *)r->data.ptr;
+
+            // Takes effect on the next launch, the running application keeps its profile
+            if (in->id == FizeauProfileId_Invalid) {
+                self->context.app_profiles.erase(in->program_id);
+            } else {
+                if (in->id < FizeauProfileId_Profile1 || in->id > FizeauProfileId_Profile4)
+                    return FIZEAU_MAKERESULT(INVALID_PROFILEID);
+                if (!self->context.app_profiles.insert(in->program_id, in->id))
+                    return FIZEAU_MAKERESULT(TOO_MANY_APPS);
+                self->profile.prepare(in->id);
+            }
+
+            self->context.app_profile_mask = self->context.app_profiles.profile_mask();
+            break;
+        }
+        case FizeauCommandId_ClearAppProfiles: {
+            self->context.app_profiles.clear();
+            self->context.app_profile_mask = 0;
+            break;
+        }
+#ifdef FZ_TRACE
+        case FizeauCommandId_DumpTrace: {
+            if (auto rc = trace::dump(); R_FAILED(rc))
+                return rc;
+            break;
+        }
+#endif
         default:
             return MAKERESULT(10, 221);
     }
@@ -26,7 +26,9 @@ namespace fz {
 class Server: public IpcServer {
     public:
         constexpr static inline std::string_view ServiceName = "fizeau";
-        constexpr static inline int ServiceNumSessions = 2;
+        // The application, the overlay, and other tools querying the service can be connected at the same time.
+        // Can be raised up to IPC_SERVER_MAX_SESSIONS
+        constexpr static inline int ServiceNumSessions = 8;
 
     public:
         constexpr Server(Context &context, ProfileManager &profile): IpcServer(), context(context), profile(profile) { }
@@ -57,7 +59,6 @@ class Server: public IpcServer {
             }
         }
 
-    private:
         static Result command_handler(void *userdata, const IpcServerRequest *r, u8 *out_data, size_t *out_datasize);
 
     private:
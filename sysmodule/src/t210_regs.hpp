@@ -15,6 +15,8 @@
 // You should have received a copy of the GNU General Public License
 // along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
 
+#pragma once
+
 #include <cstdint>
 
 #define CLOCK_IO_BASE 0x60006000
@@ -47,6 +49,11 @@
 #define DISP_IO_BASE 0x54200000
 #define DISP_IO_SIZE (0x80000)
 
+#define DC_CMD_DISPLAY_COMMAND     0x0c8
+#   define DISP_CTRL_MODE_STOP     (0 << 5)
+#   define DISP_CTRL_MODE_C_DISP   (1 << 5)
+#   define DISP_CTRL_MODE_NC_DISP  (2 << 5)
+#   define DISP_CTRL_MODE_MASK     (3 << 5)
 #define DC_CMD_STATE_CONTROL       0x104
 #   define GENERAL_ACT_REQ         (1 <<  0)
 #   define WIN_A_ACT_REQ           (1 <<  1)
@@ -90,6 +97,16 @@
 #   define NON_BASE_COLOR          (1 << 18)
 #   define CMU_ENABLE              (1 << 20)
 
-#define READ(off)       (*reinterpret_cast<volatile std::uint32_t *>(off))
-#define WRITE(off, val) (*reinterpret_cast<volatile std::uint32_t *>(off) = val)
+#ifndef FZ_HOST
+#   define READ(off)       (*reinterpret_cast<volatile std::uint32_t *>(off))
+#   define WRITE(off, val) (*reinterpret_cast<volatile std::uint32_t *>(off) = val)
+#else
+// Host builds go through the MMIO backend, to model the side effects of indexed registers
+namespace fz::host {
+std::uint32_t mmio_read(std::uint64_t va);
+void mmio_write(std::uint64_t va, std::uint32_t val);
+} // namespace fz::host
+#   define READ(off)       (::fz::host::mmio_read(off))
+#   define WRITE(off, val) (::fz::host::mmio_write(off, val))
+#endif
 
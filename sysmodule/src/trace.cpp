@@ -0,0 +1,101 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstring>
+#include <algorithm>
+#include <switch.h>
+
+#include <common.hpp>
+
+#include "trace.hpp"
+
+#ifdef FZ_TRACE
+
+namespace fz::trace {
+
+constinit Ring ring = {};
+
+namespace {
+
+struct WatchedStack {
+    const std::uint8_t *mem;
+    std::size_t size;
+};
+
+constinit std::array<WatchedStack, Stack_Total> stacks = {};
+
+} // namespace
+
+void watch_stack(Stack id, const void *mem, std::size_t size) {
+    stacks[id] = { static_cast<const std::uint8_t *>(mem), size };
+}
+
+Result dump() {
+    // Snapshot the ring first, so that the entries we write out are not overwritten by the fs operations
+    static decltype(ring.entries) snapshot;
+    std::memcpy(snapshot.data(), ring.entries.data(), sizeof(snapshot));
+    auto head = ring.head.load(std::memory_order_relaxed);
+
+    DumpHeader header = {
+        .magic       = DumpMagic,
+        .version     = DumpVersion,
+        .entry_size  = sizeof(Entry),
+        .tick_freq   = armGetSystemTickFreq(),
+        .num_entries = NumEntries,
+        .head        = head,
+    };
+
+    for (std::size_t i = 0; i < stacks.size(); ++i) {
+        auto &[mem, size] = stacks[i];
+        auto *end = mem + size;
+        header.stacks[i] = {
+            .size = static_cast<std::uint32_t>(size),
+            .peak = static_cast<std::uint32_t>(end - std::find_if(mem, end, [](auto b) { return b != 0; })),
+        };
+    }
+
+    auto rc = fsInitialize();
+    if (R_FAILED(rc))
+        return rc;
+    FZ_SCOPEGUARD([] { fsExit(); });
+
+    FsFileSystem fs;
+    if (rc = fsOpenSdCardFileSystem(&fs); R_FAILED(rc))
+        return rc;
+    FZ_SCOPEGUARD([&fs] { fsFsClose(&fs); });
+
+    char path[FS_MAX_PATH] = {};
+    std::strncpy(path, DumpPath, sizeof(path) - 1);
+
+    fsFsDeleteFile(&fs, path);
+    if (rc = fsFsCreateFile(&fs, path, sizeof(header) + sizeof(snapshot), 0); R_FAILED(rc))
+        return rc;
+
+    FsFile fp;
+    if (rc = fsFsOpenFile(&fs, path, FsOpenMode_Write, &fp); R_FAILED(rc))
+        return rc;
+    FZ_SCOPEGUARD([&fp] { fsFileClose(&fp); });
+
+    if (rc = fsFileWrite(&fp, 0, &header, sizeof(header), FsWriteOption_None); R_FAILED(rc))
+        return rc;
+
+    return fsFileWrite(&fp, sizeof(header), snapshot.data(), sizeof(snapshot), FsWriteOption_Flush);
+}
+
+} // namespace fz::trace
+
+#endif // FZ_TRACE
@@ -0,0 +1,142 @@
+// Copyright (c) 2024 averne
+//
+// This file is part of Fizeau.
+//
+// Fizeau is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+//
+// Fizeau is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with Fizeau.  If not, see <http://www.gnu.org/licenses/>.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <switch.h>
+
+#include <common.hpp>
+
+// Binary trace ring, enabled by building with FZ_TRACE (make sysmodule TRACE=1)
+// Entries are timestamped with the system tick and can be dumped to the sd card
+// using fizeauDumpTrace, then decoded using misc/trace.py
+
+namespace fz::trace {
+
+enum Event: std::uint16_t {
+    Event_None,
+    Event_Apply,
+    Event_CalculateCmu,
+    Event_IoctlSetCmu,
+    Event_IoctlGetAviInfoframe,
+    Event_IoctlSetAviInfoframe,
+    Event_MmioScan,
+    Event_TransitionWakeup,
+    Event_OperationModeChange,
+    Event_Activity,
+    Event_IpcDispatch,
+    Event_ApplicationChange,
+    Event_AmbientChange,
+    Event_CscStage,
+    Event_LutMismatch,
+    Event_ServiceReady,
+    Event_FirstCommit,
+};
+
+// Thread stacks whose high-water mark is reported in dumps
+enum Stack: std::uint16_t {
+    Stack_Main,
+    Stack_Boot,
+    Stack_Transition,
+    Stack_EventMonitor,
+    Stack_Total,
+};
+
+struct StackUsage {
+    std::uint32_t size;
+    std::uint32_t peak; // Deepest use in bytes
+};
+ASSERT_SIZE(StackUsage, 8);
+
+struct Entry {
+    std::uint64_t tick;
+    std::uint32_t duration; // In ticks, 0 for instant events
+    Event         id;
+    std::uint16_t arg;
+};
+ASSERT_SIZE(Entry, 16);
+
+struct DumpHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t entry_size;
+    std::uint64_t tick_freq;
+    std::uint32_t num_entries;
+    std::uint32_t head;
+    std::array<StackUsage, Stack_Total> stacks;
+};
+ASSERT_SIZE(DumpHeader, 56);
+
+constexpr std::uint32_t DumpMagic   = 0x52545a46; // "FZTR"
+constexpr std::uint16_t DumpVersion = 2;
+constexpr auto          DumpPath    = "/config/Fizeau/trace.bin";
+
+constexpr std::size_t NumEntries = 0x400;
+static_assert((NumEntries & (NumEntries - 1)) == 0, "Trace ring size must be a power of two");
+
+struct Ring {
+    std::array<Entry, NumEntries> entries;
+    std::atomic_uint32_t head;
+};
+
+extern constinit Ring ring;
+
+static inline void record_at(Event id, std::uint64_t tick, std::uint32_t duration = 0, std::uint16_t arg = 0) {
+    auto idx = ring.head.fetch_add(1, std::memory_order_relaxed) & (NumEntries - 1);
+    ring.entries[idx] = { tick, duration, id, arg };
+}
+
+static inline void record(Event id, std::uint16_t arg = 0) {
+    record_at(id, armGetSystemTick(), 0, arg);
+}
+
+class Scope {
+    public:
+        Scope(Event id, std::uint16_t arg = 0): start(armGetSystemTick()), id(id), arg(arg) { }
+
+        Scope(const Scope &) = delete;
+        Scope &operator =(const Scope &) = delete;
+
+        ~Scope() {
+            record_at(this->id, this->start, static_cast<std::uint32_t>(armGetSystemTick() - this->start), this->arg);
+        }
+
+    private:
+        std::uint64_t start;
+        Event id;
+        std::uint16_t arg;
+};
+
+// Stacks start out zeroed, the lowest non-zero byte marks the deepest use so far
+void watch_stack(Stack id, const void *mem, std::size_t size);
+
+Result dump();
+
+} // namespace fz::trace
+
+#ifdef FZ_TRACE
+#   define FZ_TRACE_SCOPE(id, ...) ::fz::trace::Scope FZ_ANONYMOUS(::fz::trace::id, ##__VA_ARGS__)
+#   define FZ_TRACE_EVENT(id, ...) ::fz::trace::record(::fz::trace::id, ##__VA_ARGS__)
+#   define FZ_TRACE_STACK(id, ...) ::fz::trace::watch_stack(::fz::trace::id, ##__VA_ARGS__)
+#else
+#   define FZ_TRACE_SCOPE(id, ...) ({})
+#   define FZ_TRACE_EVENT(id, ...) ({})
+#   define FZ_TRACE_STACK(id, ...) ({})
+#endif